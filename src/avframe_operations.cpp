@@ -0,0 +1,181 @@
+// ***********************************************************/
+// avframe_operations.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Operations on decoded AVFrame planes without copying pixels,
+// e.g. pointing to a region of interest for conversion.
+// ***********************************************************/
+
+#include "avframe_operations.h"
+
+extern "C"
+{
+#include <libavutil/mastering_display_metadata.h>
+}
+
+static bool crop_supported(const AVPixFmtDescriptor* desc)
+{
+    if (!desc)
+        return false;
+
+    // hardware surfaces, palette and bitstream formats can't be offset by bytes
+    return !(desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM));
+}
+
+bool avframe_align_rect(int format, int frame_w, int frame_h, int& x, int& y, int& w, int& h)
+{
+    auto desc = av_pix_fmt_desc_get(AVPixelFormat(format));
+    if (!crop_supported(desc))
+        return false;
+
+    int align_x = 1 << desc->log2_chroma_w;
+    int align_y = 1 << desc->log2_chroma_h;
+
+    int right = FFMIN(x + w, frame_w);
+    int bottom = FFMIN(y + h, frame_h);
+
+    x = FFMAX(x, 0) & ~(align_x - 1);
+    y = FFMAX(y, 0) & ~(align_y - 1);
+
+    w = right - x;
+    h = bottom - y;
+    if (right < frame_w)
+        w &= ~(align_x - 1);
+    if (bottom < frame_h)
+        h &= ~(align_y - 1);
+
+    return w > 0 && h > 0;
+}
+
+bool avframe_crop_planes(const AVFrame* frame, int x, int y, uint8_t* data[4], int linesize[4])
+{
+    auto desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+    if (!crop_supported(desc))
+        return false;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        data[i] = nullptr;
+        linesize[i] = 0;
+
+        if (!frame->data[i])
+            continue;
+
+        // step of any component in this plane, e.g. 2 for Y of YUYV
+        const AVComponentDescriptor* comp = nullptr;
+        for (int j = 0; j < desc->nb_components; ++j)
+        {
+            if (desc->comp[j].plane == i)
+            {
+                comp = &desc->comp[j];
+                break;
+            }
+        }
+
+        if (!comp)
+            return false;
+
+        int shift_x = (i == 1 || i == 2) ? desc->log2_chroma_w : 0;
+        int shift_y = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+
+        data[i] = frame->data[i] + (y >> shift_y) * frame->linesize[i] + (x >> shift_x) * comp->step;
+        linesize[i] = frame->linesize[i];
+    }
+    return true;
+}
+
+bool avframe_has_luma_plane(int format)
+{
+    auto desc = av_pix_fmt_desc_get(AVPixelFormat(format));
+    if (!crop_supported(desc) || (desc->flags & AV_PIX_FMT_FLAG_RGB) || desc->nb_components < 1)
+        return false;
+
+    const AVComponentDescriptor& y = desc->comp[0];
+    return y.plane == 0 && y.depth == 8 && y.step == 1 && y.offset == 0;
+}
+
+bool avframe_hdr_info(const AVFrame* frame, HdrFrameInfo& info, HdrPlanes& planes)
+{
+    if (frame->color_trc != AVCOL_TRC_SMPTE2084 && frame->color_trc != AVCOL_TRC_ARIB_STD_B67)
+        return false;
+
+    auto desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+    if (!crop_supported(desc) || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_BE | AV_PIX_FMT_FLAG_FLOAT)) ||
+        desc->nb_components < 3)
+        return false;
+
+    for (int c = 0; c < 3; ++c)
+    {
+        const auto& comp = desc->comp[c];
+        if (comp.depth <= 8 || comp.depth > 16 || comp.step % 2 || comp.offset % 2)
+            return false;
+
+        planes.comp[c].data = frame->data[comp.plane] + comp.offset;
+        planes.comp[c].linesize = frame->linesize[comp.plane];
+        planes.comp[c].step = comp.step / 2;
+        planes.comp[c].shift = comp.shift;
+    }
+    planes.log2_chroma_w = desc->log2_chroma_w;
+    planes.log2_chroma_h = desc->log2_chroma_h;
+
+    info.transfer = frame->color_trc == AVCOL_TRC_SMPTE2084 ? HdrTransfer::PQ : HdrTransfer::HLG;
+    info.bBt2020 = frame->color_primaries == AVCOL_PRI_BT2020 || frame->color_primaries == AVCOL_PRI_UNSPECIFIED;
+    info.bFullRange = frame->color_range == AVCOL_RANGE_JPEG;
+    info.depth = desc->comp[0].depth;
+
+    // brightest pixel of the content first, then the mastering display peak
+    info.peakNits = 0;
+    if (auto sd = av_frame_get_side_data(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL))
+        info.peakNits = reinterpret_cast<const AVContentLightMetadata*>(sd->data)->MaxCLL;
+    if (auto sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA); sd && info.peakNits <= 0)
+    {
+        auto mastering = reinterpret_cast<const AVMasteringDisplayMetadata*>(sd->data);
+        if (mastering->has_luminance)
+            info.peakNits = av_q2d(mastering->max_luminance);
+    }
+    if (info.peakNits <= 0)
+        info.peakNits = 1000;
+    info.peakNits = FFMIN(FFMAX(info.peakNits, 100.0), 10000.0);
+    return true;
+}
+
+bool avframe_interp_picture(const AVFrame* frame, InterpPicture& pic)
+{
+    if (!avframe_has_luma_plane(frame->format))
+        return false;
+
+    auto desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+    if (desc->nb_components < 3)
+        return false;
+    for (int c = 0; c < desc->nb_components; ++c)
+    {
+        if (desc->comp[c].depth != 8)
+            return false;
+    }
+
+    pic.nb_planes = 0;
+    for (int i = 0; i < 4 && frame->data[i]; ++i)
+    {
+        // u and v share the step in nv12
+        int step = 0;
+        for (int c = 0; c < desc->nb_components; ++c)
+        {
+            if (desc->comp[c].plane == i)
+                step = desc->comp[c].step;
+        }
+        if (!step)
+            return false;
+
+        auto& plane = pic.planes[i];
+        plane.data = frame->data[i];
+        plane.linesize = frame->linesize[i];
+        plane.step = step;
+        plane.shift_w = (i == 1 || i == 2) ? desc->log2_chroma_w : 0;
+        plane.shift_h = (i == 1 || i == 2) ? desc->log2_chroma_h : 0;
+        pic.nb_planes++;
+    }
+    pic.width = frame->width;
+    pic.height = frame->height;
+    return pic.nb_planes > 1;
+}
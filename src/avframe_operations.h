@@ -0,0 +1,29 @@
+#pragma once
+
+extern "C"
+{
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+}
+
+#include "frame_interpolator.h"
+#include "hdr_tonemap.h"
+
+// Align a source rect in pixels to the chroma subsampling of the pixel format,
+// and clip it to the frame size. Returns false if the rect is empty afterwards.
+bool avframe_align_rect(int format, int frame_w, int frame_h, int& x, int& y, int& w, int& h);
+
+// Plane pointers to the pixel (x, y) of the frame, no pixel is copied.
+// x and y have to be aligned by avframe_align_rect first.
+bool avframe_crop_planes(const AVFrame* frame, int x, int y, uint8_t* data[4], int linesize[4]);
+
+// True if plane 0 holds 8 bit luma, one byte per pixel (planar and semi-planar yuv).
+bool avframe_has_luma_plane(int format);
+
+// Transfer, range and peak of a PQ/HLG frame and its y/u/v samples for the tone
+// mapper. False for sdr frames and for layouts other than 9 to 16 bits yuv.
+bool avframe_hdr_info(const AVFrame* frame, HdrFrameInfo& info, HdrPlanes& planes);
+
+// Planes of an 8 bits planar or semi-planar yuv frame for the frame interpolator.
+// False for other layouts.
+bool avframe_interp_picture(const AVFrame* frame, InterpPicture& pic);
@@ -0,0 +1,1085 @@
+// ***********************************************************/
+// image_bench.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Benchmark of the image operations, VideoPlayerBench target.
+// Each group runs on synthetic frames at 720p, 1080p and 4K, the
+// median, p95 and MB/s are printed and written as JSON so two
+// builds can be diffed. Parity checks compare the optimized paths
+// with their reference.
+//
+//   imagecv   imagecv_operations.h functions
+//   qimage    qimage_operation.h functions
+//   convert   QImage/Mat conversions
+//   paint     gui thread painting, QLabel pixmap and VideoLabel
+//   sink      yuv420p frame to the QVideoSink against swscale rgb24
+//   chain     CvEffectChain fused passes and thread count
+//   gamma     table driven gamma against the pow loop
+//   lut3d     3D LUT with a generated 33 points .cube file
+//   tonemap   HDR tone mapping of 10 bits PQ frames
+//   interp    frame interpolation of a moving yuv420p pair
+//   denoise   temporal denoiser, static yuv420p with noise
+//   upscale   edge directed upscaler from 480p
+//   compare   a/b PSNR and SSIM of two noisy copies
+//   scopes    scopes sampling of yuv420p and p010 frames, 1 ms at 4K
+//
+// Usage: VideoPlayerBench [--runs N] [--filter name] [--json file]
+// ***********************************************************/
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPainter>
+#include <QPixmap>
+#include <QSysInfo>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <tuple>
+#include <vector>
+#include "cv_effect_chain.h"
+#include "edge_upscaler.h"
+#include "frame_compare.h"
+#include "frame_interpolator.h"
+#include "hdr_tonemap.h"
+#include "imagecv_operations.h"
+#include "imagecv_parallel.h"
+#include "lut3d.h"
+#include "temporal_denoiser.h"
+#include "qimage_convert_mat.h"
+#include "qimage_operation.h"
+#include "simd_level.h"
+#include "video_scopes_thread.h"
+#include "video_sink_frame.h"
+
+extern "C"
+{
+#include <libswscale/swscale.h>
+}
+
+typedef struct BenchResolution
+{
+    const char* name;
+    int width;
+    int height;
+} BenchResolution;
+
+static const BenchResolution resolutions[] = {{"720p", 1280, 720}, {"1080p", 1920, 1080}, {"4K", 3840, 2160}};
+
+#define SCOPES_BUDGET_MS 1.0 // what the scopes sampling may add to a 4K frame
+
+typedef struct BenchStats
+{
+    double median{0};
+    double p95{0};
+} BenchStats;
+
+static BenchStats stats_ms(std::vector<double> times)
+{
+    BenchStats stats;
+    if (times.empty())
+        return stats;
+
+    std::sort(times.begin(), times.end());
+    stats.median = times[times.size() / 2];
+    stats.p95 = times[std::min(times.size() - 1, size_t(times.size() * 0.95))];
+    return stats;
+}
+
+// prepare runs untimed before each run, e.g. to restore the input of in-place operations
+static BenchStats measure(int runs, const std::function<void()>& prepare, const std::function<void()>& run)
+{
+    std::vector<double> times;
+    for (int i = 0; i < runs; i++)
+    {
+        if (prepare)
+            prepare();
+
+        QElapsedTimer timer;
+        timer.start();
+        run();
+        times.push_back(timer.nsecsElapsed() / 1000000.0);
+    }
+    return stats_ms(times);
+}
+
+static Mat synthetic_mat(int w, int h, int type)
+{
+    // noise with some structure, so edge and threshold operations have work to do
+    Mat img(h, w, type);
+    cv::randu(img, Scalar::all(0), Scalar::all(255));
+    cv::GaussianBlur(img, img, cv::Size(7, 7), 2);
+    return img;
+}
+
+static QImage synthetic_image(int w, int h, QImage::Format format)
+{
+    Mat bgr = synthetic_mat(w, h, CV_8UC3);
+    Mat bgra;
+    cv::cvtColor(bgr, bgra, cv::COLOR_BGR2BGRA);
+
+    QImage img(bgra.data, bgra.cols, bgra.rows, (int)bgra.step[0], QImage::Format_RGB32);
+    // the view doesn't own the pixels, converting to the same format would share them
+    return format == img.format() ? img.copy() : img.convertToFormat(format);
+}
+
+static Mat image_mat(const QImage& img)
+{
+    // view of the pixels, for the parity checks
+    return Mat(img.height(), img.width(), img.depth() == 8 ? CV_8UC1 : CV_8UC4, (void*)img.constBits(),
+               size_t(img.bytesPerLine()));
+}
+
+static QImage gamma_image_pow(const QImage& img, double exp)
+{
+    // gamma_image before the lookup table, three pow per pixel
+    QImage retImg(img.size(), img.format());
+    for (int i = 0; i < img.height(); i++)
+    {
+        const QRgb* scan = reinterpret_cast<const QRgb*>(img.constScanLine(i));
+        QRgb* ret_scan = reinterpret_cast<QRgb*>(retImg.scanLine(i));
+        for (int j = 0; j < img.width(); j++)
+        {
+            ret_scan[j] = QColor(255 * std::pow(qRed(scan[j]) / 255.0, exp), 255 * std::pow(qGreen(scan[j]) / 255.0, exp),
+                                 255 * std::pow(qBlue(scan[j]) / 255.0, exp))
+                              .rgb();
+        }
+    }
+    return retImg;
+}
+
+static void chained_point_ops(Mat& img)
+{
+    // the point operations one by one, in the order CvEffectChain fuses them
+    uchar table[256];
+    gen_color_table(table, sizeof(table), 20);
+    reverse_img(img);
+    scane_img_LUT(img, Mat(1, 256, CV_8UC1, table));
+    gamma_img(img, 1.2f);
+    contrast_bright_img(img, 1.2, 30);
+    lighter_img(img, 1.2f);
+    exposure_img(img, 50);
+}
+
+static const std::vector<CvEffect> fused_point_effects = {CvEffect::Reverse, CvEffect::ColorReduce,
+                                                          CvEffect::Gamma,   CvEffect::ContrastBright,
+                                                          CvEffect::Lighter, CvEffect::Exposure};
+
+typedef Mat (*LocalOp)(const Mat&);
+// band parallel local effects of CvEffectChain, with the output type of parallel_rows_img
+static const std::tuple<const char*, LocalOp, int> tiled_ops[] = {
+    {"blur_img", [](const Mat& m) { return blur_img(m); }, CV_8UC3},
+    {"sobel_img_XY", [](const Mat& m) { return sobel_img_XY(m); }, CV_8UC1},
+    {"scharr_img_XY", [](const Mat& m) { return scharr_img_XY(m); }, CV_8UC1},
+    {"prewitt_img_XY", [](const Mat& m) { return prewitt_img_XY(m); }, CV_8UC1},
+    {"laplacian_img", [](const Mat& m) { return laplacian_img(m); }, CV_8UC1},
+    {"thresholdAdaptive_img", [](const Mat& m) { return thresholdAdaptive_img(m); }, CV_8UC1},
+};
+
+static bool write_cube(const QString& file, int size, bool bIdentity)
+{
+    // identity, or a warm grading with some channel mixing
+    QFile f(file);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream out(&f);
+    out << "TITLE \"bench\"\nLUT_3D_SIZE " << size << "\n";
+    for (int b = 0; b < size; b++)
+    {
+        for (int g = 0; g < size; g++)
+        {
+            for (int r = 0; r < size; r++)
+            {
+                double R = r / (size - 1.0), G = g / (size - 1.0), B = b / (size - 1.0);
+                if (!bIdentity)
+                {
+                    double y = 0.3 * R + 0.59 * G + 0.11 * B;
+                    R = std::pow(0.8 * R + 0.2 * y, 0.9);
+                    G = 0.9 * G + 0.1 * y;
+                    B = std::pow(0.7 * B + 0.3 * y, 1.1);
+                }
+                out << QString::number(R, 'f', 6) << ' ' << QString::number(G, 'f', 6) << ' '
+                    << QString::number(B, 'f', 6) << '\n';
+            }
+        }
+    }
+    return true;
+}
+
+typedef struct HdrFrame
+{
+    std::vector<uint16_t> planes[3]; // yuv420p10
+    HdrPlanes view;
+} HdrFrame;
+
+static void synthetic_hdr_frame(int w, int h, HdrFrame& frame)
+{
+    // luma ramp over the whole pq range, chroma from the synthetic mat
+    const Mat chroma = synthetic_mat(w / 2, h / 2, CV_8UC3);
+    frame.planes[0].resize(size_t(w) * h);
+    frame.planes[1].resize(size_t(w / 2) * (h / 2));
+    frame.planes[2].resize(size_t(w / 2) * (h / 2));
+    for (int y = 0; y < h; y++)
+    {
+        for (int x = 0; x < w; x++)
+            frame.planes[0][size_t(y) * w + x] = uint16_t(64 + (x + y) * 876 / (w + h));
+    }
+    for (int y = 0; y < h / 2; y++)
+    {
+        for (int x = 0; x < w / 2; x++)
+        {
+            auto px = chroma.at<cv::Vec3b>(y, x);
+            frame.planes[1][size_t(y) * (w / 2) + x] = uint16_t(64 + px[0] * 896 / 255);
+            frame.planes[2][size_t(y) * (w / 2) + x] = uint16_t(64 + px[1] * 896 / 255);
+        }
+    }
+
+    int widths[3] = {w, w / 2, w / 2};
+    for (int c = 0; c < 3; c++)
+    {
+        frame.view.comp[c].data = reinterpret_cast<const uint8_t*>(frame.planes[c].data());
+        frame.view.comp[c].linesize = widths[c] * 2;
+    }
+}
+
+typedef struct YuvFrame
+{
+    Mat planes[3]; // yuv420p
+    InterpPicture view;
+} YuvFrame;
+
+static void set_yuv_view(YuvFrame& frame)
+{
+    frame.view.nb_planes = 3;
+    frame.view.width = frame.planes[0].cols;
+    frame.view.height = frame.planes[0].rows;
+    for (int c = 0; c < 3; c++)
+    {
+        auto& plane = frame.view.planes[c];
+        plane.data = frame.planes[c].data;
+        plane.linesize = int(frame.planes[c].step);
+        plane.shift_w = plane.shift_h = c ? 1 : 0;
+    }
+}
+
+static void shifted_yuv_frames(int w, int h, int shift, YuvFrame frames[3])
+{
+    // one synthetic picture seen through a window moving by shift / 2 per frame
+    const Mat luma = synthetic_mat(w + shift, h, CV_8UC1);
+    const Mat chroma = synthetic_mat((w + shift + 1) / 2, (h + 1) / 2, CV_8UC3);
+    Mat uv[3];
+    cv::split(chroma, uv);
+
+    for (int i = 0; i < 3; i++)
+    {
+        int x = shift * i / 2;
+        frames[i].planes[0] = luma(cv::Rect(x, 0, w, h)).clone();
+        frames[i].planes[1] = uv[0](cv::Rect(x / 2, 0, (w + 1) / 2, (h + 1) / 2)).clone();
+        frames[i].planes[2] = uv[1](cv::Rect(x / 2, 0, (w + 1) / 2, (h + 1) / 2)).clone();
+        set_yuv_view(frames[i]);
+    }
+}
+
+static void noisy_yuv_frames(int w, int h, double sigma, YuvFrame frames[3])
+{
+    // the same picture with different noise, the same noise on every run
+    shifted_yuv_frames(w, h, 0, frames);
+    cv::RNG rng(0x5eed);
+    for (int i = 0; i < 3; i++)
+    {
+        for (auto& plane : frames[i].planes)
+        {
+            Mat noise(plane.size(), CV_16SC1);
+            rng.fill(noise, cv::RNG::NORMAL, 0, sigma);
+            cv::add(plane, noise, plane, cv::noArray(), CV_8U);
+        }
+        set_yuv_view(frames[i]);
+    }
+}
+
+// the level set for a scope, the supported one is restored when it ends
+class SimdLevelScope
+{
+public:
+    explicit SimdLevelScope(SimdLevel level) { set_simd_level(level); }
+    ~SimdLevelScope() { set_simd_level(simd_level_supported()); }
+};
+
+// runs fn at the scalar level and at sse2 if the cpu has it, the kernels have no
+// avx2 version, that level would time the sse2 code again
+static void for_each_level(const std::function<void(SimdLevel)>& fn)
+{
+    for (auto level : {SimdLevel::Scalar, SimdLevel::SSE2})
+    {
+        if (level > simd_level_supported())
+            continue;
+
+        SimdLevelScope scope(level);
+        fn(level);
+    }
+}
+
+class ImageBench
+{
+public:
+    ImageBench(int runs, const QString& filter) : m_runs(runs), m_filter(filter) {}
+
+    void run_all()
+    {
+        for (const auto& res : resolutions)
+        {
+            run_mat_ops(res, "bgr24", CV_8UC3);
+            run_mat_ops(res, "gray8", CV_8UC1);
+            run_qimage_ops(res, "rgb32", QImage::Format_RGB32);
+            run_qimage_ops(res, "rgb888", QImage::Format_RGB888);
+            run_convert_ops(res);
+            run_paint_ops(res);
+            run_sink_ops(res);
+            run_chain_ops(res);
+            run_gamma_ops(res);
+            run_lut_ops(res);
+            run_tone_map_ops(res);
+            run_interpolation_ops(res);
+            run_denoise_ops(res);
+            run_upscale_ops(res);
+            run_compare_ops(res);
+            run_scopes_ops(res);
+        }
+        run_parity_checks();
+        run_kernel_parity_checks();
+    }
+
+    QJsonDocument json() const
+    {
+        QJsonObject root;
+        root["cpu"] = QSysInfo::currentCpuArchitecture();
+        root["os"] = QSysInfo::prettyProductName();
+        root["threads"] = cv::getNumThreads();
+        root["runs"] = m_runs;
+        root["results"] = m_results;
+        root["parity"] = m_parity;
+        root["budget"] = m_budget;
+        return QJsonDocument(root);
+    }
+
+    bool parity_ok() const { return m_bParityOk; }
+    bool budget_ok() const { return m_bBudgetOk; }
+
+private:
+    bool selected(const QString& name) const { return m_filter.isEmpty() || name.contains(m_filter); }
+
+    BenchStats add(const QString& group, const QString& name, const BenchResolution& res, const QString& format,
+                   double bytes, const std::function<void()>& prepare, const std::function<void()>& run)
+    {
+        if (!selected(name))
+            return BenchStats();
+
+        auto stats = measure(m_runs, prepare, run);
+        double mbs = stats.median > 0 ? bytes / (1024.0 * 1024.0) / (stats.median / 1000.0) : 0;
+
+        printf("%-9s %-26s %-6s %-7s median %9.3f ms  p95 %9.3f ms  %9.1f MB/s\n", qUtf8Printable(group),
+               qUtf8Printable(name), res.name, qUtf8Printable(format), stats.median, stats.p95, mbs);
+        fflush(stdout);
+
+        QJsonObject obj;
+        obj["group"] = group;
+        obj["name"] = name;
+        obj["resolution"] = res.name;
+        obj["format"] = format;
+        obj["median_ms"] = stats.median;
+        obj["p95_ms"] = stats.p95;
+        obj["mb_per_s"] = mbs;
+        m_results.append(obj);
+        return stats;
+    }
+
+    void run_mat_ops(const BenchResolution& res, const QString& format, int type)
+    {
+        const Mat src = synthetic_mat(res.width, res.height, type);
+        const Mat src2 = synthetic_mat(res.width, res.height, type);
+        const double bytes = double(src.total() * src.elemSize());
+        const bool bColor = src.channels() == 3;
+        Mat img, out;
+
+        auto copy = [&]() { src.copyTo(img); };
+        auto op = [&](const char* name, const std::function<void()>& run) {
+            add("imagecv", name, res, format, bytes, nullptr, run);
+        };
+        auto op_inplace = [&](const char* name, const std::function<void()>& run) {
+            add("imagecv", name, res, format, bytes, copy, run);
+        };
+
+        uchar table[256];
+        gen_color_table(table, sizeof(table), 20);
+        const Mat lut(1, 256, CV_8UC1, table);
+        const Mat kernel = (cv::Mat_<float>(3, 3) << 0, -1, 0, -1, 5, -1, 0, -1, 0);
+
+        // files go through the codecs, png keeps it lossless
+        const QString file = QDir::temp().filePath(QString("videoplayer_bench_%1.png").arg(format));
+        write_img(src, file.toLocal8Bit().constData());
+
+        op("write_img", [&]() { write_img(src, file.toLocal8Bit().constData()); });
+        op("load_img", [&]() { out = load_img(file.toLocal8Bit().constData()); });
+        op("load_grey", [&]() { out = load_grey(file.toLocal8Bit().constData()); });
+        op("info_img", [&]() { info_img(src); });
+        op("img_swap_channel", [&]() { out = img_swap_channel(src); });
+        op("img2bgr", [&]() { out = img2bgr(src); });
+        op("img2rgb", [&]() { out = img2rgb(src); });
+        op("grey_img", [&]() { out = grey_img(src); });
+        op("resize_img", [&]() { out = resize_img(src, src.cols / 2, src.rows / 2); });
+        op("diff_imgs", [&]() { out = diff_imgs(src, src2); });
+        op("distance_imgs", [&]() { distance_imgs(src, src2); });
+        op("sad_imgs", [&]() { sad_imgs(src, src2); });
+        if (!bColor)
+            op("hist_distance_imgs", [&]() { hist_distance_imgs(src, src2); });
+        op("psnr_img", [&]() { psnr_img(src, src2); });
+        op("flip_img", [&]() { out = flip_img(src); });
+        op("rotate_img", [&]() { out = rotate_img(src); });
+        op("repeat_img", [&]() { out = repeat_img(src, 2, 2); });
+        if (bColor)
+            op("histgram_img", [&]() { out = histgram_img(src); });
+        op_inplace("equalized_hist_img", [&]() { equalized_hist_img(img); });
+        op_inplace("reverse_img", [&]() { reverse_img(img); });
+        op_inplace("lighter_img", [&]() { lighter_img(img, 1.2f); });
+        op_inplace("exposure_img", [&]() { exposure_img(img, 50); });
+        op_inplace("scane_img_colortable", [&]() { scane_img_colortable(img, table); });
+        op_inplace("scane_img_colortable2", [&]() { scane_img_colortable2(img, table); });
+        op_inplace("scane_img_LUT", [&]() { scane_img_LUT(img, lut); });
+        op_inplace("gamma_img", [&]() { gamma_img(img, 1.2f); });
+        op_inplace("contrast_bright_img", [&]() { contrast_bright_img(img, 1.2, 30); });
+        op("threshold_img", [&]() { out = threshold_img(grey_img(src)); });
+        op("thresholdAdaptive_img", [&]() { out = thresholdAdaptive_img(src); });
+        if (bColor)
+            op("covert_color_img", [&]() { out = covert_color_img(src, COLOR_BGR2HSV); });
+        op("filter_img", [&]() { out = filter_img(src, kernel); });
+        op("normalize_img", [&]() { out = normalize_img(src, 0, 255, NORM_MINMAX); });
+        op("gen_color_table", [&]() { gen_color_table(table, sizeof(table), 20); });
+        op("blur_img gaussian", [&]() { out = blur_img(src, GAUSSIAN); });
+        op("blur_img box", [&]() { out = blur_img(src, BLUR); });
+        op("blur_img median", [&]() { out = blur_img(src, MEDIAN); });
+        op("canny_img", [&]() { out = canny_img(src); });
+        op("sobel_img", [&]() { out = sobel_img(src); });
+        op("sobel_img_XY", [&]() { out = sobel_img_XY(src); });
+        op("laplacian_img", [&]() { out = laplacian_img(src); });
+        op("scharr_img", [&]() { out = scharr_img(src); });
+        op("scharr_img_XY", [&]() { out = scharr_img_XY(src); });
+        op("prewitt_img", [&]() { out = prewitt_img(src); });
+        op("prewitt_img_XY", [&]() { out = prewitt_img_XY(src); });
+        op("cornerHarris", [&]() { out = cornerHarris(src); });
+
+        QFile::remove(file);
+        // not timed: show_img opens a window and waits for a key,
+        // face_detect needs a haar cascade file (see FaceTracker)
+    }
+
+    void run_qimage_ops(const BenchResolution& res, const QString& format, QImage::Format qformat)
+    {
+        const QImage src = synthetic_image(res.width, res.height, qformat);
+        const double bytes = double(src.sizeInBytes());
+        const bool bRgb32 = qformat == QImage::Format_RGB32; // functions addressing pixels as QRgb
+        QImage img, out;
+
+        auto copy = [&]() { img = src.copy(); };
+        auto op = [&](const char* name, const std::function<void()>& run) {
+            add("qimage", name, res, format, bytes, copy, run);
+        };
+
+        const QRect rt(0, 0, src.width(), src.height() / 4);
+        QTransform matrix;
+        matrix.rotate(45);
+
+        op("image_info", [&]() { image_info(img); });
+        if (bRgb32)
+        {
+            op("create_image", [&]() { create_image(img); });
+            op("random_image", [&]() { random_image(img); });
+            QImage r(src.size(), qformat), g(src.size(), qformat), b(src.size(), qformat);
+            op("split_image", [&]() { split_image(img, r, b, g); });
+        }
+        op("gamma_image", [&]() { out = gamma_image(img, 1 / 2.0); });
+        op("draw_img_text", [&]() { draw_img_text(img, "Video Player", rt); });
+        op("draw_subtitle", [&]() { draw_subtitle(img, "Subtitle line for the benchmark"); });
+        op("draw_img_rect", [&]() { draw_img_rect(img, rt); });
+        op("grey_image", [&]() { grey_image(img); });
+        op("invert_image", [&]() { invert_image(img); });
+        op("mirro_image", [&]() { mirro_image(img); });
+        op("swap_image", [&]() { swap_image(img); });
+        op("scale_image", [&]() { scale_image(img, img.width() / 2, img.height() / 2); });
+        op("transform_image", [&]() { transform_image(img, matrix); });
+        // not timed: applyEffectToImage, blur_img, dropshadow_img, colorize_img and
+        // opacity_img are commented out in qimage_operation.h, they aren't compiled
+    }
+
+    void run_convert_ops(const BenchResolution& res)
+    {
+        const std::pair<const char*, QImage::Format> qformats[] = {
+            {"rgb32", QImage::Format_RGB32}, {"rgb888", QImage::Format_RGB888}, {"gray8", QImage::Format_Grayscale8}};
+        for (const auto& [format, qformat] : qformats)
+        {
+            const QImage src = synthetic_image(res.width, res.height, qformat);
+            Mat mat;
+            add("convert", "qimage_to_mat", res, format, double(src.sizeInBytes()), nullptr,
+                [&]() { qimage_to_mat(src, mat); });
+        }
+
+        const std::pair<const char*, int> types[] = {{"bgra32", CV_8UC4}, {"bgr24", CV_8UC3}, {"gray8", CV_8UC1}};
+        for (const auto& [format, type] : types)
+        {
+            const Mat src = synthetic_mat(res.width, res.height, type);
+            QImage img;
+            add("convert", "mat_to_qimage", res, format, double(src.total() * src.elemSize()), nullptr,
+                [&]() { mat_to_qimage(src, img); });
+        }
+    }
+
+    void run_paint_ops(const BenchResolution& res)
+    {
+        // gui thread work per frame, painted into a 16:10 window as the backing store
+        const QImage frame = synthetic_image(res.width, res.height, QImage::Format_RGB888);
+        const double bytes = double(frame.sizeInBytes());
+        QImage window(1920, 1200, QImage::Format_ARGB32_Premultiplied);
+        const QSize sz = frame.size().scaled(window.size(), Qt::KeepAspectRatio);
+        const QRect videoRect(QPoint((window.width() - sz.width()) / 2, (window.height() - sz.height()) / 2), sz);
+
+        // before: image_ready copied the frame, QLabel got a new pixmap and, with scaled
+        // contents, scaled it smoothly to the whole label and painted over the erased label
+        add("paint", "frame label pixmap", res, "rgb888", bytes, nullptr, [&]() {
+            QImage image = frame.copy();
+            QPixmap pixmap = QPixmap::fromImage(image);
+            QPixmap scaled = pixmap.scaled(window.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            QPainter painter(&window);
+            painter.fillRect(window.rect(), Qt::black);
+            painter.drawPixmap(0, 0, scaled);
+        });
+
+        // after: VideoLabel shares the frame and draws it into the letterboxed rect only
+        add("paint", "frame video rect", res, "rgb888", bytes, nullptr, [&]() {
+            QImage image = frame;
+            QPainter painter(&window);
+            painter.setClipRect(videoRect);
+            if (videoRect.size() != image.size())
+                painter.setRenderHint(QPainter::SmoothPixmapTransform);
+            painter.drawImage(videoRect, image);
+        });
+    }
+
+    void run_sink_ops(const BenchResolution& res)
+    {
+        // a decoded yuv420p frame in ffmpeg buffers, as the video thread gets it
+        AVFrame* frame = av_frame_alloc();
+        if (!frame)
+            return;
+        frame->format = AV_PIX_FMT_YUV420P;
+        frame->width = res.width;
+        frame->height = res.height;
+        if (av_frame_get_buffer(frame, 0) < 0)
+        {
+            av_frame_free(&frame);
+            return;
+        }
+
+        YuvFrame yuv[3];
+        shifted_yuv_frames(res.width, res.height, 0, yuv);
+        for (int c = 0; c < 3; c++)
+        {
+            const Mat& plane = yuv[0].planes[c];
+            plane.copyTo(Mat(plane.rows, plane.cols, CV_8UC1, frame->data[c], size_t(frame->linesize[c])));
+        }
+        const double bytes = double(res.width) * res.height * 3 / 2;
+
+        // sink path: the planes are wrapped (copied before Qt 6.8), Qt's renderer converts them
+        QVideoFrame videoFrame;
+        add("sink", "avframe_to_video_frame", res, "yuv420", bytes, nullptr,
+            [&]() { avframe_to_video_frame(frame, videoFrame); });
+        // the conversion when Qt has to do it on the cpu
+        QImage image;
+        add("sink", "video frame toImage", res, "yuv420", bytes, nullptr, [&]() { image = videoFrame.toImage(); });
+
+        // rgb path: swscale to rgb24 in the video thread, as video_display does
+        SwsContext* sws = sws_getContext(res.width, res.height, AV_PIX_FMT_YUV420P, res.width, res.height,
+                                         AV_PIX_FMT_RGB24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (sws)
+        {
+            QImage rgb(res.width, res.height, QImage::Format_RGB888);
+            uint8_t* dst[4] = {rgb.bits(), nullptr, nullptr, nullptr};
+            int dst_linesize[4] = {(int)rgb.bytesPerLine(), 0, 0, 0};
+            add("sink", "sws_scale rgb24", res, "yuv420", bytes, nullptr, [&]() {
+                sws_scale(sws, (uint8_t const* const*)frame->data, frame->linesize, 0, res.height, dst, dst_linesize);
+            });
+            sws_freeContext(sws);
+        }
+
+        videoFrame = QVideoFrame();
+        av_frame_free(&frame);
+    }
+
+    void run_chain_ops(const BenchResolution& res)
+    {
+        const Mat src = synthetic_mat(res.width, res.height, CV_8UC3);
+        const double bytes = double(src.total() * src.elemSize());
+        const CvEffectChain chain(fused_point_effects);
+        Mat img, out;
+        add("chain", "point ops chained", res, "rgb888", bytes, [&]() { src.copyTo(img); },
+            [&]() { chained_point_ops(img); });
+        add("chain", "point ops fused", res, "rgb888", bytes, nullptr, [&]() { out = chain.apply(src); });
+
+        // band parallel local effects against the thread count, 4K only
+        if (res.height < 2160)
+            return;
+
+        const int defaultThreads = cv::getNumThreads();
+        std::vector<int> threads;
+        for (int n = 1; n < cv::getNumberOfCPUs(); n *= 2)
+            threads.push_back(n);
+        threads.push_back(cv::getNumberOfCPUs());
+
+        for (const auto& tiled : tiled_ops)
+        {
+            const char* name = std::get<0>(tiled);
+            LocalOp op = std::get<1>(tiled);
+            int type = std::get<2>(tiled);
+            add("chain", QString("%1 single call").arg(name), res, "rgb888", bytes, nullptr, [&]() { out = op(src); });
+            for (int n : threads)
+            {
+                cv::setNumThreads(n);
+                add("chain", QString("%1 tiled %2T").arg(name).arg(n), res, "rgb888", bytes, nullptr,
+                    [&]() { out = parallel_rows_img(src, type, op); });
+            }
+            cv::setNumThreads(defaultThreads);
+        }
+    }
+
+    void run_gamma_ops(const BenchResolution& res)
+    {
+        const QImage src = synthetic_image(res.width, res.height, QImage::Format_RGB32);
+        const double bytes = double(src.sizeInBytes());
+        QImage out;
+        add("gamma", "gamma_image [pow]", res, "rgb32", bytes, nullptr, [&]() { out = gamma_image_pow(src, 1 / 2.0); });
+        add("gamma", "gamma_image [table]", res, "rgb32", bytes, nullptr, [&]() { out = gamma_image(src, 1 / 2.0); });
+    }
+
+    void run_lut_ops(const BenchResolution& res)
+    {
+        const QString file = QDir::temp().filePath("videoplayer_bench.cube");
+        Lut3D lut;
+        if (!write_cube(file, 33, false) || !lut.load_cube(file))
+            return;
+        QFile::remove(file);
+
+        const Mat src = synthetic_mat(res.width, res.height, CV_8UC3);
+        const double bytes = double(src.total() * src.elemSize());
+        Mat img, out;
+        add("lut3d", "apply 33", res, "rgb888", bytes, nullptr, [&]() { lut.apply(src, out); });
+        add("lut3d", "apply 33 in place", res, "rgb888", bytes, [&]() { src.copyTo(img); }, [&]() { lut.apply(img, img); });
+    }
+
+    void run_tone_map_ops(const BenchResolution& res)
+    {
+        HdrFrame frame;
+        synthetic_hdr_frame(res.width, res.height, frame);
+        QImage img(res.width, res.height, QImage::Format_RGB888);
+        const double bytes = double(frame.planes[0].size() * 3); // 10 bits 4:2:0
+
+        HdrFrameInfo info;
+        info.transfer = HdrTransfer::PQ;
+        for (auto curve : {ToneMapCurve::BT2390, ToneMapCurve::Hable})
+        {
+            HdrToneMapper mapper;
+            mapper.configure(info, curve);
+            for_each_level([&](SimdLevel level) {
+                add("tonemap", QString("pq %1 [%2]").arg(HdrToneMapper::curve_name(curve)).arg(simd_level_name(level)),
+                    res, "yuv10", bytes, nullptr, [&]() {
+                        mapper.convert(frame.view, 0, 0, res.width, res.height, img.bits(), int(img.bytesPerLine()));
+                    });
+            });
+        }
+
+        // what the player does for a half size view of a 90 degrees rotated video
+        HdrToneMapper mapper;
+        mapper.configure(info, ToneMapCurve::BT2390);
+        QImage view(res.height / 2, res.width / 2, QImage::Format_RGB888);
+        add("tonemap", "pq bt2390 half view rotated 90", res, "yuv10", bytes, nullptr, [&]() {
+            mapper.convert(frame.view, 0, 0, res.width, res.height, view.height(), view.width(), 90, view.bits(),
+                           int(view.bytesPerLine()));
+        });
+    }
+
+    void run_interpolation_ops(const BenchResolution& res)
+    {
+        YuvFrame frames[3], out;
+        shifted_yuv_frames(res.width, res.height, 8, frames);
+        for (int c = 0; c < 3; c++)
+            out.planes[c] = frames[1].planes[c].clone();
+        set_yuv_view(out);
+        const double bytes = double(res.width) * res.height * 3 / 2;
+
+        for_each_level([&](SimdLevel level) {
+            FrameInterpolator interpolator;
+            add("interp", QString("estimate motion [%1]").arg(simd_level_name(level)), res, "yuv420", bytes, nullptr,
+                [&]() { interpolator.estimate(frames[0].view, frames[2].view, true, false); });
+            add("interp", QString("estimate blend [%1]").arg(simd_level_name(level)), res, "yuv420", bytes, nullptr,
+                [&]() { interpolator.estimate(frames[0].view, frames[2].view, false, false); });
+
+            interpolator.estimate(frames[0].view, frames[2].view, true, false);
+            add("interp", QString("interpolate [%1]").arg(simd_level_name(level)), res, "yuv420", bytes, nullptr,
+                [&]() { interpolator.interpolate(frames[0].view, frames[2].view, 0.5, out.view); });
+        });
+    }
+
+    void run_denoise_ops(const BenchResolution& res)
+    {
+        YuvFrame frames[3], out;
+        noisy_yuv_frames(res.width, res.height, 6, frames);
+        for (int c = 0; c < 3; c++)
+            out.planes[c] = frames[0].planes[c].clone();
+        set_yuv_view(out);
+        const double bytes = double(res.width) * res.height * 3 / 2;
+
+        for_each_level([&](SimdLevel level) {
+            for (auto strength : {DenoiseStrength::Light, DenoiseStrength::Strong})
+            {
+                // both references are filled after the first runs
+                TemporalDenoiser denoiser;
+                denoiser.set_strength(strength);
+                int i = 0;
+                add("denoise",
+                    QString("temporal %1 [%2]").arg(TemporalDenoiser::strength_name(strength)).arg(simd_level_name(level)),
+                    res, "yuv420", bytes, nullptr, [&]() { denoiser.denoise(frames[i++ % 3].view, out.view); });
+            }
+        });
+    }
+
+    void run_upscale_ops(const BenchResolution& res)
+    {
+        YuvFrame frames[3];
+        shifted_yuv_frames(854, 480, 0, frames);
+        if (!EdgeUpscaler::worth_upscaling(854, 480, res.width, res.height))
+            return;
+
+        const double bytes = double(res.width) * res.height * 3 / 2;
+        for_each_level([&](SimdLevel level) {
+            EdgeUpscaler upscaler;
+            add("upscale", QString("edge directed 480p [%1]").arg(simd_level_name(level)), res, "yuv420", bytes,
+                nullptr, [&]() { upscaler.upscale(frames[0].view, res.width, res.height); });
+        });
+    }
+
+    void run_compare_ops(const BenchResolution& res)
+    {
+        // an encode against its source, both luma planes are read
+        YuvFrame frames[3];
+        noisy_yuv_frames(res.width, res.height, 6, frames);
+        const Mat& a = frames[0].planes[0];
+        const Mat& b = frames[1].planes[0];
+        const double bytes = 2.0 * res.width * res.height;
+        for_each_level([&](SimdLevel level) {
+            add("compare", QString("psnr ssim luma [%1]").arg(simd_level_name(level)), res, "gray8", bytes, nullptr,
+                [&]() { FrameComparator::measure_luma(a.data, int(a.step), b.data, int(b.step), a.cols, a.rows); });
+        });
+    }
+
+    void run_scopes_ops(const BenchResolution& res)
+    {
+        // what the play thread hands to the scopes, a decoded frame in ffmpeg buffers
+        AVFrame* yuv420 = av_frame_alloc();
+        AVFrame* p010 = av_frame_alloc();
+        auto alloc = [&](AVFrame* frame, AVPixelFormat format) {
+            frame->format = format;
+            frame->width = res.width;
+            frame->height = res.height;
+            return av_frame_get_buffer(frame, 0) >= 0;
+        };
+        if (yuv420 && p010 && alloc(yuv420, AV_PIX_FMT_YUV420P) && alloc(p010, AV_PIX_FMT_P010LE))
+        {
+            YuvFrame yuv[3];
+            shifted_yuv_frames(res.width, res.height, 0, yuv);
+            for (int c = 0; c < 3; c++)
+            {
+                const Mat& plane = yuv[0].planes[c];
+                plane.copyTo(Mat(plane.rows, plane.cols, CV_8UC1, yuv420->data[c], size_t(yuv420->linesize[c])));
+            }
+
+            // 10 bits in the high bits, u and v interleaved
+            HdrFrame hdr;
+            synthetic_hdr_frame(res.width, res.height, hdr);
+            for (int y = 0; y < res.height; y++)
+            {
+                auto dst = reinterpret_cast<uint16_t*>(p010->data[0] + size_t(y) * p010->linesize[0]);
+                for (int x = 0; x < res.width; x++)
+                    dst[x] = uint16_t(hdr.planes[0][size_t(y) * res.width + x] << 6);
+            }
+            for (int y = 0; y < res.height / 2; y++)
+            {
+                auto dst = reinterpret_cast<uint16_t*>(p010->data[1] + size_t(y) * p010->linesize[1]);
+                for (int x = 0; x < res.width / 2; x++)
+                {
+                    dst[2 * x] = uint16_t(hdr.planes[1][size_t(y) * (res.width / 2) + x] << 6);
+                    dst[2 * x + 1] = uint16_t(hdr.planes[2][size_t(y) * (res.width / 2) + x] << 6);
+                }
+            }
+
+            // the thread is not started, the sample only waits for it
+            VideoScopesThread scopes;
+            const double bytes = double(res.width) * res.height * 3 / 2;
+            auto yuvStats = add("scopes", "submit_frame", res, "yuv420", bytes, nullptr,
+                                [&]() { scopes.submit_frame(yuv420); });
+            auto p010Stats = add("scopes", "submit_frame", res, "p010", bytes * 2, nullptr,
+                                 [&]() { scopes.submit_frame(p010); });
+            if (res.width >= 3840)
+            {
+                budget("scopes submit_frame yuv420", yuvStats, SCOPES_BUDGET_MS);
+                budget("scopes submit_frame p010", p010Stats, SCOPES_BUDGET_MS);
+            }
+        }
+
+        av_frame_free(&yuv420);
+        av_frame_free(&p010);
+    }
+
+    void run_kernel_parity_checks()
+    {
+        const QImage src = synthetic_image(1917, 1080, QImage::Format_RGB32);
+        parity("gamma_image table", image_mat(gamma_image_pow(src, 1 / 2.0)).clone(),
+               image_mat(gamma_image(src, 1 / 2.0)).clone());
+        // 24 bits images are converted before the QRgb loop
+        const QImage src888 = src.convertToFormat(QImage::Format_RGB888);
+        parity("gamma_image rgb888", image_mat(gamma_image_pow(src, 1 / 2.0)).clone(),
+               image_mat(gamma_image(src888, 1 / 2.0)).clone());
+
+        // tone mapping, odd width and a crop offset for the scalar tail and the chroma position
+        HdrFrame frame;
+        synthetic_hdr_frame(1920, 1080, frame);
+        for (auto transfer : {HdrTransfer::PQ, HdrTransfer::HLG})
+        {
+            HdrFrameInfo info;
+            info.transfer = transfer;
+            HdrToneMapper mapper;
+            mapper.configure(info, ToneMapCurve::BT2390);
+
+            auto run = [&](SimdLevel level) {
+                SimdLevelScope scope(level);
+                Mat rgb(1080 - 2, 1917 - 2, CV_8UC3);
+                mapper.convert(frame.view, 2, 2, rgb.cols, rgb.rows, rgb.data, int(rgb.step));
+                return rgb;
+            };
+            auto expected = run(SimdLevel::Scalar);
+            auto actual = run(simd_level_supported());
+            if (simd_level_supported() != SimdLevel::Scalar)
+                parity(QString("tone map %1 [sse2]").arg(transfer == HdrTransfer::PQ ? "pq" : "hlg"), expected, actual);
+        }
+
+        // tone mapping to a smaller view, rotated while written: same as rotating the upright result
+        {
+            HdrFrameInfo info;
+            info.transfer = HdrTransfer::PQ;
+            HdrToneMapper mapper;
+            mapper.configure(info, ToneMapCurve::BT2390);
+            const int w = 959, h = 539;
+            Mat upright(h, w, CV_8UC3);
+            mapper.convert(frame.view, 2, 2, 1917, 1078, w, h, 0, upright.data, int(upright.step));
+
+            const std::pair<int, int> rotations[] = {
+                {90, cv::ROTATE_90_CLOCKWISE}, {180, cv::ROTATE_180}, {270, cv::ROTATE_90_COUNTERCLOCKWISE}};
+            for (const auto& [rotation, code] : rotations)
+            {
+                Mat expected, rotated = (rotation == 180) ? Mat(h, w, CV_8UC3) : Mat(w, h, CV_8UC3);
+                cv::rotate(upright, expected, code);
+                mapper.convert(frame.view, 2, 2, 1917, 1078, w, h, rotation, rotated.data, int(rotated.step));
+                parity(QString("tone map view %1").arg(rotation), expected, rotated);
+            }
+        }
+
+        // interpolation, odd width for the vector tails, the middle of the moving pair is known
+        YuvFrame yuv[3];
+        shifted_yuv_frames(1917, 1080, 8, yuv);
+        auto interpolate = [&](SimdLevel level) {
+            SimdLevelScope scope(level);
+            FrameInterpolator interpolator;
+            YuvFrame out;
+            for (int c = 0; c < 3; c++)
+                out.planes[c] = Mat::zeros(yuv[0].planes[c].size(), CV_8UC1);
+            set_yuv_view(out);
+            interpolator.estimate(yuv[0].view, yuv[2].view, true, false);
+            interpolator.interpolate(yuv[0].view, yuv[2].view, 0.5, out.view);
+            return out;
+        };
+        auto expectedYuv = interpolate(SimdLevel::Scalar);
+        auto actualYuv = interpolate(simd_level_supported());
+        if (simd_level_supported() != SimdLevel::Scalar)
+        {
+            for (int c = 0; c < 3; c++)
+                parity(QString("interpolate plane %1 [sse2]").arg(c), expectedYuv.planes[c], actualYuv.planes[c]);
+        }
+        // blocks at the borders have their vectors clamped
+        const cv::Rect inner(64, 64, 1917 - 128, 1080 - 128);
+        parity("interpolate moving pair", yuv[1].planes[0](inner), expectedYuv.planes[0](inner));
+
+        // denoise, the third frame has both references
+        YuvFrame noisy[3];
+        noisy_yuv_frames(1917, 1080, 6, noisy);
+        auto denoise = [&](SimdLevel level) {
+            SimdLevelScope scope(level);
+            TemporalDenoiser denoiser;
+            denoiser.set_strength(DenoiseStrength::Medium);
+            YuvFrame out;
+            for (int c = 0; c < 3; c++)
+                out.planes[c] = Mat::zeros(noisy[0].planes[c].size(), CV_8UC1);
+            set_yuv_view(out);
+            for (const auto& frame : noisy)
+                denoiser.denoise(frame.view, out.view);
+            return out;
+        };
+        auto expectedDenoise = denoise(SimdLevel::Scalar);
+        auto actualDenoise = denoise(simd_level_supported());
+        if (simd_level_supported() != SimdLevel::Scalar)
+        {
+            for (int c = 0; c < 3; c++)
+                parity(QString("denoise plane %1 [sse2]").arg(c), expectedDenoise.planes[c], actualDenoise.planes[c]);
+        }
+
+        // upscale, odd source width for the row tails
+        YuvFrame small[3];
+        shifted_yuv_frames(853, 480, 0, small);
+        auto upscale = [&](SimdLevel level) {
+            SimdLevelScope scope(level);
+            EdgeUpscaler upscaler;
+            upscaler.upscale(small[0].view, 3840, 2160);
+            const auto& plane = upscaler.output().planes[0];
+            return Mat(2160, 3840, CV_8UC1, plane.data, plane.linesize).clone();
+        };
+        auto expectedUpscale = upscale(SimdLevel::Scalar);
+        auto actualUpscale = upscale(simd_level_supported());
+        if (simd_level_supported() != SimdLevel::Scalar)
+            parity("upscale luma [sse2]", expectedUpscale, actualUpscale);
+
+        // compare metrics, odd width for the row tails, the sums are added in a fixed order
+        auto compare = [&](SimdLevel level, const Mat& a, const Mat& b) {
+            SimdLevelScope scope(level);
+            auto metrics = FrameComparator::measure_luma(a.data, int(a.step), b.data, int(b.step), a.cols, a.rows);
+            return Mat((cv::Mat_<double>(1, 2) << metrics.psnr, metrics.ssim));
+        };
+        const Mat& lumaA = noisy[0].planes[0];
+        const Mat& lumaB = noisy[1].planes[0];
+        auto expectedCompare = compare(SimdLevel::Scalar, lumaA, lumaB);
+        auto actualCompare = compare(simd_level_supported(), lumaA, lumaB);
+        if (simd_level_supported() != SimdLevel::Scalar)
+            parity("compare psnr ssim [sse2]", expectedCompare, actualCompare);
+        parity("compare identical frames", Mat((cv::Mat_<double>(1, 2) << COMPARE_PSNR_MAX, 1.0)),
+               compare(simd_level_supported(), lumaA, lumaA));
+    }
+
+    void parity(const QString& name, const Mat& expected, const Mat& actual)
+    {
+        if (!selected(name))
+            return;
+
+        bool bSame = expected.size() == actual.size() && expected.type() == actual.type() &&
+                     cv::norm(expected, actual, cv::NORM_INF) == 0;
+        m_bParityOk = m_bParityOk && bSame;
+        printf("parity    %-40s %s\n", qUtf8Printable(name), bSame ? "identical" : "DIFFERS");
+
+        QJsonObject obj;
+        obj["name"] = name;
+        obj["identical"] = bSame;
+        m_parity.append(obj);
+    }
+
+    // a median over the time the pipeline can spare, filtered out operations are not checked
+    void budget(const QString& name, const BenchStats& stats, double ms)
+    {
+        if (stats.median <= 0)
+            return;
+
+        bool bOk = stats.median <= ms;
+        m_bBudgetOk = m_bBudgetOk && bOk;
+        printf("budget    %-40s %.3f of %.3f ms %s\n", qUtf8Printable(name), stats.median, ms, bOk ? "ok" : "OVER");
+
+        QJsonObject obj;
+        obj["name"] = name;
+        obj["median_ms"] = stats.median;
+        obj["budget_ms"] = ms;
+        obj["ok"] = bOk;
+        m_budget.append(obj);
+    }
+
+    void run_parity_checks()
+    {
+        const Mat rgb = synthetic_mat(1920, 1080, CV_8UC3);
+
+        // fused lookup of CvEffectChain against the point operations one by one
+        Mat chained = rgb.clone();
+        chained_point_ops(chained);
+        parity("fused point operations", chained, CvEffectChain(fused_point_effects).apply(rgb));
+
+        // band parallel local effects against the single calls
+        for (const auto& [name, op, type] : tiled_ops)
+            parity(QString("tiled %1").arg(name), op(rgb), parallel_rows_img(rgb, type, op));
+
+        // an identity 3D LUT gives the frame back
+        const QString file = QDir::temp().filePath("videoplayer_identity.cube");
+        Lut3D identity;
+        if (write_cube(file, 17, true) && identity.load_cube(file))
+        {
+            Mat graded;
+            identity.apply(rgb, graded);
+            parity("identity 3D LUT", rgb, graded);
+        }
+        QFile::remove(file);
+    }
+
+private:
+    int m_runs;
+    QString m_filter;
+    QJsonArray m_results;
+    QJsonArray m_parity;
+    bool m_bParityOk{true};
+    QJsonArray m_budget;
+    bool m_bBudgetOk{true};
+};
+
+static void quiet_message_handler(QtMsgType type, const QMessageLogContext& context, const QString& msg)
+{
+    // conversions print per call, keep the timing output readable
+    if (type != QtDebugMsg && type != QtInfoMsg)
+        fprintf(stderr, "%s\n", qUtf8Printable(msg));
+}
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv); // fonts for the text drawing functions
+    QCoreApplication::setApplicationName("VideoPlayerBench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Image operations benchmark");
+    parser.addHelpOption();
+    QCommandLineOption runsOption("runs", "Timed runs per operation.", "N", "10");
+    QCommandLineOption filterOption("filter", "Only operations whose name contains text.", "text");
+    QCommandLineOption jsonOption("json", "Write the results as JSON to file.", "file", "image_bench.json");
+    parser.addOptions({runsOption, filterOption, jsonOption});
+    parser.process(app);
+
+    qInstallMessageHandler(quiet_message_handler);
+    cv::utils::logging::setLogLevel(cv::utils::logging::LOG_LEVEL_ERROR);
+
+    ImageBench bench(std::max(1, parser.value(runsOption).toInt()), parser.value(filterOption));
+    bench.run_all();
+
+    QFile file(parser.value(jsonOption));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        fprintf(stderr, "can't write %s\n", qUtf8Printable(file.fileName()));
+        return 2;
+    }
+    file.write(bench.json().toJson());
+    printf("results written to %s\n", qUtf8Printable(file.fileName()));
+
+    return bench.parity_ok() && bench.budget_ok() ? 0 : 1;
+}
@@ -3,11 +3,13 @@
 //
 //      Copy Right @ Steven Huang. All rights reserved.
 //
-// Clickable slider
+// Clickable slider, ranges can be marked over the groove
 // ***********************************************************/
 
 #include <QDebug>
+#include <QPainter>
 #include <QStyleOptionSlider>
+#include <algorithm>
 #include "clickable_slider.h"
 
 ClickableSlider::ClickableSlider(QWidget* parent) : QSlider(parent)
@@ -62,3 +64,35 @@ void ClickableSlider::mousePressEvent(QMouseEvent* event)
         QSlider::mousePressEvent(event);
     }
 }
+
+void ClickableSlider::set_marks(const std::vector<SliderMark>& marks)
+{
+    m_marks = marks;
+    update();
+}
+
+void ClickableSlider::paintEvent(QPaintEvent* event)
+{
+    QSlider::paintEvent(event);
+    if (m_marks.empty() || orientation() != Qt::Horizontal)
+        return;
+
+    QStyleOptionSlider opt;
+    initStyleOption(&opt);
+    auto groove = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderGroove, this);
+    auto handle = style()->subControlRect(QStyle::CC_Slider, &opt, QStyle::SC_SliderHandle, this);
+
+    // same span as the handle centre, see mousePressEvent
+    double x0 = groove.left() + 0.5 * handle.width();
+    double span = groove.width() - handle.width();
+    int h = std::max(3, groove.height() / 2);
+    int y = groove.center().y() - h / 2;
+
+    QPainter painter(this);
+    for (const auto& mark : m_marks)
+    {
+        int left = int(x0 + mark.start * span);
+        int right = int(x0 + mark.end * span);
+        painter.fillRect(QRect(left, y, std::max(2, right - left), h), mark.color);
+    }
+}
@@ -1,7 +1,16 @@
 #pragma once
 
+#include <QColor>
 #include <QMouseEvent>
 #include <QSlider>
+#include <vector>
+
+typedef struct SliderMark
+{
+    double start{0}; // 0 to 1 of the slider range
+    double end{0};
+    QColor color;
+} SliderMark;
 
 class ClickableSlider : public QSlider
 {
@@ -10,9 +19,14 @@ class ClickableSlider : public QSlider
 public:
     explicit ClickableSlider(QWidget* parent = nullptr);
     virtual ~ClickableSlider(){};
+    void set_marks(const std::vector<SliderMark>& marks);
 signals:
     void onClick(int value);
 
 protected:
     void mousePressEvent(QMouseEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    std::vector<SliderMark> m_marks; // ranges painted over the groove
 };
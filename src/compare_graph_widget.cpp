@@ -0,0 +1,165 @@
+// ***********************************************************/
+// compare_graph_widget.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Quality graph of the compare dock. PSNR is drawn on a dB
+// scale on the left, SSIM on the right, the time axis spans
+// the file, so dips of a transcode show where to look.
+// ***********************************************************/
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPainterPath>
+#include <algorithm>
+#include "compare_graph_widget.h"
+
+#define GRAPH_PSNR_MIN 20.0 // dB
+#define GRAPH_PSNR_MAX 60.0
+#define GRAPH_SSIM_MIN 0.8
+#define GRAPH_SSIM_MAX 1.0
+
+CompareGraphWidget::CompareGraphWidget(QWidget* parent) : QWidget(parent)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumHeight(80);
+}
+
+QSize CompareGraphWidget::sizeHint() const
+{
+    return QSize(640, 160);
+}
+
+void CompareGraphWidget::add_samples(const std::vector<CompareSample>& samples)
+{
+    if (samples.empty())
+        return;
+
+    for (const auto& sample : samples)
+        m_samples[sample.time] = sample.metrics;
+    update();
+}
+
+void CompareGraphWidget::set_duration(double duration)
+{
+    m_duration = std::max(duration, 0.0);
+    update();
+}
+
+void CompareGraphWidget::set_position(double pos)
+{
+    m_position = pos;
+    update();
+}
+
+void CompareGraphWidget::clear()
+{
+    m_samples.clear();
+    m_position = 0;
+    update();
+}
+
+bool CompareGraphWidget::summary(CompareMetrics& mean, CompareMetrics& minimum) const
+{
+    if (m_samples.empty())
+        return false;
+
+    mean = CompareMetrics();
+    minimum = {COMPARE_PSNR_MAX, 1.0};
+    for (const auto& [time, metrics] : m_samples)
+    {
+        mean.psnr += metrics.psnr;
+        mean.ssim += metrics.ssim;
+        minimum.psnr = std::min(minimum.psnr, metrics.psnr);
+        minimum.ssim = std::min(minimum.ssim, metrics.ssim);
+    }
+    mean.psnr /= m_samples.size();
+    mean.ssim /= m_samples.size();
+    return true;
+}
+
+QRect CompareGraphWidget::graph_rect() const
+{
+    int margin = 4;
+    int titleHeight = fontMetrics().height();
+    return QRect(margin, margin + titleHeight, width() - 2 * margin, height() - 2 * margin - titleHeight);
+}
+
+void CompareGraphWidget::paintEvent(QPaintEvent* event)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+
+    QRect rt = graph_rect();
+    painter.setPen(Qt::darkGray);
+    painter.drawRect(rt.adjusted(0, 0, -1, -1));
+
+    // the whole file, or what has been measured of a stream without duration
+    double span = m_duration > 0 ? m_duration : (m_samples.empty() ? 0 : m_samples.rbegin()->first);
+    if (span > 0 && rt.width() > 1 && rt.height() > 1)
+    {
+        auto x_of = [&](double time) { return rt.left() + std::clamp(time / span, 0.0, 1.0) * (rt.width() - 1); };
+        auto y_of = [&](double value, double low, double high) {
+            return rt.bottom() - std::clamp((value - low) / (high - low), 0.0, 1.0) * (rt.height() - 1);
+        };
+
+        // samples further apart than a second leave a gap, parts not played
+        QPainterPath psnr, ssim;
+        double last = -1;
+        for (const auto& [time, metrics] : m_samples)
+        {
+            QPointF p(x_of(time), y_of(metrics.psnr, GRAPH_PSNR_MIN, GRAPH_PSNR_MAX));
+            QPointF s(x_of(time), y_of(metrics.ssim, GRAPH_SSIM_MIN, GRAPH_SSIM_MAX));
+            if (last < 0 || time - last > 1.0)
+            {
+                psnr.moveTo(p);
+                ssim.moveTo(s);
+            }
+            else
+            {
+                psnr.lineTo(p);
+                ssim.lineTo(s);
+            }
+            last = time;
+        }
+
+        painter.setPen(QColor(80, 200, 80));
+        painter.drawPath(psnr);
+        painter.setPen(QColor(80, 160, 240));
+        painter.drawPath(ssim);
+
+        painter.setPen(Qt::white);
+        int x = int(x_of(m_position));
+        painter.drawLine(x, rt.top(), x, rt.bottom());
+    }
+
+    CompareMetrics mean, minimum;
+    bool bSummary = summary(mean, minimum);
+    QRect titleRt(rt.left(), 4, rt.width(), fontMetrics().height());
+
+    QString title = QString("PSNR %1-%2 dB").arg(GRAPH_PSNR_MIN).arg(GRAPH_PSNR_MAX);
+    if (bSummary)
+        title += QString(", mean %1 min %2").arg(mean.psnr, 0, 'f', 2).arg(minimum.psnr, 0, 'f', 2);
+    painter.setPen(QColor(80, 200, 80));
+    painter.drawText(titleRt, Qt::AlignLeft | Qt::AlignVCenter, title);
+
+    title = QString("SSIM %1-%2").arg(GRAPH_SSIM_MIN).arg(GRAPH_SSIM_MAX);
+    if (bSummary)
+        title += QString(", mean %1 min %2").arg(mean.ssim, 0, 'f', 4).arg(minimum.ssim, 0, 'f', 4);
+    painter.setPen(QColor(80, 160, 240));
+    painter.drawText(titleRt, Qt::AlignRight | Qt::AlignVCenter, title);
+}
+
+void CompareGraphWidget::mousePressEvent(QMouseEvent* event)
+{
+    QRect rt = graph_rect();
+    double span = m_duration > 0 ? m_duration : (m_samples.empty() ? 0 : m_samples.rbegin()->first);
+    if (event->button() != Qt::LeftButton || span <= 0 || rt.width() <= 1)
+    {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    double ratio = std::clamp((event->position().x() - rt.left()) / (rt.width() - 1), 0.0, 1.0);
+    emit seek_requested(ratio * span);
+}
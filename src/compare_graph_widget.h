@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QWidget>
+#include <map>
+#include <vector>
+#include "frame_compare.h"
+
+// Per frame PSNR and SSIM of the a/b compare mode across the timeline, with
+// the play position. Clicking the graph seeks there.
+class CompareGraphWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit CompareGraphWidget(QWidget* parent = Q_NULLPTR);
+    virtual ~CompareGraphWidget(){};
+
+public slots:
+    void add_samples(const std::vector<CompareSample>& samples);
+    void set_duration(double duration); // seconds, the width of the graph
+    void set_position(double pos);      // seconds from the start
+    void clear();
+
+signals:
+    void seek_requested(double pos); // seconds from the start
+
+public:
+    QSize sizeHint() const override;
+    // mean and minimum over all measured frames, false if none
+    bool summary(CompareMetrics& mean, CompareMetrics& minimum) const;
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+
+private:
+    QRect graph_rect() const;
+
+private:
+    std::map<double, CompareMetrics> m_samples; // by time, a seek back measures again
+    double m_duration{0};
+    double m_position{0};
+};
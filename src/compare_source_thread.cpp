@@ -0,0 +1,273 @@
+// ***********************************************************/
+// compare_source_thread.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Decoder of the b file of the a/b compare mode. It keeps a
+// short queue of frames ahead of the time the player last
+// asked for, and seeks when the player jumps away from it.
+// The player's video thread takes the frame matching each
+// frame of a, so both stay locked to a's clock.
+// ***********************************************************/
+
+#include "compare_source_thread.h"
+#include <QDeadlineTimer>
+#include <QDebug>
+#include <cmath>
+#include "common.h"
+
+#define COMPARE_QUEUE_FRAMES 8   // decoded ahead of the player
+#define COMPARE_TIME_EPSILON 0.005 // seconds, timestamps rounded by the containers
+#define COMPARE_SEEK_DISTANCE 1.0  // seconds apart, b seeks instead of decoding on
+
+CompareSourceThread::CompareSourceThread(QObject* parent) : QThread(parent)
+{
+}
+
+CompareSourceThread::~CompareSourceThread()
+{
+    stop_thread();
+    wait();
+
+    QMutexLocker locker(&m_mutex);
+    clear_frames();
+    locker.unlock();
+    close();
+}
+
+void CompareSourceThread::stop_thread()
+{
+    m_bExitThread = true;
+    m_cond.wakeAll();
+}
+
+int CompareSourceThread::interrupt_cb(void* ctx)
+{
+    return static_cast<CompareSourceThread*>(ctx)->m_bExitThread ? 1 : 0;
+}
+
+bool CompareSourceThread::open(const QString& file)
+{
+    m_file = file;
+    m_ic = avformat_alloc_context();
+    if (!m_ic)
+        return false;
+
+    m_ic->interrupt_callback.callback = interrupt_cb;
+    m_ic->interrupt_callback.opaque = this;
+
+    if (avformat_open_input(&m_ic, file.toUtf8().constData(), nullptr, nullptr) < 0)
+    {
+        qWarning("Compare, failed to open %s.", qUtf8Printable(toNativePath(file)));
+        return false; // m_ic is freed on failure
+    }
+
+    do
+    {
+        if (avformat_find_stream_info(m_ic, nullptr) < 0)
+            break;
+
+        m_index = av_find_best_stream(m_ic, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (m_index < 0 || (m_ic->streams[m_index]->disposition & AV_DISPOSITION_ATTACHED_PIC))
+            break;
+
+        for (unsigned int i = 0; i < m_ic->nb_streams; ++i)
+            m_ic->streams[i]->discard = (int(i) == m_index) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+        const AVStream* st = m_ic->streams[m_index];
+        auto codec = avcodec_find_decoder(st->codecpar->codec_id);
+        if (!codec || !(m_avctx = avcodec_alloc_context3(codec)))
+            break;
+
+        if (avcodec_parameters_to_context(m_avctx, st->codecpar) < 0)
+            break;
+
+        // b has to keep up with a, all cores
+        m_avctx->pkt_timebase = st->time_base;
+        m_avctx->thread_count = 0;
+        if (avcodec_open2(m_avctx, codec, nullptr) < 0)
+            break;
+
+        m_timeBase = av_q2d(st->time_base);
+        m_start = (m_ic->start_time != AV_NOPTS_VALUE) ? m_ic->start_time / double(AV_TIME_BASE) : 0;
+        return true;
+    } while (0);
+
+    qWarning("Compare, no video to decode in %s.", qUtf8Printable(toNativePath(file)));
+    close();
+    return false;
+}
+
+void CompareSourceThread::close()
+{
+    avcodec_free_context(&m_avctx);
+    avformat_close_input(&m_ic);
+}
+
+void CompareSourceThread::clear_frames()
+{
+    for (auto& queued : m_frames)
+        av_frame_free(&queued.frame);
+    m_frames.clear();
+}
+
+void CompareSourceThread::prune_frames(double time)
+{
+    while (m_frames.size() > 1 && m_frames[1].time <= time + COMPARE_TIME_EPSILON)
+    {
+        av_frame_free(&m_frames.front().frame);
+        m_frames.pop_front();
+    }
+}
+
+bool CompareSourceThread::frame_at(double time, AVFrame* dst, double& frameTime, int waitMs)
+{
+    QMutexLocker locker(&m_mutex);
+    m_requested = time;
+
+    // the player jumped, or b fell behind
+    double position = m_frames.empty() ? m_lastTime : m_frames.front().time;
+    bool bAhead = position > time + COMPARE_SEEK_DISTANCE;
+    bool bBehind = !m_bEof && m_lastTime < time - COMPARE_SEEK_DISTANCE;
+    if (!m_bSeekPending && (bAhead || bBehind))
+    {
+        clear_frames();
+        m_seekRequest = time;
+        m_bSeekPending = true;
+        m_lastTime = time;
+        m_bEof = false;
+#if PRINT_COMPARE_SOURCE
+        qDebug("Compare, b seeks to %.3f s.", time);
+#endif
+    }
+
+    QDeadlineTimer deadline(waitMs);
+    while (!m_bExitThread)
+    {
+        prune_frames(time);
+        // the frame after time decoded, so the one before is the one shown
+        bool bReady = !m_frames.empty() && (m_bEof || m_frames.back().time > time + COMPARE_TIME_EPSILON);
+        if (bReady && !m_bSeekPending)
+            break;
+        if (!m_cond.wait(&m_mutex, deadline))
+            break;
+    }
+
+    // room in the queue for the decoder
+    m_cond.wakeAll();
+
+    if (m_frames.empty() || m_bSeekPending)
+        return false;
+
+    av_frame_unref(dst);
+    if (av_frame_ref(dst, m_frames.front().frame) < 0)
+        return false;
+
+    frameTime = m_frames.front().time;
+    return true;
+}
+
+void CompareSourceThread::push_frame(AVFrame* frame, double time)
+{
+    QMutexLocker locker(&m_mutex);
+    // decoded before a seek asked meanwhile
+    if (m_seekRequest >= 0)
+    {
+        av_frame_unref(frame);
+        return;
+    }
+
+    AVFrame* queued = av_frame_alloc();
+    if (!queued)
+    {
+        av_frame_unref(frame);
+        return;
+    }
+    av_frame_move_ref(queued, frame);
+    m_frames.push_back({queued, time});
+    m_lastTime = time;
+
+    // frames from the key frame to the seek target are passed
+    if (m_bSeekPending && time >= m_requested - COMPARE_TIME_EPSILON)
+        m_bSeekPending = false;
+    prune_frames(m_requested);
+    m_cond.wakeAll();
+}
+
+void CompareSourceThread::decode_packet(AVPacket* pkt, AVFrame* frame)
+{
+    int err = av_read_frame(m_ic, pkt);
+    if (err < 0)
+    {
+        if (err != AVERROR_EOF && !avio_feof(m_ic->pb) && !m_bExitThread)
+            qWarning("Compare, read error %d in %s.", err, qUtf8Printable(toNativePath(m_file)));
+        avcodec_send_packet(m_avctx, nullptr); // drain
+    }
+    else
+    {
+        // damaged packets are skipped
+        if (pkt->stream_index == m_index)
+            avcodec_send_packet(m_avctx, pkt);
+        av_packet_unref(pkt);
+    }
+
+    while (!m_bExitThread && avcodec_receive_frame(m_avctx, frame) >= 0)
+    {
+        if (frame->best_effort_timestamp != AV_NOPTS_VALUE)
+            push_frame(frame, frame->best_effort_timestamp * m_timeBase - m_start);
+        else
+            av_frame_unref(frame);
+    }
+
+    if (err < 0)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_bEof = true;
+        m_bSeekPending = false; // the last frames are all there is
+        m_cond.wakeAll();
+    }
+}
+
+void CompareSourceThread::run()
+{
+    if (!m_ic || !m_avctx)
+        return;
+
+    AVPacket* pkt = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+
+    while (pkt && frame && !m_bExitThread)
+    {
+        double seek = -1;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_bExitThread && m_seekRequest < 0 && (m_bEof || m_frames.size() >= COMPARE_QUEUE_FRAMES))
+                m_cond.wait(&m_mutex);
+
+            seek = m_seekRequest;
+            m_seekRequest = -1;
+        }
+        if (m_bExitThread)
+            break;
+
+        if (seek >= 0)
+        {
+            // to the key frame before, frames are decoded on to the target
+            int64_t ts = int64_t((seek + m_start) * AV_TIME_BASE);
+            if (avformat_seek_file(m_ic, -1, INT64_MIN, ts, ts, 0) < 0)
+            {
+                qWarning("Compare, failed to seek %s to %.3f s.", qUtf8Printable(toNativePath(m_file)), seek);
+                QMutexLocker locker(&m_mutex);
+                m_bSeekPending = false; // b goes on where it is
+            }
+            avcodec_flush_buffers(m_avctx);
+        }
+
+        decode_packet(pkt, frame);
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+
+    qDebug("-------- Compare source thread exit.");
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#define PRINT_COMPARE_SOURCE 0
+
+// Second decode pipeline of the a/b compare mode. The b file is demuxed and
+// decoded ahead in this thread, a few frames are queued. The player asks for
+// the frame of b shown at the time of each frame of a, so b follows a's clock
+// without a clock of its own. Times are seconds from the start of each file.
+class CompareSourceThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit CompareSourceThread(QObject* parent = Q_NULLPTR);
+    ~CompareSourceThread();
+
+public:
+    bool open(const QString& file); // before start
+    inline const QString& file() const { return m_file; }
+    // a reference to the frame of b shown at time set to dst, its time in frameTime.
+    // waits up to waitMs for the decoder, seeks b when time is far from its position.
+    bool frame_at(double time, AVFrame* dst, double& frameTime, int waitMs);
+    void stop_thread();
+
+protected:
+    void run() override;
+
+private:
+    typedef struct QueuedFrame
+    {
+        AVFrame* frame{nullptr};
+        double time{0};
+    } QueuedFrame;
+
+    void decode_packet(AVPacket* pkt, AVFrame* frame);
+    void push_frame(AVFrame* frame, double time);
+    void prune_frames(double time); // locked, frames before the one shown at time
+    void clear_frames();            // locked
+    void close();
+    static int interrupt_cb(void* ctx);
+
+private:
+    QString m_file;
+    std::atomic_bool m_bExitThread{false};
+
+    AVFormatContext* m_ic{nullptr};
+    AVCodecContext* m_avctx{nullptr};
+    int m_index{-1};
+    double m_timeBase{0};
+    double m_start{0}; // seconds
+
+    QMutex m_mutex;
+    QWaitCondition m_cond; // frames decoded, or taken and a seek asked
+    std::deque<QueuedFrame> m_frames; // in time order
+    double m_requested{0};            // time last asked for
+    double m_lastTime{0};             // time of the last decoded frame, or the seek target
+    double m_seekRequest{-1};         // not served yet
+    bool m_bSeekPending{false};       // until a frame at the target is decoded
+    bool m_bEof{false};
+};
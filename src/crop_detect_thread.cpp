@@ -0,0 +1,227 @@
+// ***********************************************************/
+// crop_detect_thread.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Background black bar (letterbox/pillarbox) detection.
+// Luma rows and columns of downscaled samples are checked,
+// a crop rect is only accepted after temporal voting so dark
+// scenes don't make it flap.
+// ***********************************************************/
+
+#include "crop_detect_thread.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstdlib>
+
+extern "C"
+{
+#include <libavutil/pixdesc.h>
+}
+
+#define SAMPLE_MAX_WIDTH 320
+#define SAMPLE_MAX_HEIGHT 180
+#define BLACK_LIMIT 24        // luma at or below is black, 8 bits
+#define DARK_FRAME_LIMIT 40   // brightest row mean below this, frame is skipped
+#define HISTORY_SIZE 8        // number of candidates kept
+#define VOTES_TO_CROP 5       // same candidate count to accept a tighter crop
+#define VOTES_TO_EXPAND 2     // content found in the bars, accept quickly
+
+CropDetectThread::CropDetectThread(QObject* parent) : QThread(parent)
+{
+}
+
+CropDetectThread::~CropDetectThread()
+{
+    stop_thread();
+    wait();
+}
+
+void CropDetectThread::stop_thread()
+{
+    QMutexLocker locker(&m_mutex);
+    m_bExitThread = true;
+    m_cond.wakeAll();
+}
+
+QRect CropDetectThread::crop_rect() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cropRect;
+}
+
+bool CropDetectThread::submit_frame(const AVFrame* frame)
+{
+    auto desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)))
+        return false;
+
+    // luma is the first component, 8 bits or a little endian 16 bits container
+    const auto& comp = desc->comp[0];
+    if (comp.plane != 0 || (comp.step != 1 && comp.step != 2) || comp.depth > 16 ||
+        (comp.depth > 8 && (desc->flags & AV_PIX_FMT_FLAG_BE)))
+        return false;
+
+    LumaSample sample;
+    sample.frame_width = frame->width;
+    sample.frame_height = frame->height;
+    sample.step_x = (frame->width + SAMPLE_MAX_WIDTH - 1) / SAMPLE_MAX_WIDTH;
+    sample.step_y = (frame->height + SAMPLE_MAX_HEIGHT - 1) / SAMPLE_MAX_HEIGHT;
+    sample.width = frame->width / sample.step_x;
+    sample.height = frame->height / sample.step_y;
+    sample.data.resize(size_t(sample.width) * sample.height);
+
+    int shift = comp.depth > 8 ? comp.depth - 8 : 0;
+    for (int y = 0; y < sample.height; ++y)
+    {
+        const uint8_t* src = frame->data[0] + int64_t(y) * sample.step_y * frame->linesize[0] + comp.offset;
+        uint8_t* dst = sample.data.data() + size_t(y) * sample.width;
+        int step = sample.step_x * comp.step;
+
+        if (comp.depth > 8)
+        {
+            for (int x = 0; x < sample.width; ++x, src += step)
+                dst[x] = uint8_t((*(const uint16_t*)src) >> shift);
+        }
+        else
+        {
+            for (int x = 0; x < sample.width; ++x, src += step)
+                dst[x] = *src;
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_pending = std::move(sample);
+    m_bPending = true;
+    m_cond.wakeAll();
+    return true;
+}
+
+void CropDetectThread::run()
+{
+    for (;;)
+    {
+        LumaSample sample;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_bPending && !m_bExitThread)
+                m_cond.wait(&m_mutex);
+
+            if (m_bExitThread)
+                break;
+
+            sample = std::move(m_pending);
+            m_bPending = false;
+        }
+
+        QRect rt;
+        if (detect(sample, rt))
+            vote(rt, 2 * std::max(sample.step_x, sample.step_y)); // sampling error
+    }
+
+    qDebug("-------- Crop detect thread exit.");
+}
+
+bool CropDetectThread::detect(const LumaSample& sample, QRect& rt) const
+{
+    const int w = sample.width;
+    const int h = sample.height;
+    if (w < 4 || h < 4)
+        return false;
+
+    std::vector<int> rows(h, 0), cols(w, 0);
+    for (int y = 0; y < h; ++y)
+    {
+        const uint8_t* p = sample.data.data() + size_t(y) * w;
+        for (int x = 0; x < w; ++x)
+        {
+            rows[y] += p[x];
+            cols[x] += p[x];
+        }
+    }
+
+    // a dark scene says nothing about the bars
+    int brightest = 0;
+    for (int y = 0; y < h; ++y)
+        brightest = std::max(brightest, rows[y] / w);
+    if (brightest < DARK_FRAME_LIMIT)
+        return false;
+
+    auto row_black = [&](int y) { return rows[y] <= BLACK_LIMIT * w; };
+    auto col_black = [&](int x) { return cols[x] <= BLACK_LIMIT * h; };
+
+    int top = 0, bottom = h - 1, left = 0, right = w - 1;
+    while (top < bottom && row_black(top))
+        ++top;
+    while (bottom > top && row_black(bottom))
+        --bottom;
+    while (left < right && col_black(left))
+        ++left;
+    while (right > left && col_black(right))
+        --right;
+
+    // back to frame pixels, rounded inwards so no bar is left
+    int x0 = (left > 0) ? (left + 1) * sample.step_x : 0;
+    int y0 = (top > 0) ? (top + 1) * sample.step_y : 0;
+    int x1 = (right < w - 1) ? right * sample.step_x : sample.frame_width;
+    int y1 = (bottom < h - 1) ? bottom * sample.step_y : sample.frame_height;
+
+    // even size and origin for chroma subsampling
+    x0 = (x0 + 1) & ~1;
+    y0 = (y0 + 1) & ~1;
+    x1 &= ~1;
+    y1 &= ~1;
+
+    // content smaller than a quarter each way is not a letterbox
+    if (x1 - x0 < sample.frame_width / 4 || y1 - y0 < sample.frame_height / 4)
+        return false;
+
+    rt = QRect(x0, y0, x1 - x0, y1 - y0);
+    return true;
+}
+
+bool CropDetectThread::similar(const QRect& a, const QRect& b, int tolerance)
+{
+    return std::abs(a.left() - b.left()) <= tolerance && std::abs(a.top() - b.top()) <= tolerance &&
+           std::abs(a.right() - b.right()) <= tolerance && std::abs(a.bottom() - b.bottom()) <= tolerance;
+}
+
+void CropDetectThread::vote(const QRect& rt, int tolerance)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_history.push_back(rt);
+    if (m_history.size() > HISTORY_SIZE)
+        m_history.erase(m_history.begin());
+
+    auto current = m_cropRect;
+    auto bounds = current.adjusted(-tolerance, -tolerance, tolerance, tolerance);
+
+    // picture shows up in the current bars: the last candidates must all be wider
+    if (!current.isEmpty() && !bounds.contains(rt) && m_history.size() >= VOTES_TO_EXPAND)
+    {
+        bool bExpand = true;
+        for (size_t i = m_history.size() - VOTES_TO_EXPAND; i < m_history.size(); ++i)
+            bExpand = bExpand && !bounds.contains(m_history[i]);
+
+        if (bExpand)
+        {
+            m_cropRect = current.united(rt);
+            m_history.clear();
+        }
+    }
+    else
+    {
+        int votes = 0;
+        for (const auto& r : m_history)
+            votes += similar(r, rt, tolerance) ? 1 : 0;
+
+        if (votes >= VOTES_TO_CROP && !similar(rt, current, tolerance))
+            m_cropRect = rt;
+    }
+
+#if PRINT_CROP_DETECT
+    qDebug("crop detect candidate(%d,%d %dx%d), stable(%d,%d %dx%d)", rt.x(), rt.y(), rt.width(), rt.height(),
+           m_cropRect.x(), m_cropRect.y(), m_cropRect.width(), m_cropRect.height());
+#endif
+}
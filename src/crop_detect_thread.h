@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QMutex>
+#include <QRect>
+#include <QThread>
+#include <QWaitCondition>
+#include <vector>
+
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+#define PRINT_CROP_DETECT 0
+
+// Black bar detection on downscaled luma samples. The play thread submits
+// samples, the detected rect only changes after it is voted stable.
+class CropDetectThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit CropDetectThread(QObject* parent = Q_NULLPTR);
+    ~CropDetectThread();
+
+public:
+    // copy a downscaled luma plane of the frame, false if the format has no 8/16 bit luma
+    bool submit_frame(const AVFrame* frame);
+    QRect crop_rect() const; // in frame pixels, empty if nothing to crop
+    void stop_thread();
+
+protected:
+    void run() override;
+
+private:
+    typedef struct LumaSample
+    {
+        std::vector<uint8_t> data;
+        int width{0};  // sample size
+        int height{0};
+        int step_x{1}; // frame pixels per sample pixel
+        int step_y{1};
+        int frame_width{0};
+        int frame_height{0};
+    } LumaSample;
+
+    bool detect(const LumaSample& sample, QRect& rt) const;
+    void vote(const QRect& rt, int tolerance);
+    static bool similar(const QRect& a, const QRect& b, int tolerance);
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_cond;
+    LumaSample m_pending; // latest sample wins
+    bool m_bPending{false};
+    bool m_bExitThread{false};
+
+    QRect m_cropRect;             // stable result
+    std::vector<QRect> m_history; // candidates of recent non-dark samples
+};
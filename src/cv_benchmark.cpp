@@ -0,0 +1,76 @@
+// ***********************************************************/
+// cv_benchmark.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Benchmark of the expensive CV effects against the size of
+// their proxy, with the quality lost by scaling the result up.
+// The fused point operations and the band parallel effects are
+// timed and checked in VideoPlayerBench.
+// ***********************************************************/
+
+#include <QElapsedTimer>
+#include <algorithm>
+#include <vector>
+#include "cv_benchmark.h"
+#include "cv_effect_chain.h"
+#include "imagecv_operations.h"
+
+static double median_ms(std::vector<double>& times)
+{
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+QString cv_proxy_quality_benchmark(int runs)
+{
+    const std::pair<const char*, CvEffect> effects[] = {
+        {"blur", CvEffect::Blur},
+        {"canny", CvEffect::Canny},
+        {"sobel", CvEffect::Sobel},
+        {"scharr", CvEffect::Scharr},
+        {"prewitt", CvEffect::Prewitt},
+        {"laplacian", CvEffect::Laplacian},
+        {"adaptive threshold", CvEffect::ThresholdAdaptive},
+    };
+    const std::pair<const char*, int> modes[] = {{"full", 1}, {"half", 2}, {"quarter", 4}};
+
+    Mat src(1080, 1920, CV_8UC3);
+    cv::randu(src, Scalar::all(0), Scalar::all(255));
+    cv::GaussianBlur(src, src, cv::Size(7, 7), 2);
+
+    QString res = QString("1080p effect quality, ms per frame (median of %1 runs) and PSNR against full\n").arg(runs);
+    for (const auto& [name, effect] : effects)
+    {
+        CvEffectChain chain({effect});
+        res += QString("%1:").arg(name);
+
+        Mat full;
+        for (const auto& [mode, divisor] : modes)
+        {
+            std::vector<double> times;
+            Mat out;
+            for (int i = 0; i < runs; i++)
+            {
+                QElapsedTimer timer;
+                timer.start();
+                out = chain.apply(src, divisor);
+                times.push_back(timer.nsecsElapsed() / 1000000.0);
+            }
+
+            res += QString(" %1 %2").arg(mode).arg(median_ms(times), 0, 'f', 1);
+            if (divisor == 1)
+            {
+                full = out;
+                continue;
+            }
+
+            // scaled up as the video label paints it
+            Mat scaled;
+            cv::resize(out, scaled, full.size(), 0, 0, cv::INTER_LINEAR);
+            res += QString(" (%1 dB)").arg(cv::PSNR(full, scaled), 0, 'f', 1);
+        }
+        res += "\n";
+    }
+    return res;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <QString>
+
+// times the expensive effects at 1080p on full, half and quarter size proxies,
+// with the PSNR of the scaled up proxy output against the full resolution one
+QString cv_proxy_quality_benchmark(int runs = 5);
@@ -0,0 +1,365 @@
+// ***********************************************************/
+// cv_effect_chain.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// CV effects chain of the CV menu. The frame is wrapped as a
+// cv::Mat without copying, every effect reads the previous
+// result, and the final Mat is wrapped back into a QImage.
+// Point operations are fused into one lookup table.
+// ***********************************************************/
+
+#include <QDebug>
+#include <algorithm>
+#include "cv_effect_chain.h"
+#include "imagecv_operations.h"
+#include "imagecv_parallel.h"
+
+CvEffectChain::CvEffectChain(const std::vector<CvEffect>& effects, std::shared_ptr<const Lut3D> lut)
+    : m_lut3d(std::move(lut))
+{
+    for (auto effect : effects)
+    {
+        if (effect == CvEffect::Lut3D && (!m_lut3d || m_lut3d->empty()))
+            continue;
+
+        m_effects.push_back(effect);
+        if (is_point_op(effect))
+        {
+            uchar table[256];
+            point_op_table(effect, table);
+
+            // compose with the previous point operations: new[i] = op[old[i]]
+            if (!m_stages.empty() && m_stages.back().bLut && !m_stages.back().bGray)
+            {
+                auto& lut = m_stages.back().lut;
+                for (int i = 0; i < 256; i++)
+                    lut.at<uchar>(0, i) = table[lut.at<uchar>(0, i)];
+            }
+            else
+            {
+                Stage stage{effect, true, false, cv::Mat(1, 256, CV_8UC1, table).clone()};
+                m_stages.push_back(stage);
+            }
+        }
+        else if (effect == CvEffect::Grayscale && !m_stages.empty() && m_stages.back().bLut)
+        {
+            m_stages.back().bGray = true;
+        }
+        else
+        {
+            m_stages.push_back(Stage{effect});
+        }
+    }
+
+    double pi = 3.14;
+    double a = pi / 180 * 45.0;
+    m_transform = QTransform(cos(a), sin(a), -sin(a), cos(a), 0, 0);
+}
+
+bool CvEffectChain::is_gray_output() const
+{
+    // a colour grading before the gray conversion changes the luma, it needs the rgb frame
+    for (auto effect : m_effects)
+    {
+        if (effect == CvEffect::Lut3D)
+            return false;
+        if (needs_gray(effect))
+            return true;
+    }
+    return false;
+}
+
+bool CvEffectChain::is_expensive() const
+{
+    return std::any_of(m_effects.begin(), m_effects.end(), [](CvEffect effect) { return is_expensive(effect); });
+}
+
+bool CvEffectChain::is_expensive(CvEffect effect)
+{
+    // tens to hundreds of ms per 1080p frame
+    switch (effect)
+    {
+        case CvEffect::ThresholdAdaptive:
+        case CvEffect::Canny:
+        case CvEffect::Blur:
+        case CvEffect::Sobel:
+        case CvEffect::Laplacian:
+        case CvEffect::Scharr:
+        case CvEffect::Prewitt:
+            return true;
+        default:
+            return false;
+    }
+}
+
+cv::Mat CvEffectChain::proxy(const cv::Mat& src, int proxyDivisor, int& copies) const
+{
+    if (proxyDivisor <= 1 || !is_expensive())
+        return src;
+
+    cv::Size size(std::max(1, src.cols / proxyDivisor), std::max(1, src.rows / proxyDivisor));
+    cv::Mat small;
+    cv::resize(src, small, size, 0, 0, cv::INTER_AREA);
+    copies++;
+    return small;
+}
+
+bool CvEffectChain::is_point_op(CvEffect effect)
+{
+    switch (effect)
+    {
+        case CvEffect::Reverse:
+        case CvEffect::ColorReduce:
+        case CvEffect::Gamma:
+        case CvEffect::ContrastBright:
+        case CvEffect::Lighter:
+        case CvEffect::Exposure:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void CvEffectChain::point_op_table(CvEffect effect, uchar table[256])
+{
+    // same results as the single pass functions in imagecv_operations
+    if (effect == CvEffect::ColorReduce)
+    {
+        gen_color_table(table, 256, 20);
+        return;
+    }
+
+    for (int i = 0; i < 256; i++)
+    {
+        switch (effect)
+        {
+            case CvEffect::Reverse: // reverse_img
+                table[i] = uchar(255 - i);
+                break;
+            case CvEffect::Gamma: // gamma_img, 1.2
+                table[i] = saturate_cast<uchar>(pow(i / 255.0, 1.0 / 1.2) * 255.0);
+                break;
+            case CvEffect::ContrastBright: // contrast_bright_img, 1.2, 30
+                table[i] = saturate_cast<uchar>(std::abs(1.2 * i + 30));
+                break;
+            case CvEffect::Lighter: // lighter_img, 1.2
+                table[i] = uchar(std::min(int(i * 1.2f), 255));
+                break;
+            case CvEffect::Exposure: // exposure_img, 50
+                table[i] = uchar(i < 50 ? 255 - i : i);
+                break;
+            default:
+                table[i] = uchar(i);
+                break;
+        }
+    }
+}
+
+void CvEffectChain::lut_to_gray(const cv::Mat& src, const cv::Mat& lut, cv::Mat& dst)
+{
+    // same weights as cv::COLOR_RGB2GRAY, 14 bits fixed point
+    const uchar* t = lut.ptr<uchar>(0);
+    dst.create(src.rows, src.cols, CV_8UC1);
+
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; ++y)
+        {
+            const uchar* s = src.ptr<uchar>(y);
+            uchar* d = dst.ptr<uchar>(y);
+            for (int x = 0; x < src.cols; ++x, s += 3)
+                d[x] = uchar((4899 * t[s[0]] + 9617 * t[s[1]] + 1868 * t[s[2]] + (1 << 13)) >> 14);
+        }
+    });
+}
+
+bool CvEffectChain::needs_gray(CvEffect effect)
+{
+    switch (effect)
+    {
+        case CvEffect::Threshold:
+        case CvEffect::ThresholdAdaptive:
+        case CvEffect::Canny:
+        case CvEffect::Sobel:
+        case CvEffect::Laplacian:
+        case CvEffect::Scharr:
+        case CvEffect::Prewitt:
+        case CvEffect::Grayscale:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool CvEffectChain::wrap_image(const QImage& image, cv::Mat& mat, int& copies)
+{
+    switch (image.format())
+    {
+        case QImage::Format_RGB888:
+            mat = cv::Mat(image.height(), image.width(), CV_8UC3, (void*)image.constBits(), image.bytesPerLine());
+            return true;
+        case QImage::Format_Grayscale8:
+            mat = cv::Mat(image.height(), image.width(), CV_8UC1, (void*)image.constBits(), image.bytesPerLine());
+            return true;
+        case QImage::Format_RGB32:
+        case QImage::Format_ARGB32:
+        {
+            cv::Mat view(image.height(), image.width(), CV_8UC4, (void*)image.constBits(), image.bytesPerLine());
+            cv::cvtColor(view, mat, cv::COLOR_BGRA2RGB);
+            copies++;
+            return true;
+        }
+        default:
+        {
+            if (image.isNull())
+                return false;
+
+            auto conv = image.convertToFormat(QImage::Format_RGB888);
+            cv::Mat view(conv.height(), conv.width(), CV_8UC3, (void*)conv.constBits(), conv.bytesPerLine());
+            mat = view.clone();
+            copies += 2;
+            return true;
+        }
+    }
+}
+
+static void release_mat(void* info)
+{
+    delete static_cast<cv::Mat*>(info);
+}
+
+QImage CvEffectChain::wrap_mat(const cv::Mat& mat)
+{
+    // the QImage keeps a reference of the Mat buffer until it's released
+    auto pMat = new cv::Mat(mat);
+    auto format = (mat.channels() == 1) ? QImage::Format_Grayscale8 : QImage::Format_RGB888;
+    return QImage(pMat->data, pMat->cols, pMat->rows, (qsizetype)pMat->step[0], format, release_mat, pMat);
+}
+
+cv::Mat CvEffectChain::apply_effect(CvEffect effect, const cv::Mat& src) const
+{
+    cv::Mat res;
+    switch (effect)
+    {
+        case CvEffect::Lut3D:
+        {
+            if (src.channels() == 1)
+                cv::cvtColor(src, res, cv::COLOR_GRAY2RGB);
+            else
+                res.create(src.size(), CV_8UC3); // the source may be the decoded frame
+            m_lut3d->apply(src.channels() == 1 ? res : src, res);
+            return res;
+        }
+        case CvEffect::Repeat:
+            return repeat_img(src, 3, 3);
+        case CvEffect::EqualizeHist:
+        {
+            if (src.channels() == 1)
+            {
+                cv::equalizeHist(src, res);
+            }
+            else
+            {
+                std::vector<cv::Mat> channels;
+                cv::split(src, channels);
+                for (auto& c : channels)
+                    cv::equalizeHist(c, c);
+                cv::merge(channels, res);
+            }
+            return res;
+        }
+        case CvEffect::Threshold:
+            return threshold_img(src);
+        case CvEffect::ThresholdAdaptive:
+            return parallel_rows_img(src, CV_8UC1, [](const cv::Mat& m) { return thresholdAdaptive_img(m); });
+        case CvEffect::Canny:
+            return canny_img(src); // hysteresis follows edges across the frame, single call
+        case CvEffect::Blur:
+            return parallel_rows_img(src, src.type(), [](const cv::Mat& m) { return blur_img(m); });
+        case CvEffect::Sobel:
+            return parallel_rows_img(src, CV_8UC1, [](const cv::Mat& m) { return sobel_img_XY(m); });
+        case CvEffect::Laplacian:
+            return parallel_rows_img(src, CV_8UC1, [](const cv::Mat& m) { return laplacian_img(m); });
+        case CvEffect::Scharr:
+            return parallel_rows_img(src, CV_8UC1, [](const cv::Mat& m) { return scharr_img_XY(m); });
+        case CvEffect::Prewitt:
+            return parallel_rows_img(src, CV_8UC1, [](const cv::Mat& m) { return prewitt_img_XY(m); });
+        case CvEffect::Grayscale:
+            return src; // converted before by the chain
+        case CvEffect::Mirror:
+            return flip_img(src);
+        default:
+            return src;
+    }
+}
+
+cv::Mat CvEffectChain::apply_stages(const cv::Mat& src, int& copies, bool& bTransform) const
+{
+    cv::Mat cur = src;
+    bTransform = false;
+
+    for (const auto& stage : m_stages)
+    {
+        if (stage.effect == CvEffect::Transform)
+        {
+            bTransform = true;
+            continue;
+        }
+
+        if (stage.bLut)
+        {
+            cv::Mat res;
+            if (stage.bGray && cur.channels() == 3)
+                lut_to_gray(cur, stage.lut, res);
+            else
+                cv::LUT(cur, stage.lut, res); // all point operations in one pass
+            cur = res;
+            continue;
+        }
+
+        // the frame is rgb, gray effects get one conversion for the rest of the chain
+        if (needs_gray(stage.effect) && cur.channels() == 3)
+        {
+            cv::Mat gray;
+            cv::cvtColor(cur, gray, cv::COLOR_RGB2GRAY);
+            cur = gray;
+            if (stage.effect != CvEffect::Grayscale)
+                copies++;
+        }
+
+        cur = apply_effect(stage.effect, cur);
+    }
+    return cur;
+}
+
+cv::Mat CvEffectChain::apply(const cv::Mat& rgb, int proxyDivisor) const
+{
+    int copies = 0;
+    bool bTransform = false;
+    return apply_stages(proxy(rgb, proxyDivisor, copies), copies, bTransform);
+}
+
+int CvEffectChain::apply(QImage& image, int proxyDivisor) const
+{
+    if (empty())
+        return 0;
+
+    int copies = 0;
+    cv::Mat src;
+    if (!wrap_image(image, src, copies))
+        return copies;
+
+    bool bTransform = false;
+    cv::Mat cur = apply_stages(proxy(src, proxyDivisor, copies), copies, bTransform);
+
+    if (cur.data != src.data || cur.channels() != (image.format() == QImage::Format_Grayscale8 ? 1 : 3))
+        image = wrap_mat(cur);
+
+    if (bTransform)
+        image = image.transformed(m_transform, Qt::FastTransformation);
+
+#if PRINT_CV_EFFECT_COPIES
+    qDebug("cv effects:%d, stages:%d, frame copies:%d", int(m_effects.size()), int(m_stages.size()), copies);
+#endif
+    return copies;
+}
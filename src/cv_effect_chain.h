@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QImage>
+#include <QTransform>
+#include <memory>
+#include <opencv2/core.hpp>
+#include <vector>
+#include "lut3d.h"
+
+#define PRINT_CV_EFFECT_COPIES 0
+
+// effects of the CV menu, in the order they are applied
+enum class CvEffect
+{
+    Lut3D, // colour grading of the loaded .cube file
+    Repeat,
+    EqualizeHist,
+    Threshold,
+    ThresholdAdaptive,
+    Reverse,
+    ColorReduce,
+    Gamma,
+    ContrastBright,
+    Lighter,
+    Exposure,
+    Canny,
+    Blur,
+    Sobel,
+    Laplacian,
+    Scharr,
+    Prewitt,
+    Grayscale,
+    Mirror,
+    Transform
+};
+
+// resolution the expensive effects run at, adaptive follows the video frame rate
+enum class EffectQuality
+{
+    Adaptive,
+    Full,
+    Half,
+    Quarter
+};
+
+// Built once when the effect selection changes. Works on one pixel format for
+// the whole chain (rgb, or gray once an effect needs it), wraps QImage and
+// cv::Mat buffers without copying and converts back at most once.
+// Consecutive point operations are composed into one lookup table, applied
+// in a single pass (together with a following grayscale conversion).
+class CvEffectChain
+{
+public:
+    // lut is used by CvEffect::Lut3D, the effect is skipped without one
+    explicit CvEffectChain(const std::vector<CvEffect>& effects = {}, std::shared_ptr<const Lut3D> lut = nullptr);
+
+public:
+    inline bool empty() const { return m_effects.empty(); }
+    inline const std::vector<CvEffect>& effects() const { return m_effects; }
+    // the result is gray, so the chain can start from the luma plane
+    bool is_gray_output() const;
+    // the chain has effects that are worth running on a downscaled proxy
+    bool is_expensive() const;
+
+    // returns the number of full frame copies made besides the effects' own output.
+    // Expensive chains run on a proxy of 1/proxyDivisor size, the smaller result
+    // is scaled up when painted.
+    int apply(QImage& image, int proxyDivisor = 1) const;
+    cv::Mat apply(const cv::Mat& rgb, int proxyDivisor = 1) const;
+
+    static bool is_point_op(CvEffect effect);
+    static void point_op_table(CvEffect effect, uchar table[256]);
+
+private:
+    typedef struct Stage
+    {
+        CvEffect effect;
+        bool bLut{false};  // composed point operations
+        bool bGray{false}; // lut followed by grayscale, one pass
+        cv::Mat lut;
+    } Stage;
+
+    static bool needs_gray(CvEffect effect);
+    static bool is_expensive(CvEffect effect);
+    cv::Mat proxy(const cv::Mat& src, int proxyDivisor, int& copies) const;
+    static void lut_to_gray(const cv::Mat& src, const cv::Mat& lut, cv::Mat& dst);
+    cv::Mat apply_stages(const cv::Mat& src, int& copies, bool& bTransform) const;
+    static bool wrap_image(const QImage& image, cv::Mat& mat, int& copies);
+    static QImage wrap_mat(const cv::Mat& mat);
+    cv::Mat apply_effect(CvEffect effect, const cv::Mat& src) const;
+
+private:
+    std::vector<CvEffect> m_effects;
+    std::vector<Stage> m_stages;
+    std::shared_ptr<const Lut3D> m_lut3d;
+    QTransform m_transform;
+};
@@ -0,0 +1,384 @@
+// ***********************************************************/
+// edge_upscaler.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Edge directed upscaler of low resolution video to the
+// display size. Luma doubling with directional cubic
+// interpolation, resampling to the exact size and adaptive
+// sharpening without halos, so painting scales no more.
+// ***********************************************************/
+
+#include "edge_upscaler.h"
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include "simd_level.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define UPSCALE_SSE 1
+#include <emmintrin.h>
+#else
+#define UPSCALE_SSE 0
+#endif
+
+#define UPSCALE_BORDER 2     // replicated pixels around the source of a doubling
+#define UPSCALE_DOUBLE_MAX 1.15 // doubling while it overshoots the display size by less
+
+// between b and c, a and d are the outer taps
+static inline int cubic(int a, int b, int c, int d)
+{
+    return std::clamp((9 * (b + c) - a - d + 8) >> 4, 0, 255);
+}
+
+// p0 where the change g0 along its direction is clearly lower, then p1, else the mean
+static inline int directional(int p0, int g0, int p1, int g1)
+{
+    if (g1 - g0 > (((g0 + 1) * 5) >> 5))
+        return p0;
+    if (g0 - g1 > (((g1 + 1) * 5) >> 5))
+        return p1;
+    return (p0 + p1 + 1) >> 1;
+}
+
+// centres of the 2x2 blocks of row 1, r are the rows -1 to 2 around it
+static void diagonal_row_c(const uint8_t* const r[4], uint8_t* dst, int x, int n)
+{
+    for (; x < n; x++)
+    {
+        int gb = 0, ga = 0; // change along "\" and along "/"
+        for (int j = 0; j < 3; j++)
+        {
+            for (int i = -1; i <= 1; i++)
+            {
+                gb += std::abs(r[j][x + i] - r[j + 1][x + i + 1]);
+                ga += std::abs(r[j][x + i + 1] - r[j + 1][x + i]);
+            }
+        }
+        int pb = cubic(r[0][x - 1], r[1][x], r[2][x + 1], r[3][x + 2]);
+        int pa = cubic(r[0][x + 2], r[1][x + 1], r[2][x], r[3][x - 1]);
+        dst[x] = uint8_t(directional(pb, gb, pa, ga));
+    }
+}
+
+// rows 2y and 2y + 1 of the doubled picture. s are the source rows y - 1 to y + 2,
+// a the diagonal rows y - 2 to y + 1, d0 and d1 start at pixel 2x
+static void cross_row_c(const uint8_t* const s[4], const uint8_t* const a[4], uint8_t* d0, uint8_t* d1, int x, int n)
+{
+    for (; x < n; x++)
+    {
+        // between s1[x] and s1[x + 1]
+        int gh = std::abs(s[1][x + 2] - s[1][x + 1]) + std::abs(s[1][x] - s[1][x - 1]);
+        int gv = std::abs(a[3][x] - a[2][x]) + std::abs(a[1][x] - a[0][x]);
+        for (int k = 0; k <= 2; k++)
+        {
+            gh += std::abs(s[k][x + 1] - s[k][x]);
+            gv += std::abs(a[2][x + k - 1] - a[1][x + k - 1]);
+        }
+        int h = directional(cubic(s[1][x - 1], s[1][x], s[1][x + 1], s[1][x + 2]), gh,
+                            cubic(a[0][x], a[1][x], a[2][x], a[3][x]), gv);
+
+        // between s1[x] and s2[x]
+        gv = std::abs(s[3][x] - s[2][x]) + std::abs(s[1][x] - s[0][x]);
+        gh = std::abs(a[2][x + 1] - a[2][x]) + std::abs(a[2][x - 1] - a[2][x - 2]);
+        for (int k = 0; k <= 2; k++)
+        {
+            gv += std::abs(s[2][x + k - 1] - s[1][x + k - 1]);
+            gh += std::abs(a[k + 1][x] - a[k + 1][x - 1]);
+        }
+        int v = directional(cubic(s[0][x], s[1][x], s[2][x], s[3][x]), gv,
+                            cubic(a[2][x - 2], a[2][x - 1], a[2][x], a[2][x + 1]), gh);
+
+        d0[2 * x] = s[1][x];
+        d0[2 * x + 1] = uint8_t(h);
+        d1[2 * x] = uint8_t(v);
+        d1[2 * x + 1] = a[2][x];
+    }
+}
+
+// unsharp mask of the 3x3 blur by the local contrast, within the 3x3 range.
+// u, c and w are the rows above, at and below, pixel x - 1 and x + 1 exist
+static inline int sharpen_pixel(const uint8_t* u, const uint8_t* c, const uint8_t* w, int xl, int x, int xr)
+{
+    int blur = (u[xl] + 2 * u[x] + u[xr] + 2 * (c[xl] + 2 * c[x] + c[xr]) + w[xl] + 2 * w[x] + w[xr] + 8) >> 4;
+    int lo = std::min({u[xl], u[x], u[xr], c[xl], c[x], c[xr], w[xl], w[x], w[xr]});
+    int hi = std::max({u[xl], u[x], u[xr], c[xl], c[x], c[xr], w[xl], w[x], w[xr]});
+    int diff = c[x] - blur;
+    int ad = std::abs(diff);
+    int amount = ad < 2 ? 0 : (ad < 32 ? UPSCALE_SHARPEN : UPSCALE_SHARPEN >> 1); // noise and strong edges less
+    return std::clamp(c[x] + ((diff * amount) >> 4), lo, hi);
+}
+
+static void sharpen_row_c(const uint8_t* u, const uint8_t* c, const uint8_t* w, uint8_t* dst, int x, int end, int n)
+{
+    for (; x < end; x++)
+        dst[x] = uint8_t(sharpen_pixel(u, c, w, std::max(x - 1, 0), x, std::min(x + 1, n - 1)));
+}
+
+#if UPSCALE_SSE
+static inline __m128i load8(const uint8_t* p)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)), _mm_setzero_si128());
+}
+
+static inline __m128i absdiff16(__m128i a, __m128i b)
+{
+    return _mm_max_epi16(_mm_sub_epi16(a, b), _mm_sub_epi16(b, a));
+}
+
+static inline __m128i cubic_sse2(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    __m128i sum = _mm_sub_epi16(_mm_mullo_epi16(_mm_add_epi16(b, c), _mm_set1_epi16(9)), _mm_add_epi16(a, d));
+    sum = _mm_srai_epi16(_mm_add_epi16(sum, _mm_set1_epi16(8)), 4);
+    return _mm_min_epi16(_mm_max_epi16(sum, _mm_setzero_si128()), _mm_set1_epi16(255));
+}
+
+static inline __m128i directional_sse2(__m128i p0, __m128i g0, __m128i p1, __m128i g1)
+{
+    const __m128i one = _mm_set1_epi16(1), five = _mm_set1_epi16(5);
+    __m128i t0 = _mm_srai_epi16(_mm_mullo_epi16(_mm_add_epi16(g0, one), five), 5);
+    __m128i t1 = _mm_srai_epi16(_mm_mullo_epi16(_mm_add_epi16(g1, one), five), 5);
+    __m128i m0 = _mm_cmpgt_epi16(_mm_sub_epi16(g1, g0), t0);
+    __m128i m1 = _mm_cmpgt_epi16(_mm_sub_epi16(g0, g1), t1);
+    __m128i mean = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(p0, p1), one), 1);
+    return _mm_or_si128(_mm_or_si128(_mm_and_si128(m0, p0), _mm_and_si128(m1, p1)),
+                        _mm_andnot_si128(_mm_or_si128(m0, m1), mean));
+}
+
+static void diagonal_row_sse2(const uint8_t* const r[4], uint8_t* dst, int n)
+{
+    int x = 0;
+    for (; x + 8 <= n; x += 8)
+    {
+        __m128i gb = _mm_setzero_si128(), ga = _mm_setzero_si128();
+        for (int j = 0; j < 3; j++)
+        {
+            for (int i = -1; i <= 1; i++)
+            {
+                gb = _mm_add_epi16(gb, absdiff16(load8(r[j] + x + i), load8(r[j + 1] + x + i + 1)));
+                ga = _mm_add_epi16(ga, absdiff16(load8(r[j] + x + i + 1), load8(r[j + 1] + x + i)));
+            }
+        }
+        __m128i pb = cubic_sse2(load8(r[0] + x - 1), load8(r[1] + x), load8(r[2] + x + 1), load8(r[3] + x + 2));
+        __m128i pa = cubic_sse2(load8(r[0] + x + 2), load8(r[1] + x + 1), load8(r[2] + x), load8(r[3] + x - 1));
+        __m128i p = directional_sse2(pb, gb, pa, ga);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(p, p));
+    }
+    diagonal_row_c(r, dst, x, n);
+}
+
+static void cross_row_sse2(const uint8_t* const s[4], const uint8_t* const a[4], uint8_t* d0, uint8_t* d1, int n)
+{
+    int x = 0;
+    for (; x + 8 <= n; x += 8)
+    {
+        const __m128i s1 = load8(s[1] + x), a2 = load8(a[2] + x);
+
+        __m128i gh = _mm_add_epi16(absdiff16(load8(s[1] + x + 2), load8(s[1] + x + 1)),
+                                   absdiff16(s1, load8(s[1] + x - 1)));
+        __m128i gv = _mm_add_epi16(absdiff16(load8(a[3] + x), a2), absdiff16(load8(a[1] + x), load8(a[0] + x)));
+        for (int k = 0; k <= 2; k++)
+        {
+            gh = _mm_add_epi16(gh, absdiff16(load8(s[k] + x + 1), load8(s[k] + x)));
+            gv = _mm_add_epi16(gv, absdiff16(load8(a[2] + x + k - 1), load8(a[1] + x + k - 1)));
+        }
+        __m128i h = directional_sse2(cubic_sse2(load8(s[1] + x - 1), s1, load8(s[1] + x + 1), load8(s[1] + x + 2)),
+                                     gh, cubic_sse2(load8(a[0] + x), load8(a[1] + x), a2, load8(a[3] + x)), gv);
+
+        gv = _mm_add_epi16(absdiff16(load8(s[3] + x), load8(s[2] + x)), absdiff16(s1, load8(s[0] + x)));
+        gh = _mm_add_epi16(absdiff16(load8(a[2] + x + 1), a2), absdiff16(load8(a[2] + x - 1), load8(a[2] + x - 2)));
+        for (int k = 0; k <= 2; k++)
+        {
+            gv = _mm_add_epi16(gv, absdiff16(load8(s[2] + x + k - 1), load8(s[1] + x + k - 1)));
+            gh = _mm_add_epi16(gh, absdiff16(load8(a[k + 1] + x), load8(a[k + 1] + x - 1)));
+        }
+        __m128i v = directional_sse2(cubic_sse2(load8(s[0] + x), s1, load8(s[2] + x), load8(s[3] + x)), gv,
+                                     cubic_sse2(load8(a[2] + x - 2), load8(a[2] + x - 1), a2, load8(a[2] + x + 1)), gh);
+
+        // known and new pixels interleaved
+        __m128i top = _mm_packus_epi16(s1, h), bottom = _mm_packus_epi16(v, a2);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d0 + 2 * x), _mm_unpacklo_epi8(top, _mm_srli_si128(top, 8)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d1 + 2 * x),
+                         _mm_unpacklo_epi8(bottom, _mm_srli_si128(bottom, 8)));
+    }
+    cross_row_c(s, a, d0, d1, x, n);
+}
+
+static void sharpen_row_sse2(const uint8_t* u, const uint8_t* c, const uint8_t* w, uint8_t* dst, int n)
+{
+    const __m128i eight = _mm_set1_epi16(8), two = _mm_set1_epi16(2), big = _mm_set1_epi16(32);
+    const __m128i amount = _mm_set1_epi16(UPSCALE_SHARPEN), half = _mm_set1_epi16(UPSCALE_SHARPEN >> 1);
+
+    sharpen_row_c(u, c, w, dst, 0, 1, n);
+    int x = 1;
+    for (; x + 9 <= n; x += 8)
+    {
+        __m128i rows[3][3];
+        const uint8_t* src[3] = {u, c, w};
+        for (int j = 0; j < 3; j++)
+        {
+            rows[j][0] = load8(src[j] + x - 1);
+            rows[j][1] = load8(src[j] + x);
+            rows[j][2] = load8(src[j] + x + 1);
+        }
+
+        __m128i lo = rows[0][0], hi = rows[0][0], blur = eight;
+        for (int j = 0; j < 3; j++)
+        {
+            __m128i row = _mm_add_epi16(_mm_add_epi16(rows[j][0], rows[j][2]), _mm_slli_epi16(rows[j][1], 1));
+            blur = _mm_add_epi16(blur, j == 1 ? _mm_slli_epi16(row, 1) : row);
+            for (int i = 0; i < 3; i++)
+            {
+                lo = _mm_min_epi16(lo, rows[j][i]);
+                hi = _mm_max_epi16(hi, rows[j][i]);
+            }
+        }
+        blur = _mm_srai_epi16(blur, 4);
+
+        __m128i diff = _mm_sub_epi16(rows[1][1], blur);
+        __m128i ad = _mm_max_epi16(diff, _mm_sub_epi16(_mm_setzero_si128(), diff));
+        __m128i weak = _mm_cmplt_epi16(ad, big);
+        __m128i weight = _mm_or_si128(_mm_and_si128(weak, amount), _mm_andnot_si128(weak, half));
+        weight = _mm_andnot_si128(_mm_cmplt_epi16(ad, two), weight);
+
+        __m128i p = _mm_add_epi16(rows[1][1], _mm_srai_epi16(_mm_mullo_epi16(diff, weight), 4));
+        p = _mm_min_epi16(_mm_max_epi16(p, lo), hi);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(p, p));
+    }
+    sharpen_row_c(u, c, w, dst, x, n, n);
+}
+#endif
+
+bool EdgeUpscaler::worth_upscaling(int srcWidth, int srcHeight, int width, int height)
+{
+    return srcWidth > 0 && srcHeight > 0 && width >= srcWidth * UPSCALE_MIN_FACTOR &&
+           height >= srcHeight * UPSCALE_MIN_FACTOR;
+}
+
+void EdgeUpscaler::double_luma(const cv::Mat& src, cv::Mat& dst, bool bSimd)
+{
+    const int b = UPSCALE_BORDER;
+    cv::copyMakeBorder(src, m_padded, b, b, b, b, cv::BORDER_REPLICATE);
+    m_diagonal.create(src.rows, src.cols, CV_8UC1);
+    dst.create(src.rows * 2, src.cols * 2, CV_8UC1);
+
+    auto padded = [](const cv::Mat& m, int y) { return m.ptr<uint8_t>(y + UPSCALE_BORDER) + UPSCALE_BORDER; };
+
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++)
+        {
+            const uint8_t* r[4] = {padded(m_padded, y - 1), padded(m_padded, y), padded(m_padded, y + 1),
+                                   padded(m_padded, y + 2)};
+#if UPSCALE_SSE
+            if (bSimd)
+            {
+                diagonal_row_sse2(r, m_diagonal.ptr<uint8_t>(y), src.cols);
+                continue;
+            }
+#endif
+            diagonal_row_c(r, m_diagonal.ptr<uint8_t>(y), 0, src.cols);
+        }
+    });
+
+    cv::copyMakeBorder(m_diagonal, m_diagPadded, b, b, b, b, cv::BORDER_REPLICATE);
+
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++)
+        {
+            const uint8_t* s[4] = {padded(m_padded, y - 1), padded(m_padded, y), padded(m_padded, y + 1),
+                                   padded(m_padded, y + 2)};
+            const uint8_t* a[4] = {padded(m_diagPadded, y - 2), padded(m_diagPadded, y - 1), padded(m_diagPadded, y),
+                                   padded(m_diagPadded, y + 1)};
+            uint8_t* d0 = dst.ptr<uint8_t>(2 * y);
+            uint8_t* d1 = dst.ptr<uint8_t>(2 * y + 1);
+#if UPSCALE_SSE
+            if (bSimd)
+            {
+                cross_row_sse2(s, a, d0, d1, src.cols);
+                continue;
+            }
+#endif
+            cross_row_c(s, a, d0, d1, 0, src.cols);
+        }
+    });
+}
+
+void EdgeUpscaler::sharpen_luma(const cv::Mat& src, cv::Mat& dst, bool bSimd) const
+{
+    dst.create(src.rows, src.cols, CV_8UC1);
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; y++)
+        {
+            const uint8_t* u = src.ptr<uint8_t>(std::max(y - 1, 0));
+            const uint8_t* c = src.ptr<uint8_t>(y);
+            const uint8_t* w = src.ptr<uint8_t>(std::min(y + 1, src.rows - 1));
+#if UPSCALE_SSE
+            if (bSimd)
+            {
+                sharpen_row_sse2(u, c, w, dst.ptr<uint8_t>(y), src.cols);
+                continue;
+            }
+#endif
+            sharpen_row_c(u, c, w, dst.ptr<uint8_t>(y), 0, src.cols, src.cols);
+        }
+    });
+}
+
+bool EdgeUpscaler::upscale(const InterpPicture& src, int width, int height)
+{
+    const auto& luma = src.planes[0];
+    const bool bNV12 = src.nb_planes == 2 && src.planes[1].step == 2;
+    if (!luma.data || src.width < 2 || src.height < 2 || width < 1 || height < 1 ||
+        (src.nb_planes != 3 && !bNV12))
+        return false;
+
+    for (int p = 1; p < src.nb_planes; p++)
+    {
+        if (src.planes[p].shift_w != 1 || src.planes[p].shift_h != 1)
+            return false; // 4:2:0 only
+    }
+
+    const bool bSimd = simd_level() != SimdLevel::Scalar;
+
+    // doubled while that stays close to the display size, then resampled
+    cv::Mat doubled(src.height, src.width, CV_8UC1, luma.data, luma.linesize);
+    m_doublings = 0;
+    while (doubled.cols * 2 <= width * UPSCALE_DOUBLE_MAX && doubled.rows * 2 <= height * UPSCALE_DOUBLE_MAX)
+    {
+        cv::Mat& next = m_doubled[m_doublings % 2];
+        double_luma(doubled, next, bSimd);
+        doubled = next;
+        m_doublings++;
+    }
+
+    // a doubled pixel X is source pixel X / 2^n, the display pixel centres map
+    // to the source ones
+    const double scale = 1 << m_doublings;
+    const double sx = double(src.width) / width, sy = double(src.height) / height;
+    cv::Matx23d toDoubled(sx * scale, 0, (0.5 * sx - 0.5) * scale, 0, sy * scale, (0.5 * sy - 0.5) * scale);
+    cv::warpAffine(doubled, m_resampled, toDoubled, cv::Size(width, height), cv::INTER_CUBIC | cv::WARP_INVERSE_MAP,
+                   cv::BORDER_REPLICATE);
+    sharpen_luma(m_resampled, m_luma, bSimd);
+
+    // chroma carries little detail
+    const cv::Size chromaSize((width + 1) / 2, (height + 1) / 2);
+    for (int p = 1; p < src.nb_planes; p++)
+    {
+        const auto& plane = src.planes[p];
+        cv::Mat chroma((src.height + 1) / 2, (src.width + 1) / 2, bNV12 ? CV_8UC2 : CV_8UC1, plane.data,
+                       plane.linesize);
+        cv::resize(chroma, m_chroma[p - 1], chromaSize, 0, 0, cv::INTER_LINEAR);
+    }
+
+    m_output = src;
+    m_output.width = width;
+    m_output.height = height;
+    m_output.planes[0].data = m_luma.data;
+    m_output.planes[0].linesize = int(m_luma.step);
+    for (int p = 1; p < src.nb_planes; p++)
+    {
+        m_output.planes[p].data = m_chroma[p - 1].data;
+        m_output.planes[p].linesize = int(m_chroma[p - 1].step);
+    }
+    return true;
+}
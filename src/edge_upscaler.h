@@ -0,0 +1,46 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include "frame_interpolator.h"
+
+#define PRINT_UPSCALE_TIME 0
+
+#define UPSCALE_MIN_FACTOR 1.5 // smaller factors are left to painting
+#define UPSCALE_SHARPEN 12     // adaptive sharpening amount, 1/16
+
+// Upscaler of 8 bits yuv 4:2:0 pictures to an exact display size. Luma is
+// doubled with edge directed interpolation, each new pixel is a cubic along
+// the diagonal, horizontal or vertical direction of least change, or the mean
+// of both where none dominates. The doubled luma is resampled to the display
+// size and sharpened by its local contrast, limited to the range of the 3x3
+// neighbourhood so edges get no halos. Chroma is scaled bilinear. Row bands
+// run in parallel, pixels 8 at a time with SSE2.
+class EdgeUpscaler
+{
+public:
+    EdgeUpscaler() = default;
+
+public:
+    // src to width x height, yuv420p or nv12 like src
+    bool upscale(const InterpPicture& src, int width, int height);
+    // valid until the next upscale
+    inline const InterpPicture& output() const { return m_output; }
+    inline int doublings() const { return m_doublings; }
+
+    static bool worth_upscaling(int srcWidth, int srcHeight, int width, int height);
+
+private:
+    void double_luma(const cv::Mat& src, cv::Mat& dst, bool bSimd);
+    void sharpen_luma(const cv::Mat& src, cv::Mat& dst, bool bSimd) const;
+
+private:
+    cv::Mat m_padded;     // source of a doubling with a replicated border
+    cv::Mat m_diagonal;   // centres of the 2x2 source blocks
+    cv::Mat m_diagPadded;
+    cv::Mat m_doubled[2]; // luma after each doubling, used in turn
+    cv::Mat m_resampled;  // luma at the display size, before sharpening
+    cv::Mat m_luma;
+    cv::Mat m_chroma[2];  // u and v, or interleaved uv of nv12
+    InterpPicture m_output;
+    int m_doublings{0};
+};
@@ -0,0 +1,271 @@
+// ***********************************************************/
+// face_tracker.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Low cadence face detection with tracking in between. Haar
+// detection of a whole frame takes longer than a frame lasts,
+// so it runs in the background on a small gray sample. Boxes
+// follow the faces by the median optical flow of corners found
+// inside them. A detection result is moved from its own frame
+// to the current one before it replaces the tracked boxes.
+// ***********************************************************/
+
+#include "face_tracker.h"
+#include <QDebug>
+#include <algorithm>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+#include "imagecv_operations.h"
+
+#define FACE_CASCADE_FILE "./res/haarcascade_frontalface_alt2.xml"
+#define SAMPLE_MAX_WIDTH 480  // detection and tracking size
+#define DETECT_INTERVAL 10    // frames between detections
+#define SCENE_CHANGE_LIMIT 30 // mean absolute difference of thumbnails, 8 bits
+#define MIN_TRACK_POINTS 4    // corners needed to move a box
+
+FaceTracker::FaceTracker(QObject* parent) : QThread(parent)
+{
+}
+
+FaceTracker::~FaceTracker()
+{
+    stop_thread();
+    wait();
+}
+
+void FaceTracker::stop_thread()
+{
+    QMutexLocker locker(&m_mutex);
+    m_bExitThread = true;
+    m_cond.wakeAll();
+}
+
+void FaceTracker::reset()
+{
+    m_prevGray.release();
+    m_boxes.clear();
+    m_lastDetect = -1;
+
+    // a frame being detected still finishes, its result is dropped by size or scene
+    QMutexLocker locker(&m_mutex);
+    if (m_bPending)
+    {
+        m_bPending = false;
+        m_bBusy = false;
+    }
+    m_bResult = false;
+}
+
+cv::Mat FaceTracker::sample_gray(const QImage& image)
+{
+    QImage img = image;
+    if (img.format() != QImage::Format_RGB888 && img.format() != QImage::Format_Grayscale8)
+        img = img.convertToFormat(QImage::Format_RGB888);
+
+    cv::Mat src(img.height(), img.width(), img.format() == QImage::Format_Grayscale8 ? CV_8UC1 : CV_8UC3,
+                (void*)img.constBits(), size_t(img.bytesPerLine()));
+
+    // scale down first, the color conversion then runs on the small sample
+    cv::Mat small = src;
+    if (src.cols > SAMPLE_MAX_WIDTH)
+    {
+        double fx = double(SAMPLE_MAX_WIDTH) / src.cols;
+        cv::resize(src, small, cv::Size(), fx, fx, cv::INTER_AREA);
+    }
+
+    cv::Mat gray;
+    if (small.channels() == 3)
+        cv::cvtColor(small, gray, cv::COLOR_RGB2GRAY);
+    else
+        gray = small.clone(); // the frame buffer is not kept
+    return gray;
+}
+
+bool FaceTracker::scene_changed(const cv::Mat& prev, const cv::Mat& cur)
+{
+    cv::Mat a, b;
+    cv::resize(prev, a, cv::Size(32, 18), 0, 0, cv::INTER_AREA);
+    cv::resize(cur, b, cv::Size(32, 18), 0, 0, cv::INTER_AREA);
+    return cv::norm(a, b, cv::NORM_L1) / a.total() > SCENE_CHANGE_LIMIT;
+}
+
+std::vector<cv::Rect2f> FaceTracker::move_boxes(const cv::Mat& prev, const cv::Mat& cur,
+                                                const std::vector<cv::Rect2f>& boxes)
+{
+    std::vector<cv::Rect2f> moved;
+    cv::Rect2f bounds(0, 0, float(cur.cols), float(cur.rows));
+
+    for (const auto& box : boxes)
+    {
+        cv::Rect roi = cv::Rect(box) & cv::Rect(0, 0, prev.cols, prev.rows);
+        if (roi.width < 8 || roi.height < 8)
+            continue;
+
+        // a flat box has nothing to follow, it stays until the next detection
+        std::vector<cv::Point2f> points, next;
+        cv::goodFeaturesToTrack(prev(roi), points, 30, 0.01, 3);
+        if (points.size() < MIN_TRACK_POINTS)
+        {
+            moved.push_back(box);
+            continue;
+        }
+        for (auto& pt : points)
+            pt += cv::Point2f(float(roi.x), float(roi.y));
+
+        std::vector<uchar> status;
+        std::vector<float> err;
+        cv::calcOpticalFlowPyrLK(prev, cur, points, next, status, err, cv::Size(15, 15), 2);
+
+        std::vector<float> dx, dy;
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            if (status[i])
+            {
+                dx.push_back(next[i].x - points[i].x);
+                dy.push_back(next[i].y - points[i].y);
+            }
+        }
+        if (dx.size() < MIN_TRACK_POINTS)
+            continue; // lost
+
+        // the median ignores corners of the background inside the box
+        std::nth_element(dx.begin(), dx.begin() + dx.size() / 2, dx.end());
+        std::nth_element(dy.begin(), dy.begin() + dy.size() / 2, dy.end());
+        cv::Rect2f res = box + cv::Point2f(dx[dx.size() / 2], dy[dy.size() / 2]);
+
+        if ((res & bounds).area() > res.area() / 2)
+            moved.push_back(res);
+    }
+    return moved;
+}
+
+void FaceTracker::submit_detect(const cv::Mat& gray)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_bBusy)
+        return;
+
+    m_pending.gray = gray;
+    m_pending.frame = m_frame;
+    m_pending.timer.start();
+    m_pending.faces.clear();
+    m_bPending = true;
+    m_bBusy = true;
+    m_lastDetect = m_frame;
+    m_cond.wakeAll();
+}
+
+std::vector<QRect> FaceTracker::track(const QImage& image)
+{
+    std::vector<QRect> rects;
+    if (image.isNull())
+        return rects;
+
+    cv::Mat gray = sample_gray(image);
+    if (!m_prevGray.empty() && m_prevGray.size() != gray.size())
+        reset();
+
+    bool bDetect = m_lastDetect < 0 || m_frame - m_lastDetect >= DETECT_INTERVAL;
+    if (!m_prevGray.empty())
+    {
+        if (scene_changed(m_prevGray, gray))
+        {
+            // the old boxes belong to another shot
+            m_boxes.clear();
+            bDetect = true;
+        }
+        else
+        {
+            m_boxes = move_boxes(m_prevGray, gray, m_boxes);
+        }
+    }
+
+    DetectJob result;
+    bool bResult = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_bResult)
+        {
+            result = std::move(m_result);
+            m_bResult = false;
+            bResult = true;
+        }
+    }
+
+    if (bResult)
+    {
+        // detected on an older frame, bring the boxes up to this one
+        if (result.gray.size() != gray.size() || scene_changed(result.gray, gray))
+            bDetect = true; // of another video or shot
+        else
+            m_boxes = move_boxes(result.gray, gray, result.faces);
+
+        m_latencyMs = result.timer.nsecsElapsed() / 1000000.0;
+        m_latencyFrames = int(m_frame - result.frame);
+
+#if PRINT_FACE_DETECT
+        qDebug("faces:%d, detection latency:%.1f ms, %d frames", int(m_boxes.size()), double(m_latencyMs),
+               int(m_latencyFrames));
+#endif
+    }
+
+    if (bDetect)
+        submit_detect(gray);
+
+    m_prevGray = gray;
+    m_frame++;
+
+    double scale = double(image.width()) / gray.cols;
+    for (const auto& box : m_boxes)
+    {
+        rects.emplace_back(cvRound(box.x * scale), cvRound(box.y * scale), cvRound(box.width * scale),
+                           cvRound(box.height * scale));
+    }
+    return rects;
+}
+
+bool FaceTracker::load_cascade()
+{
+    if (!m_cascade.empty())
+        return true;
+
+    if (!m_cascade.load(FACE_CASCADE_FILE))
+    {
+        qWarning("Failed to load face cascade: %s", FACE_CASCADE_FILE);
+        return false;
+    }
+    return true;
+}
+
+void FaceTracker::run()
+{
+    bool bCascade = load_cascade();
+
+    for (;;)
+    {
+        DetectJob job;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_bPending && !m_bExitThread)
+                m_cond.wait(&m_mutex);
+
+            if (m_bExitThread)
+                break;
+
+            job = std::move(m_pending);
+            m_bPending = false;
+        }
+
+        if (bCascade)
+        {
+            for (const auto& rt : face_detect_rects(m_cascade, job.gray))
+                job.faces.emplace_back(rt);
+        }
+
+        QMutexLocker locker(&m_mutex);
+        m_result = std::move(job);
+        m_bResult = true;
+        m_bBusy = false;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutex>
+#include <QRect>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <vector>
+#include <opencv2/objdetect.hpp>
+
+#define PRINT_FACE_DETECT 0
+
+// Face boxes at full frame rate. Haar detection runs on a downscaled gray
+// frame in this thread every few frames, or at once on a scene change.
+// Between detections the boxes are moved by sparse optical flow, which is
+// cheap enough for the caller's thread.
+class FaceTracker : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit FaceTracker(QObject* parent = Q_NULLPTR);
+    ~FaceTracker();
+
+public:
+    // moves the boxes to this frame and hands it to detection when due,
+    // returns the boxes in frame pixels. Called from one thread only.
+    std::vector<QRect> track(const QImage& image);
+    void reset();
+    void stop_thread();
+
+    // frame submitted to boxes applied, of the last detection
+    inline double detect_latency_ms() const { return m_latencyMs; }
+    inline int detect_latency_frames() const { return m_latencyFrames; }
+
+protected:
+    void run() override;
+
+private:
+    typedef struct DetectJob
+    {
+        cv::Mat gray;        // downscaled frame
+        int64_t frame{0};    // index of the frame in track()
+        QElapsedTimer timer; // started when submitted
+        std::vector<cv::Rect2f> faces;
+    } DetectJob;
+
+    bool load_cascade();
+    static cv::Mat sample_gray(const QImage& image);
+    static bool scene_changed(const cv::Mat& prev, const cv::Mat& cur);
+    static std::vector<cv::Rect2f> move_boxes(const cv::Mat& prev, const cv::Mat& cur,
+                                              const std::vector<cv::Rect2f>& boxes);
+    void submit_detect(const cv::Mat& gray);
+
+private:
+    // detection thread
+    mutable QMutex m_mutex;
+    QWaitCondition m_cond;
+    DetectJob m_pending; // latest frame wins
+    bool m_bPending{false};
+    DetectJob m_result;
+    bool m_bResult{false};
+    bool m_bBusy{false}; // a frame is pending or being detected
+    bool m_bExitThread{false};
+    cv::CascadeClassifier m_cascade;
+
+    // tracking, caller thread
+    cv::Mat m_prevGray;
+    std::vector<cv::Rect2f> m_boxes; // in sample pixels
+    int64_t m_frame{0};
+    int64_t m_lastDetect{-1};
+
+    std::atomic<double> m_latencyMs{0};
+    std::atomic_int m_latencyFrames{0};
+};
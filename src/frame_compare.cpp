@@ -0,0 +1,355 @@
+// ***********************************************************/
+// frame_compare.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Picture quality of one encode against another for the a/b
+// compare mode. Luma PSNR and SSIM of each shown frame, and
+// the wipe or side by side picture of both.
+// ***********************************************************/
+
+#include "frame_compare.h"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "simd_level.h"
+
+extern "C"
+{
+#include <libswscale/swscale.h>
+}
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COMPARE_SSE 1
+#include <emmintrin.h>
+#else
+#define COMPARE_SSE 0
+#endif
+
+#define COMPARE_BAND_GROUPS 16 // 4 rows groups of a parallel band
+#define COMPARE_DIVIDER 235    // luma of the wipe divider
+
+// sums of a 4x4 block of a and b
+typedef struct BlockSums
+{
+    int s1;  // a
+    int s2;  // b
+    int ss;  // a * a + b * b
+    int s12; // a * b
+} BlockSums;
+
+static uint64_t row_sse_c(const uint8_t* a, const uint8_t* b, int x, int end)
+{
+    uint64_t sum = 0;
+    for (; x < end; x++)
+    {
+        int d = a[x] - b[x];
+        sum += d * d;
+    }
+    return sum;
+}
+
+static void block_sums_c(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, BlockSums& sums)
+{
+    sums = {0, 0, 0, 0};
+    for (int y = 0; y < 4; y++, a += a_linesize, b += b_linesize)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            sums.s1 += a[x];
+            sums.s2 += b[x];
+            sums.ss += a[x] * a[x] + b[x] * b[x];
+            sums.s12 += a[x] * b[x];
+        }
+    }
+}
+
+#if COMPARE_SSE
+static uint64_t row_sse_sse2(const uint8_t* a, const uint8_t* b, int& x, int end)
+{
+    // a 32 bits lane takes a quarter of the row, 255^2 each, flushed per row
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    for (; x + 16 <= end; x += 16)
+    {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+        __m128i lo = _mm_unpacklo_epi8(d, zero);
+        __m128i hi = _mm_unpackhi_epi8(d, zero);
+        acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+    }
+
+    alignas(16) uint32_t lanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), acc);
+    return uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+// four blocks side by side
+static void block_sums_sse2(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, BlockSums* sums)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i s1[2] = {zero, zero}, s2[2] = {zero, zero}, ss[2] = {zero, zero}, s12[2] = {zero, zero};
+    for (int y = 0; y < 4; y++, a += a_linesize, b += b_linesize)
+    {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+        __m128i ab[2][2] = {{_mm_unpacklo_epi8(va, zero), _mm_unpackhi_epi8(va, zero)},
+                            {_mm_unpacklo_epi8(vb, zero), _mm_unpackhi_epi8(vb, zero)}};
+        for (int i = 0; i < 2; i++)
+        {
+            s1[i] = _mm_add_epi16(s1[i], ab[0][i]);
+            s2[i] = _mm_add_epi16(s2[i], ab[1][i]);
+            ss[i] = _mm_add_epi32(ss[i], _mm_add_epi32(_mm_madd_epi16(ab[0][i], ab[0][i]),
+                                                       _mm_madd_epi16(ab[1][i], ab[1][i])));
+            s12[i] = _mm_add_epi32(s12[i], _mm_madd_epi16(ab[0][i], ab[1][i]));
+        }
+    }
+
+    // 16 bits lanes 0-3 and 4-7, 32 bits lanes 0-1 and 2-3 are the two blocks of each half
+    alignas(16) uint16_t w1[8], w2[8];
+    alignas(16) int32_t d1[4], d2[4];
+    for (int i = 0; i < 2; i++)
+    {
+        _mm_store_si128(reinterpret_cast<__m128i*>(w1), s1[i]);
+        _mm_store_si128(reinterpret_cast<__m128i*>(w2), s2[i]);
+        _mm_store_si128(reinterpret_cast<__m128i*>(d1), ss[i]);
+        _mm_store_si128(reinterpret_cast<__m128i*>(d2), s12[i]);
+        for (int k = 0; k < 2; k++)
+        {
+            auto& out = sums[2 * i + k];
+            out.s1 = w1[4 * k] + w1[4 * k + 1] + w1[4 * k + 2] + w1[4 * k + 3];
+            out.s2 = w2[4 * k] + w2[4 * k + 1] + w2[4 * k + 2] + w2[4 * k + 3];
+            out.ss = d1[2 * k] + d1[2 * k + 1];
+            out.s12 = d2[2 * k] + d2[2 * k + 1];
+        }
+    }
+}
+#endif
+
+static void block_sums_row(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, int blocks,
+                           BlockSums* sums, bool bSimd)
+{
+    int bx = 0;
+#if COMPARE_SSE
+    if (bSimd)
+    {
+        for (; bx + 4 <= blocks; bx += 4)
+            block_sums_sse2(a + 4 * bx, a_linesize, b + 4 * bx, b_linesize, sums + bx);
+    }
+#endif
+    for (; bx < blocks; bx++)
+        block_sums_c(a + 4 * bx, a_linesize, b + 4 * bx, b_linesize, sums[bx]);
+}
+
+// ssim of an 8x8 window from its sums, as x264 computes it
+static double window_ssim(int s1, int s2, int ss, int s12)
+{
+    static const double c1 = .01 * .01 * 255 * 255 * 64;
+    static const double c2 = .03 * .03 * 255 * 255 * 64 * 63;
+
+    double fs1 = s1, fs2 = s2, fss = ss, fs12 = s12;
+    double vars = fss * 64 - fs1 * fs1 - fs2 * fs2;
+    double covar = fs12 * 64 - fs1 * fs2;
+    return (2 * fs1 * fs2 + c1) * (2 * covar + c2) / ((fs1 * fs1 + fs2 * fs2 + c1) * (vars + c2));
+}
+
+CompareMetrics FrameComparator::measure_luma(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize,
+                                             int width, int height)
+{
+    CompareMetrics metrics;
+    if (width <= 0 || height <= 0)
+        return metrics;
+
+    const bool bSimd = simd_level() != SimdLevel::Scalar;
+
+    // 8x8 windows in steps of 4, from the sums of rows of 4x4 blocks
+    const int blocksX = width / 4;
+    const int groups = height / 4;
+    const int windowsX = std::max(blocksX - 1, 0);
+    const int windowsY = std::max(groups - 1, 0);
+
+    // band i measures rows [i * 4 * COMPARE_BAND_GROUPS, ...) and the windows starting there,
+    // the same bands whatever the thread count so the sums are added in the same order
+    const int bandRows = 4 * COMPARE_BAND_GROUPS;
+    const int bands = (height + bandRows - 1) / bandRows;
+    std::vector<uint64_t> sse(bands, 0);
+    std::vector<double> ssim(bands, 0);
+
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range) {
+        std::vector<BlockSums> rows[2] = {std::vector<BlockSums>(blocksX), std::vector<BlockSums>(blocksX)};
+        for (int band = range.start; band < range.end; band++)
+        {
+            const int y0 = band * bandRows;
+            const int y1 = std::min(y0 + bandRows, height);
+            uint64_t sum = 0;
+            for (int y = y0; y < y1; y++)
+            {
+                const uint8_t* pa = a + int64_t(y) * a_linesize;
+                const uint8_t* pb = b + int64_t(y) * b_linesize;
+                int x = 0;
+#if COMPARE_SSE
+                if (bSimd)
+                    sum += row_sse_sse2(pa, pb, x, width);
+#endif
+                sum += row_sse_c(pa, pb, x, width);
+            }
+            sse[band] = sum;
+
+            const int g0 = band * COMPARE_BAND_GROUPS;
+            const int g1 = std::min(g0 + COMPARE_BAND_GROUPS, windowsY);
+            if (g0 >= g1 || windowsX == 0)
+                continue;
+
+            double total = 0;
+            auto sums_of = [&](int g, std::vector<BlockSums>& row) {
+                block_sums_row(a + int64_t(4 * g) * a_linesize, a_linesize, b + int64_t(4 * g) * b_linesize,
+                               b_linesize, blocksX, row.data(), bSimd);
+            };
+            sums_of(g0, rows[0]);
+            for (int g = g0; g < g1; g++)
+            {
+                auto& top = rows[(g - g0) & 1];
+                auto& bottom = rows[(g - g0 + 1) & 1];
+                sums_of(g + 1, bottom);
+                for (int x = 0; x < windowsX; x++)
+                {
+                    const auto& t0 = top[x];
+                    const auto& t1 = top[x + 1];
+                    const auto& b0 = bottom[x];
+                    const auto& b1 = bottom[x + 1];
+                    total += window_ssim(t0.s1 + t1.s1 + b0.s1 + b1.s1, t0.s2 + t1.s2 + b0.s2 + b1.s2,
+                                         t0.ss + t1.ss + b0.ss + b1.ss, t0.s12 + t1.s12 + b0.s12 + b1.s12);
+                }
+            }
+            ssim[band] = total;
+        }
+    });
+
+    uint64_t sumSse = 0;
+    double sumSsim = 0;
+    for (int i = 0; i < bands; i++)
+    {
+        sumSse += sse[i];
+        sumSsim += ssim[i];
+    }
+
+    double mse = double(sumSse) / (double(width) * height);
+    metrics.psnr = mse > 0 ? std::min(10.0 * std::log10(255.0 * 255.0 / mse), COMPARE_PSNR_MAX) : COMPARE_PSNR_MAX;
+    metrics.ssim = (windowsX > 0 && windowsY > 0) ? sumSsim / (double(windowsX) * windowsY) : 1.0;
+    return metrics;
+}
+
+FrameComparator::~FrameComparator()
+{
+    for (int i = 0; i < 2; ++i)
+    {
+        av_frame_free(&m_frames[i]);
+        sws_freeContext(m_sws[i]);
+    }
+}
+
+bool FrameComparator::convert(const AVFrame* src, int width, int height, struct SwsContext*& sws, AVFrame* dst)
+{
+    av_frame_unref(dst);
+
+    // decoded yuv420p at the size is used as it is
+    if (src->format == AV_PIX_FMT_YUV420P && src->width == width && src->height == height)
+        return av_frame_ref(dst, src) == 0;
+
+    sws = sws_getCachedContext(sws, src->width, src->height, AVPixelFormat(src->format), width, height,
+                               AV_PIX_FMT_YUV420P, SWS_BICUBIC, nullptr, nullptr, nullptr);
+    if (!sws)
+        return false;
+
+    dst->format = AV_PIX_FMT_YUV420P;
+    dst->width = width;
+    dst->height = height;
+    if (av_frame_get_buffer(dst, 0) < 0)
+        return false;
+
+    sws_scale(sws, (uint8_t const* const*)src->data, src->linesize, 0, src->height, dst->data, dst->linesize);
+    return true;
+}
+
+bool FrameComparator::set_frames(const AVFrame* a, const AVFrame* b)
+{
+    // even size, chroma of a is not split
+    int width = a->width & ~1;
+    int height = a->height & ~1;
+    if (width <= 0 || height <= 0)
+        return false;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (!m_frames[i] && !(m_frames[i] = av_frame_alloc()))
+            return false;
+        if (!convert(i ? b : a, width, height, m_sws[i], m_frames[i]))
+            return false;
+    }
+    return true;
+}
+
+CompareMetrics FrameComparator::measure() const
+{
+    const AVFrame* a = m_frames[0];
+    const AVFrame* b = m_frames[1];
+    if (!a || !b || !a->data[0] || !b->data[0])
+        return CompareMetrics();
+
+    return measure_luma(a->data[0], a->linesize[0], b->data[0], b->linesize[0], a->width & ~1, a->height & ~1);
+}
+
+bool FrameComparator::compose(CompareView view, double wipe, AVFrame* dst) const
+{
+    const AVFrame* a = m_frames[0];
+    const AVFrame* b = m_frames[1];
+    if (!a || !b || !a->data[0] || !b->data[0])
+        return false;
+
+    const int width = a->width & ~1;
+    const int height = a->height & ~1;
+
+    av_frame_unref(dst);
+    dst->format = AV_PIX_FMT_YUV420P;
+    dst->width = view == CompareView::Split ? 2 * width : width;
+    dst->height = height;
+    if (av_frame_get_buffer(dst, 0) < 0)
+        return false;
+    av_frame_copy_props(dst, a);
+
+    // even divider, chroma columns are whole
+    int divider = std::clamp(int(std::lround(wipe * width)) & ~1, 0, width);
+    for (int i = 0; i < 3; ++i)
+    {
+        int w = i ? width / 2 : width;
+        int h = i ? height / 2 : height;
+        int x = i ? divider / 2 : divider;
+        for (int y = 0; y < h; ++y)
+        {
+            const uint8_t* pa = a->data[i] + int64_t(y) * a->linesize[i];
+            const uint8_t* pb = b->data[i] + int64_t(y) * b->linesize[i];
+            uint8_t* out = dst->data[i] + int64_t(y) * dst->linesize[i];
+            if (view == CompareView::Split)
+            {
+                memcpy(out, pa, w);
+                memcpy(out + w, pb, w);
+            }
+            else
+            {
+                memcpy(out, pa, x);
+                memcpy(out + x, pb + x, w - x);
+            }
+        }
+    }
+
+    // a line where a ends
+    if (view == CompareView::Wipe && divider > 0 && divider < width)
+    {
+        for (int y = 0; y < height; ++y)
+            memset(dst->data[0] + int64_t(y) * dst->linesize[0] + divider - 1, COMPARE_DIVIDER, 2);
+    }
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+#define PRINT_COMPARE_TIME 0
+
+#define COMPARE_PSNR_MAX 100.0 // identical pictures
+
+// layout of the a/b compare picture
+enum class CompareView
+{
+    Wipe,  // one picture, a left of the divider and b right of it
+    Split  // a and b side by side
+};
+
+typedef struct CompareMetrics
+{
+    double psnr{0}; // luma, dB
+    double ssim{0}; // luma, 0 to 1
+} CompareMetrics;
+
+typedef struct CompareSample
+{
+    double time{0}; // seconds from the start of a
+    CompareMetrics metrics;
+} CompareSample;
+
+// Compares the pictures of two encodes of the same video. Both are converted to
+// yuv420p at the size of a, b's luma is measured against a's and the two are
+// composed into one picture to show. PSNR is taken from the squared errors,
+// SSIM on 8x8 windows in steps of 4 pixels from the sums of 4x4 blocks. Row
+// bands run in parallel, pixels 16 at a time with SSE2.
+class FrameComparator
+{
+public:
+    FrameComparator() = default;
+    ~FrameComparator();
+
+public:
+    // false if a or b can't be converted
+    bool set_frames(const AVFrame* a, const AVFrame* b);
+    CompareMetrics measure() const;
+    // the frames set to dst, yuv420p. wipe is the divider position, 0 to 1.
+    bool compose(CompareView view, double wipe, AVFrame* dst) const;
+
+    static CompareMetrics measure_luma(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, int width,
+                                       int height);
+
+private:
+    bool convert(const AVFrame* src, int width, int height, struct SwsContext*& sws, AVFrame* dst);
+
+private:
+    AVFrame* m_frames[2]{nullptr, nullptr}; // a and b, yuv420p at the size of a
+    struct SwsContext* m_sws[2]{nullptr, nullptr};
+};
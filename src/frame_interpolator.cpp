@@ -0,0 +1,406 @@
+// ***********************************************************/
+// frame_interpolator.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Motion compensated frame interpolation. Motion is searched
+// on downscaled luma with SSE2 SAD of 8x8 blocks, pictures in
+// between take each block from both frames along its vector.
+// Blocks without a match and the blend mode are cross faded.
+// ***********************************************************/
+
+#include "frame_interpolator.h"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include "simd_level.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define INTERP_SSE 1
+#include <emmintrin.h>
+#else
+#define INTERP_SSE 0
+#endif
+
+#define INTERP_MAX_WIDTH 960 // of the downscaled luma
+#define INTERP_LAMBDA 4      // SAD cost of a vector length unit, still areas stay still
+#define INTERP_BAD_SAD 16    // mean difference per pixel of a block cross faded instead
+#define INTERP_CUT_BLOCKS 50 // percent of blocks without a match of a scene change
+
+static int sad_8x8_c(const uint8_t* a, const uint8_t* b, int stride)
+{
+    int sum = 0;
+    for (int y = 0; y < INTERP_BLOCK; y++, a += stride, b += stride)
+    {
+        for (int x = 0; x < INTERP_BLOCK; x++)
+            sum += std::abs(a[x] - b[x]);
+    }
+    return sum;
+}
+
+// 2x2 average with the rounding of pavgb, rows first
+static void half_row_c(const uint8_t* r0, const uint8_t* r1, uint8_t* dst, int width)
+{
+    for (int x = 0; x < width; x++)
+    {
+        int a = (r0[2 * x] + r1[2 * x] + 1) >> 1;
+        int b = (r0[2 * x + 1] + r1[2 * x + 1] + 1) >> 1;
+        dst[x] = uint8_t((a + b + 1) >> 1);
+    }
+}
+
+static void blend_row_c(const uint8_t* a, const uint8_t* b, uint8_t* dst, int n, int weight)
+{
+    const int wa = 256 - weight;
+    for (int i = 0; i < n; i++)
+        dst[i] = uint8_t((a[i] * wa + b[i] * weight + 128) >> 8);
+}
+
+#if INTERP_SSE
+static int sad_8x8_sse2(const uint8_t* a, const uint8_t* b, int stride)
+{
+    // two rows of 8 in one register, 4 psadbw per block
+    __m128i sum = _mm_setzero_si128();
+    for (int y = 0; y < INTERP_BLOCK; y += 2, a += 2 * stride, b += 2 * stride)
+    {
+        __m128i va = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a)),
+                                        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a + stride)));
+        __m128i vb = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b)),
+                                        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + stride)));
+        sum = _mm_add_epi32(sum, _mm_sad_epu8(va, vb));
+    }
+    return _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+}
+
+static void half_row_sse2(const uint8_t* r0, const uint8_t* r1, uint8_t* dst, int width)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        const uint8_t* s0 = r0 + 2 * x;
+        const uint8_t* s1 = r1 + 2 * x;
+        __m128i v0 = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s0)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1)));
+        __m128i v1 = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s0 + 16)),
+                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(s1 + 16)));
+        __m128i h0 = _mm_avg_epu16(_mm_and_si128(v0, lowBytes), _mm_srli_epi16(v0, 8));
+        __m128i h1 = _mm_avg_epu16(_mm_and_si128(v1, lowBytes), _mm_srli_epi16(v1, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(h0, h1));
+    }
+    half_row_c(r0 + 2 * x, r1 + 2 * x, dst + x, width - x);
+}
+
+static void blend_row_sse2(const uint8_t* a, const uint8_t* b, uint8_t* dst, int n, int weight)
+{
+    // at most 255 * 256 + 128, the sums fit unsigned 16 bits
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wa = _mm_set1_epi16(short(256 - weight));
+    const __m128i wb = _mm_set1_epi16(short(weight));
+    const __m128i round = _mm_set1_epi16(128);
+    int i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                   _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 8);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    blend_row_c(a + i, b + i, dst + i, n - i, weight);
+}
+#endif
+
+static void half_plane(const uint8_t* src, int src_linesize, uint8_t* dst, int width, int height, bool bSimd)
+{
+    // width and height of dst
+    cv::parallel_for_(cv::Range(0, height), [&](const cv::Range& range) {
+        for (int y = range.start; y < range.end; y++)
+        {
+            const uint8_t* r0 = src + size_t(2 * y) * src_linesize;
+#if INTERP_SSE
+            if (bSimd)
+            {
+                half_row_sse2(r0, r0 + src_linesize, dst + size_t(y) * width, width);
+                continue;
+            }
+#endif
+            half_row_c(r0, r0 + src_linesize, dst + size_t(y) * width, width);
+        }
+    });
+}
+
+void FrameInterpolator::reset()
+{
+    m_bLastValid = false;
+}
+
+void FrameInterpolator::downscale(const InterpPicture& pic, std::vector<uint8_t>& small, bool bSimd)
+{
+    const auto& luma = pic.planes[0];
+    if (m_scale == 2)
+    {
+        half_plane(luma.data, luma.linesize, small.data(), m_smallWidth, m_smallHeight, bSimd);
+        return;
+    }
+
+    int halfWidth = m_smallWidth * 2;
+    half_plane(luma.data, luma.linesize, m_half.data(), halfWidth, m_smallHeight * 2, bSimd);
+    half_plane(m_half.data(), halfWidth, small.data(), m_smallWidth, m_smallHeight, bSimd);
+}
+
+int FrameInterpolator::block_sad(int bx, int by, int dx, int dy, bool bSimd) const
+{
+    const int stride = m_smallWidth;
+    const uint8_t* a = m_small[m_next].data() + size_t(by * INTERP_BLOCK) * stride + bx * INTERP_BLOCK;
+    const uint8_t* b = m_small[m_next ^ 1].data() + size_t(by * INTERP_BLOCK + dy) * stride + bx * INTERP_BLOCK + dx;
+#if INTERP_SSE
+    if (bSimd)
+        return sad_8x8_sse2(a, b, stride);
+#endif
+    return sad_8x8_c(a, b, stride);
+}
+
+void FrameInterpolator::search_row(int by, int range, bool bSimd)
+{
+    const int stride = m_smallWidth;
+    const int y0 = by * INTERP_BLOCK;
+    const int dyMin = std::max(-range, -y0), dyMax = std::min(range, m_smallHeight - INTERP_BLOCK - y0);
+#if INTERP_SSE
+    auto sad = bSimd ? sad_8x8_sse2 : sad_8x8_c;
+#else
+    auto sad = sad_8x8_c;
+#endif
+
+    for (int bx = 0; bx < m_blocksX; bx++)
+    {
+        const int x0 = bx * INTERP_BLOCK;
+        const int dxMin = std::max(-range, -x0), dxMax = std::min(range, m_smallWidth - INTERP_BLOCK - x0);
+        const uint8_t* block = m_small[m_next].data() + size_t(y0) * stride + x0;
+        const uint8_t* ref = m_small[m_next ^ 1].data() + size_t(y0) * stride + x0;
+
+        BlockMotion best;
+        best.sad = sad(block, ref, stride);
+        int bestCost = best.sad;
+
+        // full search, the length penalty skips vectors that can't win
+        for (int dy = dyMin; dy <= dyMax; dy++)
+        {
+            const uint8_t* refRow = ref + dy * stride;
+            for (int dx = dxMin; dx <= dxMax; dx++)
+            {
+                int cost = INTERP_LAMBDA * (std::abs(dx) + std::abs(dy));
+                if (cost >= bestCost)
+                    continue;
+
+                int diff = sad(block, refRow + dx, stride);
+                cost += diff;
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    best.dx = dx;
+                    best.dy = dy;
+                    best.sad = diff;
+                }
+            }
+        }
+        m_field[by * m_blocksX + bx] = best;
+    }
+}
+
+void FrameInterpolator::smooth_row(int by, std::vector<BlockMotion>& field, bool bSimd) const
+{
+    // vector median of the 3x3 neighbours, the candidate closest to all of them
+    const int y0 = by * INTERP_BLOCK;
+    for (int bx = 0; bx < m_blocksX; bx++)
+    {
+        const int x0 = bx * INTERP_BLOCK;
+        const BlockMotion* neighbours[9];
+        int count = 0;
+        neighbours[count++] = &m_field[by * m_blocksX + bx]; // wins the ties
+        for (int ny = std::max(by - 1, 0); ny <= std::min(by + 1, m_blocksY - 1); ny++)
+        {
+            for (int nx = std::max(bx - 1, 0); nx <= std::min(bx + 1, m_blocksX - 1); nx++)
+            {
+                if (nx != bx || ny != by)
+                    neighbours[count++] = &m_field[ny * m_blocksX + nx];
+            }
+        }
+
+        const BlockMotion* best = neighbours[0];
+        int bestDistance = INT_MAX;
+        for (int i = 0; i < count; i++)
+        {
+            const auto* c = neighbours[i];
+            if (x0 + c->dx < 0 || x0 + c->dx + INTERP_BLOCK > m_smallWidth || y0 + c->dy < 0 ||
+                y0 + c->dy + INTERP_BLOCK > m_smallHeight)
+                continue;
+
+            int distance = 0;
+            for (int j = 0; j < count; j++)
+                distance += std::abs(c->dx - neighbours[j]->dx) + std::abs(c->dy - neighbours[j]->dy);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = c;
+            }
+        }
+
+        auto& motion = field[by * m_blocksX + bx];
+        motion = m_field[by * m_blocksX + bx];
+        if (best != neighbours[0])
+        {
+            motion.dx = best->dx;
+            motion.dy = best->dy;
+            motion.sad = block_sad(bx, by, best->dx, best->dy, bSimd);
+        }
+    }
+}
+
+bool FrameInterpolator::estimate(const InterpPicture& prev, const InterpPicture& next, bool bMotion, bool bPrevIsLast)
+{
+    if (prev.width != next.width || prev.height != next.height || prev.nb_planes != next.nb_planes)
+    {
+        m_bLastValid = false;
+        return false;
+    }
+
+    // large pictures 4 times down, so the search range still covers fast motion
+    int scale = next.width > INTERP_MAX_WIDTH * 2 ? 4 : 2;
+    if (next.width / scale < INTERP_BLOCK * 2 || next.height / scale < INTERP_BLOCK * 2)
+    {
+        m_bLastValid = false;
+        return false;
+    }
+
+    if (next.width != m_width || next.height != m_height)
+    {
+        m_width = next.width;
+        m_height = next.height;
+        m_scale = scale;
+        m_smallWidth = m_width / scale;
+        m_smallHeight = m_height / scale;
+        for (auto& small : m_small)
+            small.resize(size_t(m_smallWidth) * m_smallHeight);
+        if (scale == 4)
+            m_half.resize(size_t(m_smallWidth) * m_smallHeight * 4);
+        m_blocksX = m_smallWidth / INTERP_BLOCK;
+        m_blocksY = m_smallHeight / INTERP_BLOCK;
+        m_field.assign(size_t(m_blocksX) * m_blocksY, BlockMotion());
+        m_bLastValid = false;
+    }
+
+    bool bSimd = simd_level() != SimdLevel::Scalar;
+    if (!bPrevIsLast || !m_bLastValid)
+        downscale(prev, m_small[m_next], bSimd);
+    m_next ^= 1;
+    downscale(next, m_small[m_next], bSimd);
+    m_bLastValid = true;
+
+    // the blend mode only needs the differences, for the stats
+    const int range = bMotion ? INTERP_RANGE : 0;
+    cv::parallel_for_(cv::Range(0, m_blocksY), [&](const cv::Range& rows) {
+        for (int by = rows.start; by < rows.end; by++)
+            search_row(by, range, bSimd);
+    });
+
+    if (bMotion)
+    {
+        std::vector<BlockMotion> smoothed(m_field.size());
+        cv::parallel_for_(cv::Range(0, m_blocksY), [&](const cv::Range& rows) {
+            for (int by = rows.start; by < rows.end; by++)
+                smooth_row(by, smoothed, bSimd);
+        });
+        m_field.swap(smoothed);
+    }
+
+    m_blendedBlocks = 0;
+    for (auto& motion : m_field)
+    {
+        motion.bBlend = !bMotion || motion.sad > INTERP_BAD_SAD * INTERP_BLOCK * INTERP_BLOCK;
+        if (motion.sad > INTERP_BAD_SAD * INTERP_BLOCK * INTERP_BLOCK)
+            m_blendedBlocks++;
+    }
+
+    // blending a cut looks like a double exposure, the pair is shown as it is
+    return !bMotion || m_blendedBlocks * 100 < INTERP_CUT_BLOCKS * blocks();
+}
+
+void FrameInterpolator::compensate_block(const InterpPicture& prev, const InterpPicture& next, InterpPicture& dst,
+                                         int x, int y, int w, int h, int dx, int dy, double t, int weight,
+                                         bool bSimd) const
+{
+    for (int p = 0; p < dst.nb_planes; p++)
+    {
+        const auto& plane = dst.planes[p];
+        const int sw = plane.shift_w, sh = plane.shift_h;
+        const int planeWidth = -((-dst.width) >> sw);
+        const int planeHeight = -((-dst.height) >> sh);
+
+        const int x0 = x >> sw, y0 = y >> sh;
+        const int bw = std::min(-((-(x + w)) >> sw), planeWidth) - x0;
+        const int bh = std::min(-((-(y + h)) >> sh), planeHeight) - y0;
+
+        // prev along t of the vector, next the rest of the way
+        const double vx = double(dx) / (1 << sw), vy = double(dy) / (1 << sh);
+        const int prevX = std::clamp(x0 + int(std::lround(t * vx)), 0, planeWidth - bw);
+        const int prevY = std::clamp(y0 + int(std::lround(t * vy)), 0, planeHeight - bh);
+        const int nextX = std::clamp(x0 + int(std::lround(t * vx)) - int(std::lround(vx)), 0, planeWidth - bw);
+        const int nextY = std::clamp(y0 + int(std::lround(t * vy)) - int(std::lround(vy)), 0, planeHeight - bh);
+
+        const auto& a = prev.planes[p];
+        const auto& b = next.planes[p];
+        for (int row = 0; row < bh; row++)
+        {
+            const uint8_t* sa = a.data + size_t(prevY + row) * a.linesize + prevX * plane.step;
+            const uint8_t* sb = b.data + size_t(nextY + row) * b.linesize + nextX * plane.step;
+            uint8_t* d = plane.data + size_t(y0 + row) * plane.linesize + x0 * plane.step;
+#if INTERP_SSE
+            if (bSimd)
+            {
+                blend_row_sse2(sa, sb, d, bw * plane.step, weight);
+                continue;
+            }
+#endif
+            blend_row_c(sa, sb, d, bw * plane.step, weight);
+        }
+    }
+}
+
+void FrameInterpolator::interpolate(const InterpPicture& prev, const InterpPicture& next, double t,
+                                    InterpPicture& dst) const
+{
+    const int weight = std::clamp(int(std::lround(t * 256)), 1, 255);
+    const int block = INTERP_BLOCK * m_scale;
+    const bool bSimd = simd_level() != SimdLevel::Scalar;
+
+    cv::parallel_for_(cv::Range(0, m_blocksY), [&](const cv::Range& rows) {
+        for (int by = rows.start; by < rows.end; by++)
+        {
+            // the last row and column take the rest of the picture
+            const int y = by * block;
+            const int h = by == m_blocksY - 1 ? dst.height - y : block;
+            for (int bx = 0; bx < m_blocksX; bx++)
+            {
+                const int x = bx * block;
+                const int w = bx == m_blocksX - 1 ? dst.width - x : block;
+                const auto& motion = m_field[by * m_blocksX + bx];
+
+                // vectors point from next into prev, in full resolution pixels
+                int dx = 0, dy = 0;
+                if (!motion.bBlend)
+                {
+                    dx = motion.dx * m_scale;
+                    dy = motion.dy * m_scale;
+                }
+                compensate_block(prev, next, dst, x, y, w, h, dx, dy, t, weight, bSimd);
+            }
+        }
+    });
+}
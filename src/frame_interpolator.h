@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define PRINT_INTERPOLATION_TIME 0
+
+#define INTERP_BLOCK 8 // block size on the downscaled luma
+#define INTERP_RANGE 7 // search range on the downscaled luma, in pixels
+
+// one plane of an 8 bits yuv picture
+typedef struct InterpPlane
+{
+    uint8_t* data{nullptr};
+    int linesize{0};
+    int step{1}; // bytes per pixel, 2 for interleaved chroma
+    int shift_w{0};
+    int shift_h{0};
+} InterpPlane;
+
+typedef struct InterpPicture
+{
+    InterpPlane planes[4];
+    int nb_planes{0};
+    int width{0};
+    int height{0};
+} InterpPicture;
+
+// Synthesizes pictures between two consecutive frames. Block motion is searched
+// on luma downscaled to at most 960 pixels wide, SAD of 8x8 blocks over the full
+// search range, then the vector field is median filtered. A picture at t takes
+// each block from both frames along its vector, blocks without a good match and
+// the blend mode fall back to a cross fade. Block rows run in parallel.
+class FrameInterpolator
+{
+public:
+    FrameInterpolator() = default;
+
+public:
+    // motion from prev to next, or only the change of the pair if !bMotion. The luma of
+    // prev is reused if bPrevIsLast, when it was next of the last call. False for
+    // pictures too small or of different size, and for scene changes.
+    bool estimate(const InterpPicture& prev, const InterpPicture& next, bool bMotion, bool bPrevIsLast);
+    // picture at t in ]0, 1[ of the estimated pair to dst, dst has the layout of next
+    void interpolate(const InterpPicture& prev, const InterpPicture& next, double t, InterpPicture& dst) const;
+    void reset();
+
+    inline int blocks() const { return int(m_field.size()); }
+    inline int blended_blocks() const { return m_blendedBlocks; }
+
+private:
+    typedef struct BlockMotion
+    {
+        int dx{0}; // position of the block of next in prev, downscaled pixels
+        int dy{0};
+        int sad{0};
+        bool bBlend{false}; // no good match, cross faded
+    } BlockMotion;
+
+    void downscale(const InterpPicture& pic, std::vector<uint8_t>& small, bool bSimd);
+    void search_row(int by, int range, bool bSimd);
+    void smooth_row(int by, std::vector<BlockMotion>& field, bool bSimd) const;
+    int block_sad(int bx, int by, int dx, int dy, bool bSimd) const;
+    void compensate_block(const InterpPicture& prev, const InterpPicture& next, InterpPicture& dst, int x, int y,
+                          int w, int h, int dx, int dy, double t, int weight, bool bSimd) const;
+
+private:
+    int m_width{0}; // of the pictures
+    int m_height{0};
+    int m_scale{2}; // downscale factor, 2 or 4
+    int m_smallWidth{0};
+    int m_smallHeight{0};
+    std::vector<uint8_t> m_small[2]; // downscaled luma of prev and next
+    std::vector<uint8_t> m_half;     // first half of a 4 times downscale
+    int m_next{0};                   // index of next in m_small
+    bool m_bLastValid{false};        // m_small[m_next] holds the last next picture
+
+    int m_blocksX{0};
+    int m_blocksY{0};
+    std::vector<BlockMotion> m_field;
+    int m_blendedBlocks{0};
+};
@@ -0,0 +1,348 @@
+// ***********************************************************/
+// hdr_tonemap.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// HDR (PQ/HLG, bt2020) to SDR (bt709) tone mapping on the cpu.
+// The pixel path is table driven: fixed point yuv to R'G'B',
+// EOTF and tone curve lookups, then the gamut matrix and the
+// clip in float, 4 pixels per SSE2 vector. The scalar kernel
+// does the same float operations in the same order, so both
+// give the same bytes (checked in VideoPlayerBench).
+// ***********************************************************/
+
+#include "hdr_tonemap.h"
+#include <algorithm>
+#include <cmath>
+#include <opencv2/core.hpp>
+#include "simd_level.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HDR_SSE 1
+#include <emmintrin.h>
+#else
+#define HDR_SSE 0
+#endif
+
+#define CODE_BITS 12 // R'G'B' and output curve tables
+#define CODE_MAX ((1 << CODE_BITS) - 1)
+#define SDR_WHITE_NITS 203.0 // bt2408 reference white, shown as sdr white
+#define HLG_PEAK_NITS 1000.0
+#define HLG_SYSTEM_GAMMA 1.2
+
+// 8x8 ordered dither, 4x + 2 is the offset in 1/256 of an output step
+static const uint8_t BAYER8[8][8] = {
+    {0, 32, 8, 40, 2, 34, 10, 42},  {48, 16, 56, 24, 50, 18, 58, 26}, {12, 44, 4, 36, 14, 46, 6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22}, {3, 35, 11, 43, 1, 33, 9, 41},  {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47, 7, 39, 13, 45, 5, 37},  {63, 31, 55, 23, 61, 29, 53, 21}};
+
+static double pq_eotf(double e) // signal to nits
+{
+    const double m1 = 0.1593017578125, m2 = 78.84375;
+    const double c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+    double p = std::pow(std::clamp(e, 0.0, 1.0), 1.0 / m2);
+    return 10000.0 * std::pow(std::max(p - c1, 0.0) / (c2 - c3 * p), 1.0 / m1);
+}
+
+static double pq_inverse_eotf(double nits) // nits to signal
+{
+    const double m1 = 0.1593017578125, m2 = 78.84375;
+    const double c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+    double y = std::pow(std::clamp(nits / 10000.0, 0.0, 1.0), m1);
+    return std::pow((c1 + c2 * y) / (1 + c3 * y), m2);
+}
+
+static double hlg_eotf(double e) // signal to nits, the ootf is applied per channel
+{
+    const double a = 0.17883277, b = 0.28466892, c = 0.55991073;
+    e = std::clamp(e, 0.0, 1.0);
+    double scene = e <= 0.5 ? e * e / 3.0 : (std::exp((e - c) / a) + b) / 12.0;
+    return HLG_PEAK_NITS * std::pow(scene, HLG_SYSTEM_GAMMA);
+}
+
+static double hable(double x)
+{
+    const double A = 0.15, B = 0.50, C = 0.10, D = 0.20, E = 0.02, F = 0.30;
+    return (x * (A * x + C * B) + D * E) / (x * (A * x + B) + D * F) - E / F;
+}
+
+const char* HdrToneMapper::curve_name(ToneMapCurve curve)
+{
+    switch (curve)
+    {
+        case ToneMapCurve::Hable:
+            return "hable";
+        case ToneMapCurve::BT2390:
+            return "bt2390";
+        default:
+            return "off";
+    }
+}
+
+void HdrToneMapper::configure(const HdrFrameInfo& info, ToneMapCurve curve)
+{
+    if (curve == m_curve && info.transfer == m_info.transfer && info.bBt2020 == m_info.bBt2020 &&
+        info.bFullRange == m_info.bFullRange && info.depth == m_info.depth && info.peakNits == m_info.peakNits)
+        return;
+
+    m_info = info;
+    m_curve = curve;
+    if (m_curve != ToneMapCurve::Off)
+        build_tables();
+}
+
+double HdrToneMapper::tone_curve(double nits) const
+{
+    double peak = m_info.transfer == HdrTransfer::HLG ? HLG_PEAK_NITS : m_info.peakNits;
+    if (peak <= SDR_WHITE_NITS)
+        return std::min(nits, SDR_WHITE_NITS);
+
+    double out = nits;
+    if (m_curve == ToneMapCurve::Hable)
+    {
+        // exposure bias of 2 as in the original curve, the content peak is the white point
+        out = SDR_WHITE_NITS * hable(2 * nits / SDR_WHITE_NITS) / hable(2 * peak / SDR_WHITE_NITS);
+    }
+    else
+    {
+        // bt2390 eetf: hermite spline knee in the pq domain, linear below it
+        double srcPeak = pq_inverse_eotf(peak);
+        double e1 = pq_inverse_eotf(nits) / srcPeak;
+        double maxLum = pq_inverse_eotf(SDR_WHITE_NITS) / srcPeak;
+        double ks = std::max(0.0, 1.5 * maxLum - 0.5);
+        double e2 = e1;
+        if (e1 >= ks)
+        {
+            double t = (e1 - ks) / (1 - ks);
+            double t2 = t * t, t3 = t2 * t;
+            e2 = (2 * t3 - 3 * t2 + 1) * ks + (t3 - 2 * t2 + t) * (1 - ks) + (-2 * t3 + 3 * t2) * maxLum;
+        }
+        out = pq_eotf(std::min(e2, maxLum) * srcPeak);
+    }
+    return std::clamp(out, 0.0, SDR_WHITE_NITS);
+}
+
+void HdrToneMapper::build_tables()
+{
+    // samples deeper than the tables are shifted down
+    int bits = std::min(m_info.depth, CODE_BITS);
+    m_sampleShift = m_info.depth - bits;
+    int n = 1 << bits;
+
+    double yoff = 16 << (bits - 8), yrange = 219 << (bits - 8);
+    double coff = 128 << (bits - 8), crange = 224 << (bits - 8);
+    if (m_info.bFullRange)
+    {
+        yoff = 0;
+        yrange = crange = n - 1;
+    }
+
+    double kr = m_info.bBt2020 ? 0.2627 : 0.2126;
+    double kb = m_info.bBt2020 ? 0.0593 : 0.0722;
+    double kg = 1 - kr - kb;
+    const double s = CODE_MAX * 65536.0;
+
+    m_yTab.resize(n);
+    m_vrTab.resize(n);
+    m_ugTab.resize(n);
+    m_vgTab.resize(n);
+    m_ubTab.resize(n);
+    for (int c = 0; c < n; c++)
+    {
+        double y = (c - yoff) / yrange;
+        double cb = (c - coff) / crange;
+        m_yTab[c] = int(std::lround(y * s + 32768)); // rounding of the sum
+        m_vrTab[c] = int(std::lround(2 * (1 - kr) * cb * s));
+        m_ugTab[c] = int(std::lround(-2 * (1 - kb) * kb / kg * cb * s));
+        m_vgTab[c] = int(std::lround(-2 * (1 - kr) * kr / kg * cb * s));
+        m_ubTab[c] = int(std::lround(2 * (1 - kb) * cb * s));
+    }
+
+    // linear light relative to sdr white, and the gain of the tone curve at
+    // max(R', G', B'), which scales the 3 channels alike
+    m_eotf.resize(CODE_MAX + 1);
+    m_gain.resize(CODE_MAX + 1);
+    for (int i = 0; i <= CODE_MAX; i++)
+    {
+        double e = double(i) / CODE_MAX;
+        double nits = m_info.transfer == HdrTransfer::HLG ? hlg_eotf(e) : pq_eotf(e);
+        m_eotf[i] = float(nits / SDR_WHITE_NITS);
+
+        double l = std::max(nits, 1e-4);
+        m_gain[i] = float(tone_curve(l) / l);
+    }
+
+    // bt1886 (gamma 2.4) of linear 0..1, indexed by the square root so dark tones get more entries
+    m_oetf.resize(CODE_MAX + 1);
+    for (int i = 0; i <= CODE_MAX; i++)
+    {
+        double lin = double(i) * i / (double(CODE_MAX) * CODE_MAX);
+        m_oetf[i] = uint16_t(std::lround(255.0 * 256.0 * std::pow(lin, 1 / 2.4)));
+    }
+
+    static const float bt2020_to_bt709[9] = {1.6605f,  -0.5876f, -0.0728f, -0.1246f, 1.1329f,
+                                             -0.0083f, -0.0182f, -0.1006f, 1.1187f};
+    static const float identity[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    std::copy_n(m_info.bBt2020 ? bt2020_to_bt709 : identity, 9, m_gamut);
+}
+
+void HdrToneMapper::convert_row(const HdrPlanes& planes, const int* srcX, int y, int row, int width, uint8_t* dst,
+                                ptrdiff_t dst_step, bool bSimd) const
+{
+    const auto& cy = planes.comp[0];
+    const auto& cu = planes.comp[1];
+    const auto& cv = planes.comp[2];
+    const int yc = y >> planes.log2_chroma_h;
+    auto py = reinterpret_cast<const uint16_t*>(cy.data + int64_t(y) * cy.linesize);
+    auto pu = reinterpret_cast<const uint16_t*>(cu.data + int64_t(yc) * cu.linesize);
+    auto pv = reinterpret_cast<const uint16_t*>(cv.data + int64_t(yc) * cv.linesize);
+    const int sy = cy.shift + m_sampleShift, su = cu.shift + m_sampleShift, sv = cv.shift + m_sampleShift;
+    const int ystep = cy.step, ustep = cu.step, vstep = cv.step, log2w = planes.log2_chroma_w;
+    const int mask = (1 << std::min(m_info.depth, CODE_BITS)) - 1;
+
+    // raw table pointers, the byte stores could alias the vectors' members
+    const int *yTab = m_yTab.data(), *vrTab = m_vrTab.data(), *ugTab = m_ugTab.data();
+    const int *vgTab = m_vgTab.data(), *ubTab = m_ubTab.data();
+    const float *eotf = m_eotf.data(), *gainTab = m_gain.data();
+    const uint16_t* oetf = m_oetf.data();
+    const uint8_t* bayer = BAYER8[row & 7]; // output position, the pattern doesn't scale
+    float m[9];
+    std::copy_n(m_gamut, 9, m);
+
+    // chunks of the row go through 3 simple loops: tables, float math, output curve
+    const int CHUNK = 256;
+    alignas(16) float lin[3][CHUNK];
+    alignas(16) int idx[3][CHUNK];
+
+    for (int x = 0; x < width; x += CHUNK)
+    {
+        const int n = std::min(CHUNK, width - x);
+
+        // R'G'B' codes with the nearest chroma sample, linear light with the tone curve gain
+        for (int k = 0; k < n; k++)
+        {
+            int px = srcX[x + k], xc = px >> log2w;
+            int Y = yTab[(py[px * ystep] >> sy) & mask];
+            int U = (pu[xc * ustep] >> su) & mask;
+            int V = (pv[xc * vstep] >> sv) & mask;
+            int r = std::clamp((Y + vrTab[V]) >> 16, 0, CODE_MAX);
+            int g = std::clamp((Y + ugTab[U] + vgTab[V]) >> 16, 0, CODE_MAX);
+            int b = std::clamp((Y + ubTab[U]) >> 16, 0, CODE_MAX);
+            float gain = gainTab[std::max(r, std::max(g, b))];
+            lin[0][k] = eotf[r] * gain;
+            lin[1][k] = eotf[g] * gain;
+            lin[2][k] = eotf[b] * gain;
+        }
+
+        // bt2020 to bt709 primaries, out of gamut colours are desaturated towards
+        // their luma until no channel is negative, then sqrt for the output table
+        int k = 0;
+#if HDR_SSE
+        if (bSimd)
+        {
+            const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+            const __m128 scale = _mm_set1_ps(float(CODE_MAX));
+            const __m128 kr = _mm_set1_ps(0.2126f), kg = _mm_set1_ps(0.7152f), kb = _mm_set1_ps(0.0722f);
+            for (; k + 4 <= n; k += 4)
+            {
+                __m128 r = _mm_load_ps(lin[0] + k);
+                __m128 g = _mm_load_ps(lin[1] + k);
+                __m128 b = _mm_load_ps(lin[2] + k);
+
+                __m128 c[3];
+                for (int i = 0; i < 3; i++)
+                {
+                    c[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[i * 3]), r),
+                                                 _mm_mul_ps(_mm_set1_ps(m[i * 3 + 1]), g)),
+                                      _mm_mul_ps(_mm_set1_ps(m[i * 3 + 2]), b));
+                }
+
+                __m128 luma = _mm_add_ps(_mm_add_ps(_mm_mul_ps(kr, c[0]), _mm_mul_ps(kg, c[1])), _mm_mul_ps(kb, c[2]));
+                __m128 mn = _mm_min_ps(_mm_min_ps(c[0], c[1]), c[2]);
+                __m128 clip = _mm_and_ps(_mm_cmplt_ps(mn, zero), _mm_cmpgt_ps(luma, zero));
+                __m128 t = _mm_div_ps(luma, _mm_sub_ps(luma, mn));
+                t = _mm_or_ps(_mm_and_ps(clip, t), _mm_andnot_ps(clip, one));
+
+                for (int i = 0; i < 3; i++)
+                {
+                    __m128 v = _mm_add_ps(luma, _mm_mul_ps(t, _mm_sub_ps(c[i], luma)));
+                    v = _mm_min_ps(_mm_max_ps(v, zero), one);
+                    v = _mm_add_ps(_mm_mul_ps(_mm_sqrt_ps(v), scale), half);
+                    _mm_store_si128((__m128i*)(idx[i] + k), _mm_cvttps_epi32(v));
+                }
+            }
+        }
+#endif
+        for (; k < n; k++)
+        {
+            float c[3];
+            for (int i = 0; i < 3; i++)
+                c[i] = m[i * 3] * lin[0][k] + m[i * 3 + 1] * lin[1][k] + m[i * 3 + 2] * lin[2][k];
+
+            float luma = 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+            float mn = std::min(std::min(c[0], c[1]), c[2]);
+            float t = (mn < 0 && luma > 0) ? luma / (luma - mn) : 1.0f;
+
+            for (int i = 0; i < 3; i++)
+            {
+                float v = std::min(std::max(luma + t * (c[i] - luma), 0.0f), 1.0f);
+                idx[i][k] = int(std::sqrt(v) * float(CODE_MAX) + 0.5f);
+            }
+        }
+
+        // bt1886 output with the ordered dither
+        uint8_t* d = dst + x * dst_step;
+        for (k = 0; k < n; k++, d += dst_step)
+        {
+            int dither = bayer[(x + k) & 7] * 4 + 2;
+            d[0] = uint8_t((oetf[idx[0][k]] + dither) >> 8);
+            d[1] = uint8_t((oetf[idx[1][k]] + dither) >> 8);
+            d[2] = uint8_t((oetf[idx[2][k]] + dither) >> 8);
+        }
+    }
+}
+
+void HdrToneMapper::convert(const HdrPlanes& planes, int x, int y, int width, int height, int outWidth,
+                            int outHeight, int rotation, uint8_t* dst, int dst_linesize) const
+{
+    if (!is_configured() || outWidth < 1 || outHeight < 1)
+        return;
+
+    // frame column of each output pixel, the centre of the pixel it covers
+    std::vector<int> srcX(outWidth);
+    for (int i = 0; i < outWidth; i++)
+        srcX[i] = x + int((int64_t(2 * i + 1) * width) / (2 * int64_t(outWidth)));
+
+    // destination offset of output pixel (0, 0) and steps per output x/y,
+    // same layout as yuv420_to_rgb24_rotated
+    ptrdiff_t start = 0, step_x = 3, step_y = dst_linesize;
+    switch (rotation)
+    {
+        case 90:
+            start = ptrdiff_t(outHeight - 1) * 3;
+            step_x = dst_linesize;
+            step_y = -3;
+            break;
+        case 180:
+            start = ptrdiff_t(outHeight - 1) * dst_linesize + ptrdiff_t(outWidth - 1) * 3;
+            step_x = -3;
+            step_y = -ptrdiff_t(dst_linesize);
+            break;
+        case 270:
+            start = ptrdiff_t(outWidth - 1) * dst_linesize;
+            step_x = -ptrdiff_t(dst_linesize);
+            step_y = 3;
+            break;
+        default:
+            break;
+    }
+
+    bool bSimd = simd_level() != SimdLevel::Scalar;
+    cv::parallel_for_(cv::Range(0, outHeight), [&](const cv::Range& range) {
+        for (int row = range.start; row < range.end; ++row)
+        {
+            int sy = y + int((int64_t(2 * row + 1) * height) / (2 * int64_t(outHeight)));
+            convert_row(planes, srcX.data(), sy, row, outWidth, dst + start + row * step_y, step_x, bSimd);
+        }
+    });
+}
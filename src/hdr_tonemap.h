@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define PRINT_TONE_MAP_TIME 0
+
+enum class HdrTransfer
+{
+    SDR,
+    PQ, // smpte 2084, hdr10
+    HLG // arib std-b67
+};
+
+// curve of the tone mapping menu, off keeps the swscale path
+enum class ToneMapCurve
+{
+    Off,
+    Hable,
+    BT2390
+};
+
+// what the tone mapper needs to know of a frame
+typedef struct HdrFrameInfo
+{
+    HdrTransfer transfer{HdrTransfer::SDR};
+    bool bBt2020{true};     // bt2020 primaries, mapped to bt709
+    bool bFullRange{false};
+    int depth{10};          // bits per sample
+    double peakNits{1000};  // content peak from the metadata, 1000 if there is none
+} HdrFrameInfo;
+
+// one component of a frame with 16 bits samples
+typedef struct HdrComponent
+{
+    const uint8_t* data{nullptr};
+    int linesize{0};
+    int step{1};  // in samples, 2 for interleaved chroma
+    int shift{0}; // of the sample in the 16 bits, 6 for p010
+} HdrComponent;
+
+typedef struct HdrPlanes
+{
+    HdrComponent comp[3]; // y, u, v
+    int log2_chroma_w{1};
+    int log2_chroma_h{1};
+} HdrPlanes;
+
+// HDR to SDR conversion of PQ/HLG yuv frames to rgb24. Everything non linear is
+// precomputed when the frame info changes: yuv to R'G'B' as fixed point tables,
+// the EOTF, the tone curve as a gain indexed by max(R', G', B') so hue is kept,
+// and the bt1886 output curve. Per pixel that leaves table reads, the bt2020 to
+// bt709 matrix, a desaturating gamut clip and an ordered dither, the float part
+// runs on 4 pixels at once with SSE2 and rows are converted in parallel.
+class HdrToneMapper
+{
+public:
+    HdrToneMapper() = default;
+
+public:
+    // rebuilds the tables if the frame info or the curve changed
+    void configure(const HdrFrameInfo& info, ToneMapCurve curve);
+    inline bool is_configured() const { return m_curve != ToneMapCurve::Off; }
+
+    // rect of the frame to rgb24, dst is width x height
+    inline void convert(const HdrPlanes& planes, int x, int y, int width, int height, uint8_t* dst,
+                        int dst_linesize) const
+    {
+        convert(planes, x, y, width, height, width, height, 0, dst, dst_linesize);
+    }
+    // rect of the frame to rgb24 at outWidth x outHeight, not larger than the rect:
+    // nearest samples, painting smooths. Pixels are written at their position rotated
+    // clockwise by rotation (multiple of 90), dst is outHeight x outWidth for 90/270.
+    void convert(const HdrPlanes& planes, int x, int y, int width, int height, int outWidth, int outHeight,
+                 int rotation, uint8_t* dst, int dst_linesize) const;
+
+    static const char* curve_name(ToneMapCurve curve);
+
+private:
+    void build_tables();
+    double tone_curve(double nits) const; // display nits of a content light level
+    // srcX holds the frame column of each output pixel, dst steps by dst_step bytes per pixel
+    void convert_row(const HdrPlanes& planes, const int* srcX, int y, int row, int width, uint8_t* dst,
+                     ptrdiff_t dst_step, bool bSimd) const;
+
+private:
+    HdrFrameInfo m_info;
+    ToneMapCurve m_curve{ToneMapCurve::Off};
+    int m_sampleShift{0};              // to the table depth, at most 12 bits
+
+    std::vector<int> m_yTab;           // sample to R'G'B' code, 16.16 fixed point
+    std::vector<int> m_vrTab;
+    std::vector<int> m_ugTab;
+    std::vector<int> m_vgTab;
+    std::vector<int> m_ubTab;
+    std::vector<float> m_eotf;         // R'G'B' code to linear light, 1.0 is sdr white
+    std::vector<float> m_gain;         // max(R', G', B') code to tone mapped / linear
+    std::vector<uint16_t> m_oetf;      // sqrt of linear to bt1886 output, 8.8 fixed point
+    float m_gamut[9]{1, 0, 0, 0, 1, 0, 0, 0, 1};
+};
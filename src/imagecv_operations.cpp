@@ -140,6 +140,8 @@ Mat img2rgb(const Mat& img)
 
 Mat grey_img(const Mat& img)
 {
+    if (img.channels() == 1) // already grey, no copy
+        return img;
     return covert_color_img(img, COLOR_BGR2GRAY);
 }
 
@@ -159,14 +161,43 @@ Mat diff_imgs(const Mat& img1, const Mat& img2)
 
 double distance_imgs(const Mat& img1, const Mat& img2)
 {
-    Mat res;
-    auto diff = diff_imgs(img1, img2);
-    pow(diff, 2, res);
+    // squares summed in double, 8 bits differences would saturate
+    double sum = cv::norm(img1, img2, NORM_L2SQR);
+    return sqrt(sum / img1.channels());
+}
 
-    double sum1 = cv::sum(res)[0];
-    double sum2 = cv::sum(res)[1];
-    double sum3 = cv::sum(res)[2];
-    return sqrt((sum1 + sum2 + sum3) / 3);
+double sad_imgs(const Mat& img1, const Mat& img2)
+{
+    // mean absolute difference per sample, vectorized by opencv
+    if (img1.empty())
+        return 0;
+    return cv::norm(img1, img2, NORM_L1) / (double(img1.total()) * img1.channels());
+}
+
+double hist_distance_imgs(const Mat& img1, const Mat& img2, int bins)
+{
+    // 8 bits single channel, half the L1 distance of the normalized histograms, 0 to 1
+    CV_Assert(img1.type() == CV_8UC1 && img2.type() == CV_8UC1 && bins > 0 && bins <= 256);
+    if (img1.empty() || img2.empty())
+        return 0;
+
+    std::vector<int> hist1(bins, 0), hist2(bins, 0);
+    auto count = [bins](const Mat& img, std::vector<int>& hist) {
+        for (int y = 0; y < img.rows; ++y)
+        {
+            const uchar* p = img.ptr<uchar>(y);
+            for (int x = 0; x < img.cols; ++x)
+                ++hist[p[x] * bins >> 8];
+        }
+    };
+    count(img1, hist1);
+    count(img2, hist2);
+
+    double n1 = double(img1.total()), n2 = double(img2.total());
+    double sum = 0;
+    for (int i = 0; i < bins; ++i)
+        sum += std::abs(hist1[i] / n1 - hist2[i] / n2);
+    return sum / 2;
 }
 
 double psnr_img(const Mat& img1, const Mat& img2)
@@ -313,14 +344,14 @@ Mat thresholdAdaptive_img(const Mat& img, int adaptiveMethod, int thresholdType,
 
 Mat covert_color_img(const Mat& img, int format)
 {
-    auto res = img.clone();
+    Mat res;
     cv::cvtColor(img, res, format);
     return res;
 }
 
 Mat filter_img(const Mat& img, const Mat& kernel)
 {
-    auto res = img.clone();
+    Mat res;
     cv::filter2D(img, res, -1, kernel);
     return res;
 }
@@ -544,7 +575,7 @@ Mat laplacian_img(const Mat& I)
 Mat blur_img(const Mat& I, BlurType smoothType, int ksize, int sigma)
 {
     ksize = ksize | 1; // ksize must be odd number
-    auto smoothed = I.clone();
+    Mat smoothed;
     if (smoothType == GAUSSIAN)
     {
         cv::GaussianBlur(I, smoothed, Size(ksize, ksize), sigma, sigma);
@@ -587,6 +618,17 @@ Mat cornerHarris(const Mat& src)
     return dst_norm_scaled;
 }
 
+std::vector<Rect> face_detect_rects(CascadeClassifier& cascade, const Mat& gray, Size minSize)
+{
+    std::vector<Rect> faces;
+    Mat equalized;
+    equalizeHist(gray, equalized);
+
+    // Detect faces of different sizes using cascade classifier
+    cascade.detectMultiScale(equalized, faces, 1.1, 2, 0 | CASCADE_SCALE_IMAGE, minSize);
+    return faces;
+}
+
 void face_detect(Mat& img, const char* haarXML, double scale)
 {
     std::vector<Rect> faces;
@@ -604,10 +646,7 @@ void face_detect(Mat& img, const char* haarXML, double scale)
 
     // Resize the Grayscale Image
     resize(gray, smallImg, Size(), fx, fx, INTER_LINEAR);
-    equalizeHist(smallImg, smallImg);
-
-    // Detect faces of different sizes using cascade classifier
-    cascade.detectMultiScale(smallImg, faces, 1.1, 2, 0 | CASCADE_SCALE_IMAGE); // Size(30, 30)
+    faces = face_detect_rects(cascade, smallImg, Size());
 
     // Draw circles around the faces
     for (size_t i = 0; i < faces.size(); i++)
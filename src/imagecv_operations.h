@@ -49,6 +49,8 @@ Mat grey_img(const Mat& img);
 Mat resize_img(const Mat& img, int new_w, int new_h);
 Mat diff_imgs(const Mat& img1, const Mat& img2);
 double distance_imgs(const Mat& img1, const Mat& img2);
+double sad_imgs(const Mat& img1, const Mat& img2);
+double hist_distance_imgs(const Mat& img1, const Mat& img2, int bins = 32);
 double psnr_img(const Mat& img1, const Mat& img2);
 Mat flip_img(const Mat& img, int flipCode = 1);
 Mat rotate_img(const Mat& img, int rotateCode = ROTATE_90_CLOCKWISE);
@@ -95,6 +97,7 @@ Mat cornerHarris(const Mat& img);
 
 /*************face haar cascade detection *************/
 void face_detect(Mat& img, const char* haarXML, double scale = 1);
+std::vector<Rect> face_detect_rects(CascadeClassifier& cascade, const Mat& gray, Size minSize = Size(24, 24));
 
 #endif /* end of __IMAGECV_OPERATIONS_H__*/
 
@@ -0,0 +1,39 @@
+// ***********************************************************/
+// imagecv_parallel.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Band parallel execution of local OpenCV operations, bands
+// overlap by halo rows and are scheduled by OpenCV's pool.
+// ***********************************************************/
+
+#include <algorithm>
+#include "imagecv_parallel.h"
+
+cv::Mat parallel_rows_img(const cv::Mat& img, int dstType, const std::function<cv::Mat(const cv::Mat&)>& op, int halo)
+{
+    // bands shorter than this spend more time on halos than on their own rows
+    const int minBandRows = std::max(32, halo * 4);
+
+    int threads = cv::getNumThreads();
+    int bands = std::min(threads * 4, img.rows / minBandRows); // extra bands for stealing
+    if (threads <= 1 || bands <= 1)
+        return op(img);
+
+    cv::Mat dst(img.size(), dstType);
+    cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            int y0 = img.rows * i / bands;
+            int y1 = img.rows * (i + 1) / bands;
+            int e0 = std::max(0, y0 - halo);
+            int e1 = std::min(img.rows, y1 + halo);
+
+            cv::Mat res = op(img.rowRange(e0, e1));
+            CV_Assert(res.type() == dstType && res.rows == e1 - e0 && res.cols == img.cols);
+            res.rowRange(y0 - e0, y1 - e0).copyTo(dst.rowRange(y0, y1));
+        }
+    }, bands);
+
+    return dst;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+#include <opencv2/core.hpp>
+
+// rows of context each band reads above and below, enough for the 11x11
+// adaptive threshold block, the largest window of the local effects
+#define TILE_HALO_ROWS 8
+
+// Runs a local image operation on horizontal bands with cv::parallel_for_.
+// Each band is processed with halo rows from its neighbours and only its own
+// rows are kept, so the output is identical to calling op on the whole image,
+// as long as op reads at most halo rows around each pixel. Small images are
+// processed with a single call.
+cv::Mat parallel_rows_img(const cv::Mat& img, int dstType, const std::function<cv::Mat(const cv::Mat&)>& op,
+                          int halo = TILE_HALO_ROWS);
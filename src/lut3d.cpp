@@ -0,0 +1,237 @@
+// ***********************************************************/
+// lut3d.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// .cube 3D LUT loader and tetrahedral interpolation. The cell
+// of a pixel is split into 6 tetrahedra by the order of the
+// fractions, 4 corners are weighted. Corners are rgb in one
+// SSE register, so the weighted sum is 4 multiplies and the
+// rows of the frame run in parallel.
+// ***********************************************************/
+
+#include "lut3d.h"
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LUT3D_SSE 1
+#include <emmintrin.h>
+#else
+#define LUT3D_SSE 0
+#endif
+
+#define LUT3D_MAX_SIZE 256
+
+bool Lut3D::load_cube(const QString& file)
+{
+    QFile f(file);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qWarning("Failed to open LUT: %s", qUtf8Printable(file));
+        return false;
+    }
+
+    QString title = QFileInfo(file).completeBaseName();
+    int size = 0;
+    float domainMin[3] = {0, 0, 0};
+    float domainMax[3] = {1, 1, 1};
+    std::vector<float> table;
+
+    QTextStream in(&f);
+    int lineNo = 0;
+    while (!in.atEnd())
+    {
+        auto line = in.readLine().simplified();
+        lineNo++;
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        auto parts = line.split(' ');
+        const auto& key = parts[0];
+        if (key == "TITLE")
+        {
+            title = line.mid(5).remove('"').trimmed();
+        }
+        else if (key == "LUT_3D_SIZE" && parts.size() == 2)
+        {
+            size = parts[1].toInt();
+            if (size < 2 || size > LUT3D_MAX_SIZE)
+            {
+                qWarning("LUT %s: unsupported size %d", qUtf8Printable(file), size);
+                return false;
+            }
+            table.reserve(size_t(size) * size * size * 3);
+        }
+        else if ((key == "DOMAIN_MIN" || key == "DOMAIN_MAX") && parts.size() == 4)
+        {
+            float* domain = key == "DOMAIN_MIN" ? domainMin : domainMax;
+            for (int c = 0; c < 3; c++)
+                domain[c] = parts[c + 1].toFloat();
+        }
+        else if (key == "LUT_3D_INPUT_RANGE" && parts.size() == 3)
+        {
+            std::fill_n(domainMin, 3, parts[1].toFloat());
+            std::fill_n(domainMax, 3, parts[2].toFloat());
+        }
+        else if (key == "LUT_1D_SIZE")
+        {
+            qWarning("LUT %s: 1D LUTs are not supported", qUtf8Printable(file));
+            return false;
+        }
+        else if (parts.size() == 3 && size > 0)
+        {
+            for (const auto& part : parts)
+            {
+                bool bOk = false;
+                table.push_back(part.toFloat(&bOk));
+                if (!bOk)
+                {
+                    qWarning("LUT %s: bad value at line %d", qUtf8Printable(file), lineNo);
+                    return false;
+                }
+            }
+        }
+        else
+        {
+            qWarning("LUT %s: unknown line %d ignored: %s", qUtf8Printable(file), lineNo, qUtf8Printable(line));
+        }
+    }
+
+    if (size == 0 || table.size() != size_t(size) * size * size * 3)
+    {
+        qWarning("LUT %s: expected %d entries, found %d", qUtf8Printable(file), size * size * size,
+                 int(table.size() / 3));
+        return false;
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        if (domainMax[c] <= domainMin[c])
+        {
+            qWarning("LUT %s: bad domain", qUtf8Printable(file));
+            return false;
+        }
+    }
+
+    m_size = size;
+    m_title = title;
+    pack(table, domainMin, domainMax);
+    return true;
+}
+
+void Lut3D::pack(const std::vector<float>& table, const float domainMin[3], const float domainMax[3])
+{
+    // outputs are clamped and scaled once, interpolation stays inside 0..255
+    m_lattice.resize(table.size() / 3);
+    for (size_t i = 0; i < m_lattice.size(); i++)
+    {
+        for (int c = 0; c < 3; c++)
+            m_lattice[i][c] = std::clamp(table[i * 3 + c], 0.0f, 1.0f) * 255.0f;
+        m_lattice[i][3] = 0;
+    }
+
+    // input value to lower corner and fraction, the domain is folded in here
+    const int strides[3] = {1, m_size, m_size * m_size};
+    for (int c = 0; c < 3; c++)
+    {
+        for (int v = 0; v < 256; v++)
+        {
+            float pos = (v / 255.0f - domainMin[c]) / (domainMax[c] - domainMin[c]) * (m_size - 1);
+            pos = std::clamp(pos, 0.0f, float(m_size - 1));
+            int i = std::min(int(pos), m_size - 2);
+            m_offset[c][v] = i * strides[c];
+            m_frac[c][v] = pos - i;
+        }
+    }
+}
+
+void Lut3D::apply_rows(const cv::Mat& src, cv::Mat& dst, int y0, int y1) const
+{
+    const int dr = 1, dg = m_size, db = m_size * m_size;
+    const cv::Vec4f* lattice = m_lattice.data();
+
+    for (int y = y0; y < y1; ++y)
+    {
+        const uchar* s = src.ptr<uchar>(y);
+        uchar* d = dst.ptr<uchar>(y);
+        for (int x = 0; x < src.cols; ++x, s += 3, d += 3)
+        {
+            const float fr = m_frac[0][s[0]], fg = m_frac[1][s[1]], fb = m_frac[2][s[2]];
+            const int base = m_offset[0][s[0]] + m_offset[1][s[1]] + m_offset[2][s[2]];
+
+            // corners after the first one and their weights, by the tetrahedron
+            int o1, o2;
+            float w0, w1, w2, w3;
+            if (fr > fg)
+            {
+                if (fg > fb) // r > g > b
+                {
+                    o1 = dr, o2 = dr + dg;
+                    w0 = 1 - fr, w1 = fr - fg, w2 = fg - fb, w3 = fb;
+                }
+                else if (fr > fb) // r > b >= g
+                {
+                    o1 = dr, o2 = dr + db;
+                    w0 = 1 - fr, w1 = fr - fb, w2 = fb - fg, w3 = fg;
+                }
+                else // b >= r > g
+                {
+                    o1 = db, o2 = dr + db;
+                    w0 = 1 - fb, w1 = fb - fr, w2 = fr - fg, w3 = fg;
+                }
+            }
+            else
+            {
+                if (fb > fg) // b > g >= r
+                {
+                    o1 = db, o2 = dg + db;
+                    w0 = 1 - fb, w1 = fb - fg, w2 = fg - fr, w3 = fr;
+                }
+                else if (fb > fr) // g >= b > r
+                {
+                    o1 = dg, o2 = dg + db;
+                    w0 = 1 - fg, w1 = fg - fb, w2 = fb - fr, w3 = fr;
+                }
+                else // g >= r >= b
+                {
+                    o1 = dg, o2 = dr + dg;
+                    w0 = 1 - fg, w1 = fg - fr, w2 = fr - fb, w3 = fb;
+                }
+            }
+
+            const float* c0 = lattice[base].val;
+            const float* c1 = lattice[base + o1].val;
+            const float* c2 = lattice[base + o2].val;
+            const float* c3 = lattice[base + dr + dg + db].val;
+#if LUT3D_SSE
+            __m128 sum = _mm_mul_ps(_mm_loadu_ps(c0), _mm_set1_ps(w0));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(c1), _mm_set1_ps(w1)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(c2), _mm_set1_ps(w2)));
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(c3), _mm_set1_ps(w3)));
+            __m128i rgb = _mm_cvtps_epi32(sum);
+            rgb = _mm_packus_epi16(_mm_packs_epi32(rgb, rgb), rgb);
+            uint32_t packed = uint32_t(_mm_cvtsi128_si32(rgb));
+            d[0] = uchar(packed);
+            d[1] = uchar(packed >> 8);
+            d[2] = uchar(packed >> 16);
+#else
+            for (int c = 0; c < 3; c++)
+                d[c] = cv::saturate_cast<uchar>(c0[c] * w0 + c1[c] * w1 + c2[c] * w2 + c3[c] * w3);
+#endif
+        }
+    }
+}
+
+void Lut3D::apply(const cv::Mat& src, cv::Mat& dst) const
+{
+    CV_Assert(src.type() == CV_8UC3 && !empty());
+    if (dst.data != src.data)
+        dst.create(src.size(), CV_8UC3);
+
+    cv::parallel_for_(cv::Range(0, src.rows), [&](const cv::Range& range) {
+        apply_rows(src, dst, range.start, range.end);
+    });
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QString>
+#include <opencv2/core.hpp>
+#include <vector>
+
+// 3D colour lookup table from a .cube file, applied to 8 bits rgb frames
+// with tetrahedral interpolation. The lattice is packed on load as
+// 4 floats per entry in output scale, and the input side as per channel
+// tables of lattice offset and fraction, so a pixel is 3 table reads,
+// 4 lattice reads and a weighted sum.
+class Lut3D
+{
+public:
+    Lut3D() = default;
+
+public:
+    bool load_cube(const QString& file);
+    inline bool empty() const { return m_size == 0; }
+    inline int size() const { return m_size; }
+    inline const QString& title() const { return m_title; }
+
+    // src and dst are rgb 8 bits, dst may be src
+    void apply(const cv::Mat& src, cv::Mat& dst) const;
+
+private:
+    void pack(const std::vector<float>& table, const float domainMin[3], const float domainMax[3]);
+    void apply_rows(const cv::Mat& src, cv::Mat& dst, int y0, int y1) const;
+
+private:
+    int m_size{0};
+    QString m_title;
+    std::vector<cv::Vec4f> m_lattice; // red fastest, scaled to 0..255
+    int m_offset[3][256];             // lattice offset of the lower corner, per channel value
+    float m_frac[3][256];             // position inside the cell
+};
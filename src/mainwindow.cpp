@@ -9,6 +9,7 @@
 #include "mainwindow.h"
 #include "common.h"
 #include "about.h"
+#include "cv_benchmark.h"
 #include "ffmpeg_init.h"
 #include "imagecv_operations.h"
 #include "qimage_convert_mat.h"
@@ -31,10 +32,16 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent), ui(std::make_uniq
                    Qt::WindowMaximizeButtonHint | Qt::WindowCloseButtonHint);
 
     create_video_label();
+    create_video_effect_stage();
     create_play_control();
     create_style_menu();
     create_recentfiles_menu();
     create_cv_action_group();
+    create_filters_menu();
+    create_tone_map_menu();
+    create_scopes_dock();
+    create_scenes_dock();
+    create_compare_dock();
     create_audio_effect();
     create_avisual_action_group();
     create_playlist_wnd();
@@ -109,9 +116,198 @@ void MainWindow::create_video_label()
 {
     m_video_label = std::make_unique<VideoLabel>(centralWidget());
     m_video_label->setObjectName(QString::fromUtf8("label_Video"));
-    m_video_label->setScaledContents(true);
     m_video_label->setWindowFlags(m_video_label->windowFlags() | Qt::SubWindow);
     m_video_label->show();
+
+    connect(m_video_label.get(), &VideoLabel::view_changed, this, &MainWindow::video_view_changed);
+}
+
+void MainWindow::create_video_effect_stage()
+{
+    m_effectStage = std::make_unique<VideoEffectStage>(this);
+    connect(m_effectStage.get(), &VideoEffectStage::frame_processed, this, &MainWindow::effect_frame_ready);
+
+    // effect fps against video fps, shown while effects are on
+    m_statsTimer.setInterval(1000);
+    connect(&m_statsTimer, &QTimer::timeout, this, &MainWindow::update_effect_stats);
+}
+
+void MainWindow::effect_frame_ready(const QImage& img)
+{
+    // frames still in the effect stage when playing stopped
+    if (m_pVideoPlayThread)
+        update_image(img);
+}
+
+void MainWindow::update_effect_stats()
+{
+    int processed = 0, dropped = 0;
+    m_effectStage->take_stats(processed, dropped);
+
+    int frames = m_videoFrames;
+    m_videoFrames = 0;
+
+    int toneMapFrames = 0;
+    double toneMapMs = 0;
+    QSize toneMapSize;
+    if (auto pThread = get_video_play_thread())
+        pThread->take_tone_map_stats(toneMapFrames, toneMapMs, toneMapSize);
+
+    int upscaleFrames = 0;
+    double upscaleMs = 0;
+    QSize upscaleSrcSize, upscaleSize;
+    if (auto pThread = get_video_play_thread())
+        pThread->take_upscale_stats(upscaleFrames, upscaleMs, upscaleSrcSize, upscaleSize);
+
+    std::vector<CompareSample> compareSamples;
+    double compareMs = 0;
+    int compareUnmatched = 0;
+    bool bCompare = false;
+    if (auto pThread = get_video_play_thread())
+    {
+        bCompare = pThread->is_comparing();
+        pThread->take_compare_stats(compareSamples, compareMs, compareUnmatched);
+    }
+    m_compareGraph->add_samples(compareSamples);
+
+    bool bDeinterlacing = false;
+    double filterMs = 0;
+    if (m_pVideoState)
+    {
+        if (auto pState = m_pVideoState->get_state())
+        {
+            bDeinterlacing = pState->deinterlacing;
+            filterMs = pState->vfilter_time * 1000;
+        }
+    }
+
+    int interpFrames = 0, interpBlended = 0;
+    double interpMs = 0;
+    if (m_pDecodeVideoThread)
+        m_pDecodeVideoThread->take_interpolation_stats(interpFrames, interpBlended, interpMs);
+
+    int denoiseFrames = 0;
+    double denoiseMs = 0, noise = 0;
+    if (m_pDecodeVideoThread)
+        m_pDecodeVideoThread->take_denoise_stats(denoiseFrames, denoiseMs, noise);
+
+    bool bToneMap = get_tone_map_curve() != ToneMapCurve::Off;
+    bool bDeinterlace = get_deinterlace_mode() != DeinterlaceMode::Off;
+    bool bUpscale = ui->actionUpscale->isChecked();
+    bool bInterpolate = ui->actionFilter_Interpolate->isChecked();
+    bool bDenoise = get_denoise_strength() != DenoiseStrength::Off;
+    bool bUserStats = cv_effects_enabled() || !m_videoFilters.isEmpty() || bInterpolate || bDenoise || bCompare;
+    if (!bUserStats && !bToneMap && !bDeinterlace && !bUpscale)
+    {
+        m_statsTimer.stop();
+        displayStatusMessage("");
+        return;
+    }
+
+    // tone mapping, deinterlacing and upscaling are on for every file, only hdr,
+    // interlaced and small ones have something to show, other status messages are kept
+    bool bAutoStats = toneMapFrames > 0 || bDeinterlacing || upscaleFrames > 0;
+    if (!bUserStats && !bAutoStats)
+    {
+        if (m_bAutoStats)
+            displayStatusMessage("");
+        m_bAutoStats = false;
+        return;
+    }
+    m_bAutoStats = bAutoStats;
+
+    QStringList stats;
+    if (toneMapFrames > 0)
+    {
+        stats << QString("HDR %1: %2 ms (%3x%4)")
+                     .arg(HdrToneMapper::curve_name(get_tone_map_curve()))
+                     .arg(toneMapMs, 0, 'f', 1)
+                     .arg(toneMapSize.width())
+                     .arg(toneMapSize.height());
+    }
+    if (upscaleFrames > 0)
+    {
+        stats << QString("Upscaled %1x%2 to %3x%4: %5 ms")
+                     .arg(upscaleSrcSize.width())
+                     .arg(upscaleSrcSize.height())
+                     .arg(upscaleSize.width())
+                     .arg(upscaleSize.height())
+                     .arg(upscaleMs, 0, 'f', 1);
+    }
+    if (bDeinterlacing || !m_videoFilters.isEmpty())
+    {
+        // one graph, bwdif runs first
+        QString name = "Filters";
+        if (bDeinterlacing)
+        {
+            name = get_deinterlace_mode() == DeinterlaceMode::AutoFieldRate ? "Deinterlace bwdif field rate"
+                                                                             : "Deinterlace bwdif";
+            if (!m_videoFilters.isEmpty())
+                name += " + filters";
+        }
+        stats << QString("%1: %2 ms").arg(name).arg(filterMs, 0, 'f', 1);
+    }
+    if (bDenoise)
+    {
+        stats << QString("Denoise %1: %2 ms, noise %3")
+                     .arg(TemporalDenoiser::strength_name(get_denoise_strength()))
+                     .arg(denoiseMs, 0, 'f', 1)
+                     .arg(noise, 0, 'f', 1);
+    }
+    if (bInterpolate)
+    {
+        // the video fps below is the achieved output rate
+        auto interp = QString("Interpolated: %1 fps, %2 ms").arg(interpFrames).arg(interpMs, 0, 'f', 1);
+        if (interpBlended > 0)
+            interp += QString(" (%1 blended)").arg(interpBlended);
+        stats << interp;
+    }
+    if (bCompare)
+    {
+        // mean of the frames measured in the last second, the graph has each one
+        CompareMetrics mean;
+        for (const auto& sample : compareSamples)
+        {
+            mean.psnr += sample.metrics.psnr / compareSamples.size();
+            mean.ssim += sample.metrics.ssim / compareSamples.size();
+        }
+        auto compare = compareSamples.empty() ? QString("Compare: waiting for B")
+                                              : QString("Compare: PSNR %1 dB, SSIM %2, %3 ms")
+                                                    .arg(mean.psnr, 0, 'f', 2)
+                                                    .arg(mean.ssim, 0, 'f', 4)
+                                                    .arg(compareMs, 0, 'f', 1);
+        if (compareUnmatched > 0)
+            compare += QString(" (%1 frames not matched)").arg(compareUnmatched);
+        stats << compare;
+    }
+    if (cv_effects_enabled())
+    {
+        auto effects = QString("Effects: %1 fps (%2 dropped, %3 ms")
+                           .arg(processed)
+                           .arg(dropped)
+                           .arg(m_effectStage->average_ms(), 0, 'f', 1);
+        int divisor = m_effectStage->proxy_divisor();
+        if (divisor > 1 && m_cvEffects->is_expensive())
+            effects += QString(", 1/%1 res").arg(divisor);
+        stats << effects + ")";
+
+        int faces = 0, latencyFrames = 0;
+        double latencyMs = 0;
+        if (m_effectStage->face_stats(faces, latencyMs, latencyFrames))
+            stats << QString("Faces: %1 (detection %2 ms, %3 frames behind)")
+                         .arg(faces)
+                         .arg(latencyMs, 0, 'f', 0)
+                         .arg(latencyFrames);
+    }
+    stats << QString("Video: %1 fps").arg(frames);
+
+    displayStatusMessage(stats.join(", "));
+}
+
+void MainWindow::video_view_changed(const QRectF& roi, const QSize& displaySize)
+{
+    if (auto pThread = get_video_play_thread())
+        pThread->set_view(roi, displaySize);
 }
 
 void MainWindow::create_audio_effect()
@@ -218,10 +414,6 @@ void MainWindow::create_cv_action_group()
     m_CvActsGroup->addAction(ui->actionEqualizeHist);
     m_CvActsGroup->addAction(ui->actionThreshold);
     m_CvActsGroup->addAction(ui->actionThreshold_Adaptive);
-    m_CvActsGroup->addAction(ui->actionReverse);
-    m_CvActsGroup->addAction(ui->actionColorReduce);
-    m_CvActsGroup->addAction(ui->actionGamma);
-    m_CvActsGroup->addAction(ui->actionContrastBright);
     m_CvActsGroup->addAction(ui->actionCanny);
     m_CvActsGroup->addAction(ui->actionBlur);
     m_CvActsGroup->addAction(ui->actionSobel);
@@ -240,6 +432,552 @@ void MainWindow::create_cv_action_group()
         "cause this program to freezing if your CPU is not real-time capable. "
         "But you can select a low-resolution video for testing these features.";
     ui->actionRemoveCV->setToolTip(tips);
+
+    // cv effects work on rgb images, switch back from video sink output
+    // the effect chain is only rebuilt when the selection changes
+    connect(m_CvActsGroup.get(), &QActionGroup::triggered, this, &MainWindow::update_cv_effects);
+    connect(ui->actionGrayscale, &QAction::toggled, this, &MainWindow::update_cv_effects);
+    connect(ui->actionMirro, &QAction::toggled, this, &MainWindow::update_cv_effects);
+    connect(ui->actionTransform, &QAction::toggled, this, &MainWindow::update_cv_effects);
+    connect(ui->actionFace_Highlight, &QAction::toggled, this, &MainWindow::update_cv_effects);
+    connect(ui->actionLut3D, &QAction::toggled, this, &MainWindow::update_cv_effects);
+
+    // point operations can be combined, they are fused into one pass
+    for (auto pAction : {ui->actionReverse, ui->actionColorReduce, ui->actionGamma,
+                         ui->actionContrastBright, ui->actionLighter, ui->actionExposure})
+        connect(pAction, &QAction::toggled, this, &MainWindow::update_cv_effects);
+    update_cv_effects();
+
+    // expensive effects may run on a downscaled proxy
+    m_QualityActsGroup = std::make_unique<QActionGroup>(this);
+    m_QualityActsGroup->addAction(ui->actionQuality_Adaptive);
+    m_QualityActsGroup->addAction(ui->actionQuality_Full);
+    m_QualityActsGroup->addAction(ui->actionQuality_Half);
+    m_QualityActsGroup->addAction(ui->actionQuality_Quarter);
+    ui->actionQuality_Adaptive->setToolTip("Lower the resolution of heavy effects when they can not keep up with the video.");
+    connect(m_QualityActsGroup.get(), &QActionGroup::triggered, this, &MainWindow::update_effect_quality);
+}
+
+EffectQuality MainWindow::get_effect_quality() const
+{
+    if (ui->actionQuality_Full->isChecked())
+        return EffectQuality::Full;
+    if (ui->actionQuality_Half->isChecked())
+        return EffectQuality::Half;
+    if (ui->actionQuality_Quarter->isChecked())
+        return EffectQuality::Quarter;
+    return EffectQuality::Adaptive;
+}
+
+void MainWindow::set_effect_quality(EffectQuality quality)
+{
+    switch (quality)
+    {
+        case EffectQuality::Full:
+            ui->actionQuality_Full->setChecked(true);
+            break;
+        case EffectQuality::Half:
+            ui->actionQuality_Half->setChecked(true);
+            break;
+        case EffectQuality::Quarter:
+            ui->actionQuality_Quarter->setChecked(true);
+            break;
+        default:
+            ui->actionQuality_Adaptive->setChecked(true);
+            break;
+    }
+    update_effect_quality();
+}
+
+void MainWindow::update_effect_quality()
+{
+    m_effectStage->set_quality(get_effect_quality());
+}
+
+void MainWindow::update_cv_effects()
+{
+    const std::pair<QAction*, CvEffect> group[] = {
+        {ui->actionRepeat, CvEffect::Repeat},
+        {ui->actionEqualizeHist, CvEffect::EqualizeHist},
+        {ui->actionThreshold, CvEffect::Threshold},
+        {ui->actionThreshold_Adaptive, CvEffect::ThresholdAdaptive},
+        {ui->actionCanny, CvEffect::Canny},
+        {ui->actionBlur, CvEffect::Blur},
+        {ui->actionSobel, CvEffect::Sobel},
+        {ui->actionLaplacian, CvEffect::Laplacian},
+        {ui->actionScharr, CvEffect::Scharr},
+        {ui->actionPrewitt, CvEffect::Prewitt},
+    };
+    const std::pair<QAction*, CvEffect> pointOps[] = {
+        {ui->actionReverse, CvEffect::Reverse},
+        {ui->actionColorReduce, CvEffect::ColorReduce},
+        {ui->actionGamma, CvEffect::Gamma},
+        {ui->actionContrastBright, CvEffect::ContrastBright},
+        {ui->actionLighter, CvEffect::Lighter},
+        {ui->actionExposure, CvEffect::Exposure},
+    };
+
+    std::vector<CvEffect> effects;
+    if (ui->actionLut3D->isChecked())
+        effects.push_back(CvEffect::Lut3D); // grading first, the other effects see the graded frame
+    for (const auto& [pAction, effect] : group)
+    {
+        if (pAction->isChecked())
+            effects.push_back(effect);
+    }
+    for (const auto& [pAction, effect] : pointOps)
+    {
+        if (pAction->isChecked())
+            effects.push_back(effect);
+    }
+
+    if (ui->actionGrayscale->isChecked())
+        effects.push_back(CvEffect::Grayscale);
+    if (ui->actionMirro->isChecked())
+        effects.push_back(CvEffect::Mirror);
+    if (ui->actionTransform->isChecked())
+        effects.push_back(CvEffect::Transform);
+
+    m_cvEffects = std::make_shared<CvEffectChain>(effects, m_lut3d);
+    m_effectStage->set_effects(m_cvEffects);
+    m_effectStage->set_face_tracking(ui->actionFace_Highlight->isChecked());
+
+    if (cv_effects_enabled() && !m_statsTimer.isActive())
+        m_statsTimer.start();
+
+    update_sink_output();
+    update_video_rotation();
+}
+
+void MainWindow::create_filters_menu()
+{
+    ui->menuFilters->setToolTipsVisible(true);
+
+    for (auto pAction : ui->menuFilters->actions())
+        connect(pAction, &QAction::toggled, this, &MainWindow::update_video_filters);
+
+    m_DenoiseActsGroup = std::make_unique<QActionGroup>(this);
+    m_DenoiseActsGroup->addAction(ui->actionDenoise_Light);
+    m_DenoiseActsGroup->addAction(ui->actionDenoise_Medium);
+    m_DenoiseActsGroup->addAction(ui->actionDenoise_Strong);
+    m_DenoiseActsGroup->addAction(ui->actionDenoise_Off);
+    ui->menuTemporal_Denoise->setToolTipsVisible(true);
+    connect(m_DenoiseActsGroup.get(), &QActionGroup::triggered, this, &MainWindow::update_video_filters);
+}
+
+DenoiseStrength MainWindow::get_denoise_strength() const
+{
+    if (ui->actionDenoise_Light->isChecked())
+        return DenoiseStrength::Light;
+    if (ui->actionDenoise_Medium->isChecked())
+        return DenoiseStrength::Medium;
+    if (ui->actionDenoise_Strong->isChecked())
+        return DenoiseStrength::Strong;
+    return DenoiseStrength::Off;
+}
+
+void MainWindow::set_denoise_strength(DenoiseStrength strength)
+{
+    switch (strength)
+    {
+        case DenoiseStrength::Light:
+            ui->actionDenoise_Light->setChecked(true);
+            break;
+        case DenoiseStrength::Medium:
+            ui->actionDenoise_Medium->setChecked(true);
+            break;
+        case DenoiseStrength::Strong:
+            ui->actionDenoise_Strong->setChecked(true);
+            break;
+        default:
+            ui->actionDenoise_Off->setChecked(true);
+            break;
+    }
+    update_video_filters();
+}
+
+DeinterlaceMode MainWindow::get_deinterlace_mode() const
+{
+    if (!ui->actionFilter_Deinterlace->isChecked())
+        return DeinterlaceMode::Off;
+    return ui->actionFilter_FieldRate->isChecked() ? DeinterlaceMode::AutoFieldRate : DeinterlaceMode::Auto;
+}
+
+void MainWindow::set_deinterlace_mode(DeinterlaceMode mode)
+{
+    ui->actionFilter_Deinterlace->setChecked(mode != DeinterlaceMode::Off);
+    ui->actionFilter_FieldRate->setChecked(mode == DeinterlaceMode::AutoFieldRate);
+}
+
+void MainWindow::create_tone_map_menu()
+{
+    m_ToneMapActsGroup = std::make_unique<QActionGroup>(this);
+    m_ToneMapActsGroup->addAction(ui->actionToneMap_BT2390);
+    m_ToneMapActsGroup->addAction(ui->actionToneMap_Hable);
+    m_ToneMapActsGroup->addAction(ui->actionToneMap_Off);
+    ui->menuHDR_Tone_Mapping->setToolTipsVisible(true);
+    ui->actionToneMap_BT2390->setToolTip("Keeps the mid tones, compresses the highlights only.");
+    ui->actionToneMap_Hable->setToolTip("Filmic curve, softer highlights and darker mid tones.");
+    connect(m_ToneMapActsGroup.get(), &QActionGroup::triggered, this, &MainWindow::update_tone_map);
+}
+
+ToneMapCurve MainWindow::get_tone_map_curve() const
+{
+    if (ui->actionToneMap_Hable->isChecked())
+        return ToneMapCurve::Hable;
+    if (ui->actionToneMap_Off->isChecked())
+        return ToneMapCurve::Off;
+    return ToneMapCurve::BT2390;
+}
+
+void MainWindow::set_tone_map_curve(ToneMapCurve curve)
+{
+    switch (curve)
+    {
+        case ToneMapCurve::Hable:
+            ui->actionToneMap_Hable->setChecked(true);
+            break;
+        case ToneMapCurve::Off:
+            ui->actionToneMap_Off->setChecked(true);
+            break;
+        default:
+            ui->actionToneMap_BT2390->setChecked(true);
+            break;
+    }
+    update_tone_map();
+}
+
+void MainWindow::update_tone_map()
+{
+    auto curve = get_tone_map_curve();
+    if (auto pThread = get_video_play_thread())
+        pThread->set_tone_map(curve);
+
+    // the cost is shown while hdr frames are tone mapped
+    if (curve != ToneMapCurve::Off && !m_statsTimer.isActive())
+        m_statsTimer.start();
+}
+
+void MainWindow::create_scopes_dock()
+{
+    m_scopesDock = std::make_unique<QDockWidget>("Scopes", this);
+    m_scopesDock->setObjectName(QString::fromUtf8("dock_Scopes"));
+    m_scopesDock->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
+
+    m_scopesWidget = new VideoScopesWidget(m_scopesDock.get());
+    m_scopesDock->setWidget(m_scopesWidget);
+    addDockWidget(Qt::RightDockWidgetArea, m_scopesDock.get());
+    m_scopesDock->hide();
+
+    auto pAction = m_scopesDock->toggleViewAction();
+    pAction->setText("Scopes");
+    ui->menuView->addAction(pAction);
+
+    connect(m_scopesDock.get(), &QDockWidget::visibilityChanged, this, &MainWindow::scopes_visibility_changed);
+}
+
+void MainWindow::scopes_visibility_changed(bool bVisible)
+{
+    // scopes are only sampled while they can be seen
+    if (auto pThread = get_video_play_thread())
+        pThread->set_scopes(bVisible);
+    if (!bVisible)
+        m_scopesWidget->clear();
+}
+
+void MainWindow::create_compare_dock()
+{
+    m_compareDock = std::make_unique<QDockWidget>("Compare", this);
+    m_compareDock->setObjectName(QString::fromUtf8("dock_Compare"));
+    m_compareDock->setAllowedAreas(Qt::TopDockWidgetArea | Qt::BottomDockWidgetArea);
+
+    m_compareGraph = new CompareGraphWidget(m_compareDock.get());
+    m_compareDock->setWidget(m_compareGraph);
+    addDockWidget(Qt::BottomDockWidgetArea, m_compareDock.get());
+    m_compareDock->hide();
+
+    auto pAction = m_compareDock->toggleViewAction();
+    pAction->setText("Compare");
+    ui->menuView->addAction(pAction);
+
+    m_CompareActsGroup = std::make_unique<QActionGroup>(this);
+    m_CompareActsGroup->addAction(ui->actionCompare_Wipe);
+    m_CompareActsGroup->addAction(ui->actionCompare_Split);
+    ui->menuAB_Compare->setToolTipsVisible(true);
+    ui->actionCompare_Wipe->setToolTip("A left of the divider, B right of it, move it with [ and ]");
+    ui->actionCompare_Split->setToolTip("A and B side by side at full size");
+    connect(m_CompareActsGroup.get(), &QActionGroup::triggered, this, &MainWindow::update_compare_view);
+    connect(m_compareGraph, &CompareGraphWidget::seek_requested, this, &MainWindow::compare_graph_seek);
+}
+
+void MainWindow::update_compare_view()
+{
+    if (auto pThread = get_video_play_thread())
+        pThread->set_compare_view(ui->actionCompare_Split->isChecked() ? CompareView::Split : CompareView::Wipe);
+}
+
+void MainWindow::stop_compare()
+{
+    if (auto pThread = get_video_play_thread())
+        pThread->stop_compare();
+    m_compareDock->setWindowTitle("Compare"); // the graph is kept for a look after
+}
+
+void MainWindow::adjust_compare_wipe(double delta)
+{
+    auto pThread = get_video_play_thread();
+    if (!pThread || !pThread->is_comparing())
+        return;
+
+    pThread->set_compare_wipe(pThread->compare_wipe() + delta);
+    displayStatusMessage(QString("Wipe at %1%").arg(qRound(pThread->compare_wipe() * 100)));
+}
+
+double MainWindow::playing_start_time() const
+{
+    if (!m_pVideoState)
+        return 0;
+
+    auto pState = m_pVideoState->get_state();
+    if (!pState || !pState->ic || pState->ic->start_time == AV_NOPTS_VALUE)
+        return 0;
+    return pState->ic->start_time / double(AV_TIME_BASE);
+}
+
+void MainWindow::compare_graph_seek(double pos)
+{
+    double cur = 0;
+    if (!get_play_pos(cur))
+        return;
+
+    // the graph runs from the start of the file
+    double time = pos + playing_start_time();
+    video_seek(time, time - cur);
+}
+
+void MainWindow::create_scenes_dock()
+{
+    m_scenesDock = std::make_unique<QDockWidget>("Scenes", this);
+    m_scenesDock->setObjectName(QString::fromUtf8("dock_Scenes"));
+    m_scenesDock->setAllowedAreas(Qt::AllDockWidgetAreas);
+
+    // chapter like thumbnails of the scene cuts
+    m_scenesList = new QListWidget(m_scenesDock.get());
+    m_scenesList->setViewMode(QListView::IconMode);
+    m_scenesList->setIconSize(QSize(160, 90));
+    m_scenesList->setResizeMode(QListView::Adjust);
+    m_scenesList->setMovement(QListView::Static);
+    m_scenesList->setUniformItemSizes(true);
+    m_scenesList->setSpacing(4);
+    m_scenesDock->setWidget(m_scenesList);
+    addDockWidget(Qt::BottomDockWidgetArea, m_scenesDock.get());
+    m_scenesDock->hide();
+
+    auto pAction = m_scenesDock->toggleViewAction();
+    pAction->setText("Scenes");
+    ui->menuView->addAction(pAction);
+
+    connect(m_scenesList, &QListWidget::itemClicked, this, &MainWindow::scene_item_clicked);
+}
+
+void MainWindow::start_scene_index()
+{
+    stop_scene_index();
+
+    // local files only, a network stream would be downloaded twice
+    if (!playing_has_video() || !QFileInfo(m_videoFile).isFile())
+        return;
+
+    m_hintedMarker = -1;
+    m_pSceneIndex = std::make_unique<SceneIndexThread>(m_videoFile);
+    connect(m_pSceneIndex.get(), &SceneIndexThread::scenes_updated, this, &MainWindow::update_scenes);
+    m_pSceneIndex->start(QThread::IdlePriority);
+    qDebug("++++++++++ Scene index thread started.");
+}
+
+void MainWindow::stop_scene_index()
+{
+    m_pSceneIndex.reset(); // file reading is interrupted, waits shortly
+    update_scenes();
+}
+
+void MainWindow::update_scenes()
+{
+    update_markers();
+
+    if (!m_pSceneIndex)
+    {
+        m_scenesList->clear();
+        m_scenesDock->setWindowTitle("Scenes");
+        return;
+    }
+
+    auto scenes = m_pSceneIndex->scenes();
+    int count = m_scenesList->count();
+
+    // cuts are found in time order, only new ones are appended
+    bool bAppend = count <= int(scenes.size());
+    if (bAppend && count > 0)
+        bAppend = m_scenesList->item(count - 1)->data(Qt::UserRole).toDouble() == scenes[count - 1].time;
+    if (!bAppend)
+    {
+        m_scenesList->clear();
+        count = 0;
+    }
+
+    for (int i = count; i < int(scenes.size()); ++i)
+    {
+        const auto& cut = scenes[i];
+        int64_t hours = 0, mins = 0, secs = 0;
+        PlayControlWnd::get_play_time_params(int64_t(cut.time), hours, mins, secs);
+
+        auto pItem = new QListWidgetItem(QIcon(QPixmap::fromImage(cut.thumbnail)),
+                                         PlayControlWnd::get_play_time(hours, mins, secs), m_scenesList);
+        pItem->setData(Qt::UserRole, cut.time);
+    }
+
+    QString title = QString("Scenes (%1)").arg(scenes.size());
+    if (!m_pSceneIndex->is_complete())
+        title += QString(", indexing %1%").arg(int(m_pSceneIndex->progress() * 100));
+    m_scenesDock->setWindowTitle(title);
+}
+
+void MainWindow::scene_item_clicked(QListWidgetItem* item)
+{
+    double pos = 0;
+    if (!item || !get_play_pos(pos))
+        return;
+
+    auto time = item->data(Qt::UserRole).toDouble();
+    video_seek(time, time - pos);
+}
+
+bool MainWindow::get_play_pos(double& pos) const
+{
+    if (!m_pVideoState)
+        return false;
+
+    auto pState = m_pVideoState->get_state();
+    if (!pState)
+        return false;
+
+    pos = get_master_clock(pState);
+    if (isnan(pos))
+        pos = (double)pState->seek_pos / AV_TIME_BASE;
+    return true;
+}
+
+bool MainWindow::seek_scene(bool bNext)
+{
+    double pos = 0;
+    if (!m_pSceneIndex || !get_play_pos(pos))
+        return false;
+
+    double time = 0;
+    bool ret = bNext ? m_pSceneIndex->next_scene(pos, time) : m_pSceneIndex->previous_scene(pos, time);
+    if (ret)
+        video_seek(time, time - pos);
+    return ret;
+}
+
+void MainWindow::update_markers()
+{
+    auto pPlayControl = get_play_control();
+    if (!pPlayControl)
+        return;
+
+    // the progress bar runs over the total time in stream seconds
+    std::vector<SliderMark> marks;
+    double total = pPlayControl->get_total_time();
+    if (m_pSceneIndex && total > 0)
+    {
+        for (const auto& marker : m_pSceneIndex->markers())
+        {
+            QColor color(255, 190, 60); // break
+            if (marker.type == MarkerType::Intro)
+                color = QColor(80, 200, 120);
+            else if (marker.type == MarkerType::Credits)
+                color = QColor(90, 150, 255);
+
+            double start = std::clamp(marker.start / total, 0.0, 1.0);
+            double end = std::clamp(marker.end / total, 0.0, 1.0);
+            marks.push_back({start, end, color});
+        }
+    }
+    pPlayControl->set_progress_marks(marks);
+}
+
+bool MainWindow::skip_marker()
+{
+    double pos = 0;
+    if (!m_pSceneIndex || !get_play_pos(pos))
+        return false;
+
+    MediaMarker marker;
+    if (!m_pSceneIndex->marker_at(pos, marker))
+        return false;
+
+    // credits end with the file, which can't be seeked to
+    double time = (marker.type == MarkerType::Credits) ? marker.end - 1.0 : marker.end;
+    video_seek(time, time - pos);
+    return true;
+}
+
+void MainWindow::show_marker_hint(double pos)
+{
+    MediaMarker marker;
+    if (!m_pSceneIndex || !m_pSceneIndex->marker_at(pos, marker) || marker.start == m_hintedMarker)
+        return;
+
+    // once per marker, stats may overwrite it
+    m_hintedMarker = marker.start;
+    statusBar()->showMessage(QString("%1, press S to skip").arg(marker_name(marker.type)), 5000);
+}
+
+void MainWindow::update_video_filters()
+{
+    const std::pair<QAction*, VideoFilter> filters[] = {
+        {ui->actionFilter_Crop, VideoFilter::Crop},
+        {ui->actionFilter_HalfSize, VideoFilter::HalfSize},
+        {ui->actionFilter_Rotate, VideoFilter::Rotate},
+        {ui->actionFilter_Denoise, VideoFilter::Denoise},
+        {ui->actionFilter_Equalizer, VideoFilter::Equalizer},
+        {ui->actionFilter_Sharpen, VideoFilter::Sharpen},
+    };
+
+    std::vector<VideoFilter> selected;
+    for (const auto& [pAction, filter] : filters)
+    {
+        if (pAction->isChecked())
+            selected.push_back(filter);
+    }
+
+    // the decode thread rebuilds its graph only if the description changed
+    m_videoFilters = video_filters_description(selected);
+    auto deinterlace = get_deinterlace_mode();
+    ui->actionFilter_FieldRate->setEnabled(deinterlace != DeinterlaceMode::Off);
+    if (m_pVideoState)
+    {
+        if (auto pState = m_pVideoState->get_state())
+        {
+            set_video_filters(pState, m_videoFilters.isEmpty() ? nullptr : m_videoFilters.toUtf8().constData());
+            set_video_deinterlace(pState, int(deinterlace));
+        }
+    }
+
+    // frames in between up to the refresh rate of the screen
+    bool bInterpolate = ui->actionFilter_Interpolate->isChecked();
+    auto denoise = get_denoise_strength();
+    if (m_pDecodeVideoThread)
+    {
+        m_pDecodeVideoThread->set_interpolation(bInterpolate ? std::clamp(qRound(screen()->refreshRate()), 30, 240) : 0);
+        m_pDecodeVideoThread->set_denoise(denoise);
+    }
+
+    bool bStats = !m_videoFilters.isEmpty() || deinterlace != DeinterlaceMode::Off || bInterpolate ||
+                  denoise != DenoiseStrength::Off;
+    if (bStats && !m_statsTimer.isActive())
+        m_statsTimer.start();
 }
 
 void MainWindow::create_recentfiles_menu()
@@ -576,6 +1314,30 @@ void MainWindow::keyPressEvent(QKeyEvent* event)
             on_actionKeyboard_Usage_triggered();
             break;
 
+        case Qt::Key_Z: // reset video zoom
+            on_actionReset_Zoom_triggered();
+            break;
+
+        case Qt::Key_PageDown: // next scene
+            on_actionNext_Scene_triggered();
+            break;
+
+        case Qt::Key_PageUp: // previous scene
+            on_actionPrevious_Scene_triggered();
+            break;
+
+        case Qt::Key_S: // skip intro, break or credits
+            on_actionSkip_Marker_triggered();
+            break;
+
+        case Qt::Key_BracketLeft: // compare wipe to the left
+            adjust_compare_wipe(-0.05);
+            break;
+
+        case Qt::Key_BracketRight: // compare wipe to the right
+            adjust_compare_wipe(0.05);
+            break;
+
         default:
             qDebug("Not handled key event, key:%s(%d) pressed!\n", qUtf8Printable(event->text()), event->key());
             QWidget::keyPressEvent(event);
@@ -585,6 +1347,13 @@ void MainWindow::keyPressEvent(QKeyEvent* event)
 
 bool MainWindow::eventFilter(QObject* obj, QEvent* event)
 {
+    // docks shown or hidden change the central widget, not the window
+    if (obj == centralWidget() && event->type() == QEvent::Resize)
+    {
+        update_video_label();
+        update_play_control();
+    }
+
     if (event->type() == QEvent::MouseMove)
     {
         auto mouseEvent = static_cast<QMouseEvent*>(event);
@@ -772,12 +1541,148 @@ void MainWindow::on_actionLoop_Play_triggered()
         pState->loop = int(ui->actionLoop_Play->isChecked());
 }
 
+void MainWindow::on_actionReset_Zoom_triggered()
+{
+    if (auto pLabel = get_video_label())
+        pLabel->reset_zoom();
+}
+
+void MainWindow::on_actionAuto_Crop_triggered()
+{
+    if (auto pThread = get_video_play_thread())
+        pThread->set_auto_crop(ui->actionAuto_Crop->isChecked());
+}
+
+void MainWindow::on_actionVideo_Sink_triggered()
+{
+    update_sink_output();
+}
+
+void MainWindow::on_actionUpscale_triggered()
+{
+    update_sink_output();
+}
+
+void MainWindow::on_actionScene_Index_triggered()
+{
+    if (ui->actionScene_Index->isChecked() && is_playing())
+        start_scene_index();
+    else
+        stop_scene_index();
+}
+
+void MainWindow::on_actionNext_Scene_triggered()
+{
+    seek_scene(true);
+}
+
+void MainWindow::on_actionPrevious_Scene_triggered()
+{
+    seek_scene(false);
+}
+
+void MainWindow::on_actionSkip_Marker_triggered()
+{
+    skip_marker();
+}
+
+void MainWindow::on_actionCompare_Open_triggered()
+{
+    if (!get_video_play_thread() || !playing_has_video())
+    {
+        show_msg_dlg("Play the reference video first, it is A of the comparison.", "A/B Compare");
+        return;
+    }
+
+    QFileDialog dialog(this, "Open B File", QFileInfo(m_videoFile).absolutePath());
+    dialog.setFileMode(QFileDialog::ExistingFile);
+    dialog.setNameFilters({"Videos (*.mp4 *.avi *.mkv *.mov *.ts)", "Any files (*)"});
+    dialog.setViewMode(QFileDialog::List);
+    if (!dialog.exec())
+        return;
+
+    // playing may have stopped meanwhile
+    auto pThread = get_video_play_thread();
+    if (!pThread)
+        return;
+
+    auto file = dialog.selectedFiles()[0];
+    if (!pThread->start_compare(file))
+    {
+        show_msg_dlg(QString("Failed to open %1 for comparison.").arg(toNativePath(file)), "A/B Compare");
+        return;
+    }
+    update_compare_view();
+
+    double duration = 0;
+    if (auto pState = m_pVideoState->get_state())
+    {
+        if (pState->ic && pState->ic->duration > 0)
+            duration = pState->ic->duration / double(AV_TIME_BASE);
+    }
+    m_compareGraph->clear();
+    m_compareGraph->set_duration(duration);
+    m_compareDock->setWindowTitle(
+        QString("Compare: %1 (A) - %2 (B)").arg(QFileInfo(m_videoFile).fileName()).arg(QFileInfo(file).fileName()));
+    m_compareDock->show();
+
+    // quality of each second in the status bar
+    if (!m_statsTimer.isActive())
+        m_statsTimer.start();
+}
+
+void MainWindow::on_actionCompare_Stop_triggered()
+{
+    stop_compare();
+}
+
 void MainWindow::on_actionMedia_Info_triggered()
 {
     if (is_playing())
         about_media_info();
 }
 
+void MainWindow::on_actionTest_CV_triggered()
+{
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    auto str = cv_proxy_quality_benchmark();
+    QApplication::restoreOverrideCursor();
+
+    show_msg_dlg(str, "CV Benchmark");
+}
+
+void MainWindow::on_actionLoad_LUT_triggered()
+{
+    auto file = QFileDialog::getOpenFileName(this, "Load 3D LUT", QString(), "Cube LUT (*.cube);;Any files (*)");
+    if (file.isEmpty())
+        return;
+
+    if (!load_lut(file))
+    {
+        show_msg_dlg(QString("Failed to load the 3D LUT, file: %1").arg(toNativePath(file)));
+        return;
+    }
+
+    // a newly loaded lut is turned on
+    if (ui->actionLut3D->isChecked())
+        update_cv_effects();
+    else
+        ui->actionLut3D->setChecked(true);
+}
+
+bool MainWindow::load_lut(const QString& file)
+{
+    auto lut = std::make_shared<Lut3D>();
+    if (!lut->load_cube(file))
+        return false;
+
+    m_lut3d = lut;
+    m_lutFile = file;
+    ui->actionLut3D->setEnabled(true);
+    ui->actionLut3D->setText(QString("3D LUT: %1 (%2)").arg(lut->title()).arg(lut->size()));
+    return true;
+}
+
 void MainWindow::on_actionKeyboard_Usage_triggered()
 {
     QString str;
@@ -788,11 +1693,17 @@ void MainWindow::on_actionKeyboard_Usage_triggered()
     str += "L" + indent + "Show playlist\n";
     str += "M" + indent + "Mute/Unmute\n";
     str += "O" + indent + "Keep video original size\n";
+    str += "S" + indent + "Skip intro/break/credits\n";
+    str += "Z" + indent + "Reset video zoom\n";
+    str += "Wheel" + indent + "Zoom video, drag to move\n";
     str += "Space" + indent + "Pause/Play\n";
     str += "Up" + indent + "Volume up\n";
     str += "Down" + indent + "Volume down\n";
     str += "Left" + indent + "Play back\n";
     str += "Right" + indent + "Play forward\n";
+    str += "PgUp" + indent + "Previous scene\n";
+    str += "PgDn" + indent + "Next scene\n";
+    str += "[ ]" + indent + "Move compare wipe\n";
     str += "<" + indent + "Speed down\n";
     str += ">" + indent + "Speed up\n";
 
@@ -1070,7 +1981,12 @@ void MainWindow::update_play_time()
     if (auto pPlayControl = get_play_control())
     {
         if (auto pState = m_pVideoState->get_state())
+        {
             pPlayControl->update_play_time(pState->audio_clock);
+            show_marker_hint(pState->audio_clock);
+            if (m_compareDock->isVisible())
+                m_compareGraph->set_position(pState->audio_clock - playing_start_time());
+        }
     }
 }
 
@@ -1546,6 +2462,9 @@ void MainWindow::all_thread_start()
         m_pAudioPlayThread->start();
         qDebug("++++++++++ Audio play thread started.");
     }
+
+    if (ui->actionScene_Index->isChecked())
+        start_scene_index();
 }
 
 void MainWindow::stop_play()
@@ -1561,9 +2480,12 @@ void MainWindow::stop_play()
        * at VideoStateData::stream_close
      */
 
+    stop_scene_index();
+    stop_compare();
     delete_video_state();
     set_paly_control_wnd(false);
     clear_subtitle_str();
+    m_effectStage->clear();
 }
 
 void MainWindow::pause_play()
@@ -1691,6 +2613,8 @@ bool MainWindow::create_decode_video_thread()
                 return false;
             }
 
+            update_video_filters(); // before the first frame is decoded
+
             ret = decoder_start(&pState->viddec, m_pDecodeVideoThread.get(), "video_decoder_thread");
             if (ret < 0)
             {
@@ -1781,6 +2705,7 @@ bool MainWindow::create_video_play_thread() // video play thread
 
             connect(m_pVideoPlayThread.get(), &VideoPlayThread::finished, this, &MainWindow::video_play_stopped);
             connect(m_pVideoPlayThread.get(), &VideoPlayThread::frame_ready, this, &MainWindow::image_ready);
+            connect(m_pVideoPlayThread.get(), &VideoPlayThread::video_frame_ready, this, &MainWindow::video_frame_ready);
             connect(m_pVideoPlayThread.get(), &VideoPlayThread::subtitle_ready, this, &MainWindow::subtitle_ready);
             connect(this, &MainWindow::stop_video_play_thread, m_pVideoPlayThread.get(), &VideoPlayThread::stop_thread);
 
@@ -1791,6 +2716,16 @@ bool MainWindow::create_video_play_thread() // video play thread
             {
                 qWarning("init_resample_param failed.");
             }
+
+            update_sink_output();
+            update_video_rotation();
+            update_tone_map();
+            m_pVideoPlayThread->set_auto_crop(ui->actionAuto_Crop->isChecked());
+            m_pVideoPlayThread->set_scopes(m_scopesDock->isVisible());
+            connect(m_pVideoPlayThread.get(), &VideoPlayThread::scopes_ready, m_scopesWidget, &VideoScopesWidget::set_scopes);
+
+            if (auto pLabel = get_video_label())
+                pLabel->reset_zoom(); // sends the view to the new thread
         }
     }
     return ret;
@@ -1887,187 +2822,66 @@ bool MainWindow::start_play_thread()
 
 void MainWindow::image_ready(const QImage& img)
 {
-    QImage image = img.copy();
+#if PRINT_VIDEO_PAINT_TIME
+    QElapsedTimer timer;
+    timer.start();
+#endif
 
-    if (!m_subtitle.isEmpty())
-    {
-        int height = 90;
-        // QPen pen = QPen(Qt::white);
-        QFont font = QFont("Times", 15, QFont::Bold);
-        QRect rt(0, image.height() - height, image.width(), height);
+    m_videoFrames++;
 
-        draw_img_text(image, m_subtitle, rt, QPen(Qt::black), font); // black shadow
-        rt.adjust(-1, -1, -1, -1);
-        draw_img_text(image, m_subtitle, rt, QPen(Qt::white), font);
+    // cv effects and their subtitle overlay run in the effect stage
+    if (cv_effects_enabled())
+    {
+        m_effectStage->submit(img);
+        return;
     }
 
-    // QElapsedTimer timer;
-    // timer.start();
-    image_cv(image); // cv handling
-    // qDebug("------------image_cv---------------------%d milliseconds",
-    // timer.elapsed());
+    QImage image = img; // detached only if subtitle writes to it
+    if (!m_subtitle.isEmpty())
+        draw_subtitle(image, m_subtitle);
 
     update_image(image);
+
+#if PRINT_VIDEO_PAINT_TIME
+    qDebug("image_ready gui thread: %.3f ms", timer.nsecsElapsed() / 1000000.0);
+#endif
 }
 
-void MainWindow::image_cv_geo(QImage& image)
+void MainWindow::video_frame_ready(const QVideoFrame& frame)
 {
-    if (ui->actionGrayscale->isChecked())
-    {
-        grey_image(image);
-        // invert_image(image);
-        // mirro_image(image);
-        // swap_image(image);
-        // gamma_image(image); //too slow
-        // blur_img(image);
-        // QColor c = QColor(40, 40, 40, 255);
-        // dropshadow_img(image, 100, 0, 10, c, 200);
-        // colorize_img(image);
-        // opacity_img(image);
-    }
-
-    if (ui->actionMirro->isChecked())
-    {
-        // mirro_image(image);
-        cv::Mat matImg;
-        qimage_to_mat(image, matImg);
-        mat_to_qimage(flip_img(matImg), image); // 8
-    }
-
-    if (ui->actionTransform->isChecked())
-    {
-        double pi = 3.14;
-
-        double a = pi / 180 * 45.0;
-        double sina = sin(a);
-        double cosa = cos(a);
-
-        QTransform translationMatrix(1, 0, 0, 1, 50.0, 50.0);
-        QTransform rotationMatrix(cosa, sina, -sina, cosa, 0, 0);
-        QTransform scalingMatrix(0.5, 0, 0, 1.0, 0, 0);
-
-        QTransform matrix;
-        matrix = scalingMatrix * rotationMatrix * translationMatrix;
-
-        QTransform trans(rotationMatrix);
-        // QTransform trans(matrix);
-        transform_image(image, trans);
-    }
+    if (auto pLabel = get_video_label())
+        pLabel->set_video_frame(frame);
 }
 
-void MainWindow::image_cv(QImage& image)
+bool MainWindow::cv_effects_enabled() const
 {
-    cv::Mat matImg;
-    qimage_to_mat(image, matImg);
-
-    if (ui->actionTest_CV->isChecked())
-    {
-        // mat_to_qimage(grey_img(matImg), image); //23 millsecs
-        // mat_to_qimage(rotate_img(matImg), image);	//10
-        // mat_to_qimage(repeat_img(matImg, 3, 3), image); //48
-        // mat_to_qimage(histgram_img(matImg), image);	//20
-        // mat_to_qimage(equalized_hist_img(matImg), image);	//30
-        // mat_to_qimage(threshold_img(matImg), image);	//30
-        // mat_to_qimage(thresholdAdaptive_img(matImg), image);	//78
-        // mat_to_qimage(reverse_img(matImg), image);	//6
-
-        /*
-        int divideWith = 20;
-        uchar table[256];
-        gen_color_table(table, sizeof(table), divideWith);
-        Mat table_mat = cv::Mat(1, 256, CV_8UC1, table);
-        Mat res = scane_img_LUT(matImg, table_mat);
-        mat_to_qimage(res, image);	//10
-        */
-
-        // mat_to_qimage(lighter_img(matImg, 1.2), image);	//20
-        // mat_to_qimage(exposure_img(matImg), image);	//15
-        // mat_to_qimage(gamma_img(matImg, 1.2), image);	//10
-        // mat_to_qimage(contrast_bright_img(matImg, 1.2, 30), image);	//90
-        // mat_to_qimage(canny_img(matImg), image);	//440
+    return (m_cvEffects && !m_cvEffects->empty()) || ui->actionFace_Highlight->isChecked();
+}
 
-        // mat_to_qimage(blur_img(matImg), image);	//120
-        // mat_to_qimage(sobel_img_XY(matImg), image);	//240
-        // mat_to_qimage(laplacian_img(matImg), image);	//80
-        // mat_to_qimage(scharr_img_XY(matImg), image);	//350
-        // mat_to_qimage(prewitt_img_XY(matImg), image);	//270
-    }
+void MainWindow::update_video_rotation()
+{
+    // 90 degrees clockwise on top of the display matrix of the stream
+    if (auto pThread = get_video_play_thread())
+        pThread->set_manual_rotation(ui->actionRotate->isChecked() ? 90 : 0);
+}
 
-    if (ui->actionRotate->isChecked())
-    {
-        mat_to_qimage(rotate_img(matImg), image);
-    }
-    else if (ui->actionRepeat->isChecked())
-    {
-        mat_to_qimage(repeat_img(matImg, 3, 3), image);
-    }
-    else if (ui->actionEqualizeHist->isChecked())
-    {
-        equalized_hist_img(matImg);
-        mat_to_qimage(matImg, image);
-    }
-    else if (ui->actionThreshold->isChecked())
-    {
-        mat_to_qimage(threshold_img(matImg), image);
-    }
-    else if (ui->actionThreshold_Adaptive->isChecked())
-    {
-        mat_to_qimage(thresholdAdaptive_img(matImg), image);
-    }
-    else if (ui->actionReverse->isChecked())
-    {
-        reverse_img(matImg);
-        mat_to_qimage(matImg, image);
-    }
-    else if (ui->actionColorReduce->isChecked())
-    {
-        int divideWith = 20;
-        uchar table[256];
-        gen_color_table(table, sizeof(table), divideWith);
-        Mat table_mat = cv::Mat(1, 256, CV_8UC1, table);
-        scane_img_LUT(matImg, table_mat);
-        mat_to_qimage(matImg, image); // 10
-    }
-    else if (ui->actionGamma->isChecked())
-    {
-        gamma_img(matImg, 1.2f);
-        mat_to_qimage(matImg, image);
-    }
-    else if (ui->actionContrastBright->isChecked())
-    {
-        contrast_bright_img(matImg, 1.2, 30);
-        mat_to_qimage(matImg, image);
-    }
-    else if (ui->actionCanny->isChecked())
-    {
-        mat_to_qimage(canny_img(matImg), image);
+void MainWindow::update_sink_output()
+{
+    // subtitles and cv effects are drawn on rgb images, use the rgb path then
+    bool bSink = ui->actionVideo_Sink->isChecked() && !cv_effects_enabled() && m_subtitle.isEmpty();
 
-        /*const char* haar = "E:\\projects\\c++\\myProject\\vc\\video_player\\VideoPlayer_CMake\\src\\opencv\\build\\data\\haarcascades\\haarcascade_frontalface_alt.xml";
-        face_detect(matImg, haar);
-        mat_to_qimage(matImg, image);*/
-    }
-    else if (ui->actionBlur->isChecked())
-    {
-        mat_to_qimage(blur_img(matImg), image);
-    }
-    else if (ui->actionSobel->isChecked())
+    if (auto pThread = get_video_play_thread())
     {
-        mat_to_qimage(sobel_img_XY(matImg), image);
-    }
-    else if (ui->actionLaplacian->isChecked())
-    {
-        mat_to_qimage(laplacian_img(matImg), image);
-    }
-    else if (ui->actionScharr->isChecked())
-    {
-        mat_to_qimage(scharr_img_XY(matImg), image);
-    }
-    else if (ui->actionPrewitt->isChecked())
-    {
-        mat_to_qimage(prewitt_img_XY(matImg), image);
+        pThread->set_sink_output(bSink);
+        // gray effect chains start from the luma plane instead of rgb
+        pThread->set_luma_output(cv_effects_enabled() && m_cvEffects->is_gray_output());
+        // effects would run on display sized images
+        pThread->set_upscale(ui->actionUpscale->isChecked() && !cv_effects_enabled());
     }
 
-    image_cv_geo(image);
+    // the cost is shown while small frames are upscaled
+    if (ui->actionUpscale->isChecked() && !m_statsTimer.isActive())
+        m_statsTimer.start();
 }
 
 void MainWindow::subtitle_ready(const QString& text)
@@ -2077,7 +2891,11 @@ void MainWindow::subtitle_ready(const QString& text)
 
 void MainWindow::set_subtitle(const QString& str)
 {
+    bool bChanged = (m_subtitle.isEmpty() != str.isEmpty());
     m_subtitle = str;
+    m_effectStage->set_subtitle(str);
+    if (bChanged)
+        update_sink_output();
     qDebug() << "subtitle received:" << m_subtitle;
 }
 
@@ -2088,9 +2906,8 @@ void MainWindow::clear_subtitle_str()
 
 void MainWindow::update_image(const QImage& img)
 {
-    auto pLabel = get_video_label();
-    if (!img.isNull() && pLabel)
-        pLabel->setPixmap(QPixmap::fromImage(img));
+    if (auto pLabel = get_video_label())
+        pLabel->set_image(img);
 }
 
 void MainWindow::read_packet_stopped()
@@ -2183,6 +3000,27 @@ void MainWindow::save_settings()
     m_settings.set_general("openDXVA2", int(res));
     res = ui->actionLoop_Play->isChecked();
     m_settings.set_general("loopPlay", int(res));
+    res = ui->actionVideo_Sink->isChecked();
+    m_settings.set_general("videoSink", int(res));
+    res = ui->actionUpscale->isChecked();
+    m_settings.set_general("edgeUpscale", int(res));
+    res = ui->actionAuto_Crop->isChecked();
+    m_settings.set_general("autoCrop", int(res));
+    m_settings.set_general("effectQuality", int(get_effect_quality()));
+    m_settings.set_general("lutFile", m_lutFile);
+    m_settings.set_general("toneMapCurve", int(get_tone_map_curve()));
+    m_settings.set_general("deinterlace", int(get_deinterlace_mode()));
+    res = ui->actionFilter_Interpolate->isChecked();
+    m_settings.set_general("frameInterpolation", int(res));
+    m_settings.set_general("temporalDenoise", int(get_denoise_strength()));
+    res = m_scopesDock->toggleViewAction()->isChecked(); // the window is closed already
+    m_settings.set_general("showScopes", int(res));
+    res = ui->actionScene_Index->isChecked();
+    m_settings.set_general("sceneIndex", int(res));
+    res = m_scenesDock->toggleViewAction()->isChecked();
+    m_settings.set_general("showScenes", int(res));
+    res = ui->actionCompare_Split->isChecked();
+    m_settings.set_general("compareSplit", int(res));
 
     m_settings.set_general("style", get_selected_style());
 
@@ -2224,6 +3062,94 @@ void MainWindow::read_settings()
         ui->actionLoop_Play->setChecked(!!value);
     }
 
+    values = m_settings.get_general("videoSink");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        ui->actionVideo_Sink->setChecked(!!value);
+    }
+
+    values = m_settings.get_general("edgeUpscale");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        ui->actionUpscale->setChecked(!!value);
+    }
+
+    values = m_settings.get_general("autoCrop");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        ui->actionAuto_Crop->setChecked(!!value);
+    }
+
+    values = m_settings.get_general("effectQuality");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        set_effect_quality(EffectQuality(value));
+    }
+
+    values = m_settings.get_general("toneMapCurve");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        set_tone_map_curve(ToneMapCurve(value));
+    }
+
+    values = m_settings.get_general("deinterlace");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        set_deinterlace_mode(DeinterlaceMode(value));
+    }
+
+    values = m_settings.get_general("frameInterpolation");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        ui->actionFilter_Interpolate->setChecked(!!value);
+    }
+
+    values = m_settings.get_general("temporalDenoise");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        set_denoise_strength(DenoiseStrength(value));
+    }
+
+    values = m_settings.get_general("lutFile");
+    if (values.isValid() && !values.toString().isEmpty())
+        load_lut(values.toString()); // loaded but off, like the other effects
+
+    values = m_settings.get_general("showScopes");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        m_scopesDock->setVisible(!!value);
+    }
+
+    values = m_settings.get_general("sceneIndex");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        ui->actionScene_Index->setChecked(!!value);
+    }
+
+    values = m_settings.get_general("showScenes");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        m_scenesDock->setVisible(!!value);
+    }
+
+    values = m_settings.get_general("compareSplit");
+    if (values.isValid())
+    {
+        value = values.toInt();
+        (value ? ui->actionCompare_Split : ui->actionCompare_Wipe)->setChecked(true);
+    }
+
     values = m_settings.get_general("style");
     if (values.isValid())
     {
@@ -2317,6 +3243,8 @@ void MainWindow::enable_v_menus(bool enable)
     ui->actionAspect_Ratio->setEnabled(enable);
     ui->actionOriginalSize->setEnabled(enable);
     ui->actionHardware_decode->setEnabled(enable);
+    ui->actionCompare_Open->setEnabled(enable);
+    ui->actionCompare_Stop->setEnabled(enable);
 
     for (auto& pAction : ui->menuCV->actions())
     {
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <QActionGroup>
+#include <QDockWidget>
 #include <QElapsedTimer>
 #include <QFileDialog>
+#include <QListWidget>
 #include <QMainWindow>
 #include <QMessageBox>
 #include <QMimeData>
@@ -17,17 +19,23 @@
 #include "audio_decode_thread.h"
 #include "audio_effect_gl.h"
 #include "audio_play_thread.h"
+#include "compare_graph_widget.h"
+#include "cv_effect_chain.h"
 #include "network_url_dlg.h"
 #include "play_control_window.h"
 #include "player_skin.h"
 #include "playlist_window.h"
 #include "read_thread.h"
+#include "scene_index_thread.h"
 #include "start_play_thread.h"
 #include "stopplay_waiting_thread.h"
 #include "subtitle_decode_thread.h"
 #include "video_decode_thread.h"
+#include "video_effect_stage.h"
+#include "video_filters.h"
 #include "video_label.h"
 #include "video_play_thread.h"
+#include "video_scopes_widget.h"
 #include "video_state.h"
 #include "youtube_url_thread.h"
 
@@ -73,6 +81,10 @@ public:
 
 public slots:
     void image_ready(const QImage&);
+    void video_frame_ready(const QVideoFrame&);
+    void video_view_changed(const QRectF& roi, const QSize& displaySize);
+    void effect_frame_ready(const QImage&);
+    void update_effect_stats();
     void subtitle_ready(const QString&);
     void audio_data(const AudioData& data);
     void open_recentFile();
@@ -118,7 +130,19 @@ private slots:
     void on_actionSystemStyle();
     void on_actionCustomStyle();
     void on_actionLoop_Play_triggered();
+    void on_actionVideo_Sink_triggered();
+    void on_actionUpscale_triggered();
+    void on_actionScene_Index_triggered();
+    void on_actionNext_Scene_triggered();
+    void on_actionPrevious_Scene_triggered();
+    void on_actionSkip_Marker_triggered();
+    void on_actionCompare_Open_triggered();
+    void on_actionCompare_Stop_triggered();
+    void on_actionReset_Zoom_triggered();
+    void on_actionAuto_Crop_triggered();
     void on_actionMedia_Info_triggered();
+    void on_actionTest_CV_triggered();
+    void on_actionLoad_LUT_triggered();
     void on_actionKeyboard_Usage_triggered();
     void on_actionPlayList_triggered();
     void on_actionOpenNetworkUrl_triggered();
@@ -132,8 +156,22 @@ private:
     void update_image(const QImage&);
     void print_decodeContext(const AVCodecContext* pVideo, bool bVideo = true) const;
     void about_media_info();
-    void image_cv(QImage&);
-    void image_cv_geo(QImage&);
+    bool cv_effects_enabled() const;
+    void update_cv_effects();
+    bool load_lut(const QString& file);
+    EffectQuality get_effect_quality() const;
+    void set_effect_quality(EffectQuality quality);
+    void update_effect_quality();
+    ToneMapCurve get_tone_map_curve() const;
+    void set_tone_map_curve(ToneMapCurve curve);
+    void update_tone_map();
+    void update_video_filters();
+    DeinterlaceMode get_deinterlace_mode() const;
+    void set_deinterlace_mode(DeinterlaceMode mode);
+    DenoiseStrength get_denoise_strength() const;
+    void set_denoise_strength(DenoiseStrength strength);
+    void update_sink_output();
+    void update_video_rotation();
     void resize_window(int width = 800, int height = 480);
     void resize_window(const QSize& size);
     void center_window(QRect screen_rec);
@@ -175,8 +213,29 @@ private:
     void clear_subtitle_str();
     void set_subtitle(const QString& str);
     void create_cv_action_group();
+    void create_filters_menu();
+    void create_tone_map_menu();
+    void create_scopes_dock();
+    void scopes_visibility_changed(bool bVisible);
+    void create_scenes_dock();
+    void start_scene_index();
+    void stop_scene_index();
+    void update_scenes();
+    void scene_item_clicked(QListWidgetItem* item);
+    bool get_play_pos(double& pos) const;
+    bool seek_scene(bool bNext);
+    void update_markers();
+    bool skip_marker();
+    void show_marker_hint(double pos);
+    void create_compare_dock();
+    void update_compare_view();
+    void stop_compare();
+    void adjust_compare_wipe(double delta);
+    void compare_graph_seek(double pos);
+    double playing_start_time() const; // seconds, first timestamp of the file
     void play_speed_adjust(bool up = true);
     void create_video_label();
+    void create_video_effect_stage();
     void update_video_label();
     void create_audio_effect();
     void start_send_data(bool bSend = true);
@@ -244,14 +303,24 @@ private:
     std::unique_ptr<StartPlayThread> m_pBeforePlayThread;          // time-consuming operations before play
     std::unique_ptr<YoutubeUrlThread> m_pYoutubeUrlThread;         // youtube url parsing
     std::unique_ptr<StopWaitingThread> m_pStopplayWaitingThread;   // waiting stop play
+    std::unique_ptr<SceneIndexThread> m_pSceneIndex;               // scene cuts of the playing file
 
     QString m_videoFile;
     QTimer m_timer; // mouse moving checking timer
+    QTimer m_statsTimer; // effect stage fps in status bar
+    int m_videoFrames{0}; // frames from video play thread since last stats
     AppSettings m_settings;
     PlayerSkin m_skin;
     QString m_subtitle;
 
     std::unique_ptr<VideoLabel> m_video_label;
+    std::unique_ptr<QDockWidget> m_scopesDock;
+    VideoScopesWidget* m_scopesWidget{nullptr}; // owned by m_scopesDock
+    std::unique_ptr<QDockWidget> m_scenesDock;
+    QListWidget* m_scenesList{nullptr}; // owned by m_scenesDock
+    double m_hintedMarker{-1};          // start of the marker the skip hint was shown for
+    std::unique_ptr<QDockWidget> m_compareDock;
+    CompareGraphWidget* m_compareGraph{nullptr}; // owned by m_compareDock
     std::unique_ptr<PlayControlWnd> m_play_control_wnd;
     std::unique_ptr<AudioEffectGL> m_audio_effect_wnd;
     std::unique_ptr<PlayListWnd> m_playListWnd;
@@ -262,6 +331,16 @@ private:
     std::unique_ptr<QActionGroup> m_styleActsGroup; // style menus group
     std::unique_ptr<QAction> m_styleActions[MaxSkinStlyes];
     std::unique_ptr<QActionGroup> m_CvActsGroup; // cv menus group
+    std::unique_ptr<QActionGroup> m_QualityActsGroup; // effect quality menus group
+    std::unique_ptr<QActionGroup> m_ToneMapActsGroup; // hdr tone mapping menus group
+    std::unique_ptr<QActionGroup> m_DenoiseActsGroup; // temporal denoise menus group
+    std::unique_ptr<QActionGroup> m_CompareActsGroup; // a/b compare view menus group
+    bool m_bAutoStats{false}; // hdr or deinterlace cost is in the status bar
+    std::shared_ptr<CvEffectChain> m_cvEffects;  // built from the cv menus
+    std::shared_ptr<const Lut3D> m_lut3d;        // colour grading of the 3D LUT menu
+    QString m_lutFile;
+    std::unique_ptr<VideoEffectStage> m_effectStage;
+    QString m_videoFilters; // filter graph of the filters menu, run in the video decode thread
     std::unique_ptr<QActionGroup> m_AVisualTypeActsGroup;
     std::unique_ptr<QActionGroup> m_AVisualGrapicTypeActsGroup;
     std::unique_ptr<QAction> m_savedPlaylists[MaxPlaylist];
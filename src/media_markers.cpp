@@ -0,0 +1,218 @@
+// ***********************************************************/
+// media_markers.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Black frame and silence runs found by the background file
+// analysis, and the intro, break and credits markers guessed
+// from them for skipping. Black is judged on the mean and
+// variation of decimated luma, silence on the rms of pcm.
+// ***********************************************************/
+
+#include "media_markers.h"
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+
+extern "C"
+{
+#include <libavutil/samplefmt.h>
+}
+
+#define BLACK_MEAN_LIMIT 32.0     // limited range black is 16
+#define BLACK_STDDEV_LIMIT 6.0    // dark scenes still have detail
+#define SILENCE_LIMIT_DB -50.0    // rms of a silent frame, dBFS
+#define SILENCE_MIN_LENGTH 0.3    // seconds
+#define BREAK_OVERLAP 0.5         // seconds black and silence may be apart
+#define BREAK_BLACK_LENGTH 1.0    // black alone is a break, files without audio
+#define INTRO_MAX_LENGTH 600.0    // seconds of the file searched for the intro
+#define INTRO_MAX_RATIO 0.25
+#define INTRO_MIN_LENGTH 10.0     // shorter ones aren't worth a skip
+#define CREDITS_MAX_LENGTH 600.0  // seconds at the end searched for the credits
+#define CREDITS_MAX_RATIO 0.2
+
+void RunDetector::add(double time, bool bOn)
+{
+    if (bOn && !m_bOn)
+    {
+        m_start = time;
+        m_bOn = true;
+    }
+    else if (!bOn && m_bOn)
+    {
+        finish(time);
+    }
+}
+
+void RunDetector::finish(double time)
+{
+    if (!m_bOn)
+        return;
+
+    // timestamps going back give a negative length and drop the run
+    if (time - m_start >= m_minLength)
+        m_runs.push_back({m_start, time});
+    m_bOn = false;
+}
+
+SilenceDetector::SilenceDetector() : m_runs(SILENCE_MIN_LENGTH)
+{
+}
+
+template <typename T>
+static double sum_squares(const uint8_t* data, int count, double scale, double offset)
+{
+    const T* p = reinterpret_cast<const T*>(data);
+    double sum = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        double v = (double(p[i]) - offset) * scale;
+        sum += v * v;
+    }
+    return sum;
+}
+
+double SilenceDetector::frame_rms(const AVFrame* frame)
+{
+    auto fmt = AVSampleFormat(frame->format);
+    int channels = frame->ch_layout.nb_channels;
+    if (channels <= 0 || frame->nb_samples <= 0)
+        return -1;
+
+    bool bPlanar = av_sample_fmt_is_planar(fmt);
+    int planes = bPlanar ? channels : 1;
+    int count = bPlanar ? frame->nb_samples : frame->nb_samples * channels;
+
+    double sum = 0;
+    for (int i = 0; i < planes; ++i)
+    {
+        const uint8_t* data = frame->extended_data[i];
+        switch (av_get_packed_sample_fmt(fmt))
+        {
+            case AV_SAMPLE_FMT_U8:
+                sum += sum_squares<uint8_t>(data, count, 1.0 / 128, 128);
+                break;
+            case AV_SAMPLE_FMT_S16:
+                sum += sum_squares<int16_t>(data, count, 1.0 / 32768, 0);
+                break;
+            case AV_SAMPLE_FMT_S32:
+                sum += sum_squares<int32_t>(data, count, 1.0 / 2147483648.0, 0);
+                break;
+            case AV_SAMPLE_FMT_FLT:
+                sum += sum_squares<float>(data, count, 1.0, 0);
+                break;
+            case AV_SAMPLE_FMT_DBL:
+                sum += sum_squares<double>(data, count, 1.0, 0);
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    return std::sqrt(sum / (double(count) * planes));
+}
+
+void SilenceDetector::add_frame(const AVFrame* frame, double time)
+{
+    static const double limit = std::pow(10.0, SILENCE_LIMIT_DB / 20);
+
+    double rms = frame_rms(frame);
+    if (rms < 0)
+        return;
+
+    m_runs.add(time, rms < limit);
+    if (frame->sample_rate > 0)
+        m_end = time + double(frame->nb_samples) / frame->sample_rate;
+}
+
+void SilenceDetector::finish()
+{
+    m_runs.finish(m_end);
+}
+
+bool is_black_luma(const cv::Mat& luma)
+{
+    cv::Scalar mean, stddev;
+    cv::meanStdDev(luma, mean, stddev);
+    return mean[0] <= BLACK_MEAN_LIMIT && stddev[0] <= BLACK_STDDEV_LIMIT;
+}
+
+std::vector<MediaMarker> classify_markers(const std::vector<TimeRange>& blacks, const std::vector<TimeRange>& silences,
+                                          bool bAudio, double start, double duration)
+{
+    std::vector<TimeRange> breaks;
+    for (const auto& black : blacks)
+    {
+        if (!bAudio)
+        {
+            if (black.end - black.start >= BREAK_BLACK_LENGTH)
+                breaks.push_back(black);
+            continue;
+        }
+
+        auto it = std::find_if(silences.begin(), silences.end(), [&black](const TimeRange& silence) {
+            return silence.start <= black.end + BREAK_OVERLAP && silence.end >= black.start - BREAK_OVERLAP;
+        });
+        if (it != silences.end())
+            breaks.push_back({std::min(black.start, it->start), black.end}); // the picture is back at the end
+    }
+
+    std::vector<MediaMarker> markers;
+    if (breaks.empty())
+        return markers;
+
+    int intro = -1, credits = -1;
+    if (duration > 0)
+    {
+        const double end = start + duration;
+        const double introLimit = start + std::min(duration * INTRO_MAX_RATIO, INTRO_MAX_LENGTH);
+        const double creditsLimit = end - std::min(duration * CREDITS_MAX_RATIO, CREDITS_MAX_LENGTH);
+
+        for (int i = 0; i < int(breaks.size()); ++i)
+        {
+            if (breaks[i].end <= introLimit)
+                intro = i;
+        }
+        if (intro >= 0 && breaks[intro].end - start < INTRO_MIN_LENGTH)
+            intro = -1;
+
+        for (int i = intro + 1; i < int(breaks.size()); ++i)
+        {
+            if (breaks[i].start >= creditsLimit)
+            {
+                credits = i;
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < int(breaks.size()); ++i)
+    {
+        if (i == intro)
+            markers.push_back({MarkerType::Intro, i > 0 ? breaks[i - 1].end : start, breaks[i].end});
+        else if (i == credits)
+            markers.push_back({MarkerType::Credits, breaks[i].start, start + duration});
+        else if (credits < 0 || i < credits)
+            markers.push_back({MarkerType::Break, breaks[i].start, breaks[i].end});
+    }
+
+#if PRINT_MEDIA_MARKERS
+    for (const auto& marker : markers)
+        qDebug("marker %s: %.2f - %.2f s", marker_name(marker.type), marker.start, marker.end);
+#endif
+    return markers;
+}
+
+const char* marker_name(MarkerType type)
+{
+    switch (type)
+    {
+        case MarkerType::Intro:
+            return "Intro";
+        case MarkerType::Credits:
+            return "Credits";
+        case MarkerType::Break:
+        default:
+            return "Break";
+    }
+}
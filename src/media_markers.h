@@ -0,0 +1,79 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+#define PRINT_MEDIA_MARKERS 0
+
+#define BLACK_MIN_LENGTH 0.2 // seconds, a lone black reference frame is no run
+
+enum class MarkerType : int
+{
+    Intro,
+    Break,  // ad break or chapter break
+    Credits
+};
+
+typedef struct MediaMarker
+{
+    MarkerType type{MarkerType::Break};
+    double start{0}; // stream seconds
+    double end{0};   // playback resumes here when skipped
+} MediaMarker;
+
+typedef struct TimeRange
+{
+    double start{0};
+    double end{0};
+} TimeRange;
+
+// Runs of consecutive samples meeting a condition, samples in time order.
+class RunDetector
+{
+public:
+    explicit RunDetector(double minLength) : m_minLength(minLength) {}
+
+public:
+    void add(double time, bool bOn);
+    void finish(double time); // closes a run still open
+    inline const std::vector<TimeRange>& runs() const { return m_runs; }
+
+private:
+    double m_minLength;
+    double m_start{0};
+    bool m_bOn{false};
+    std::vector<TimeRange> m_runs;
+};
+
+// Runs of silence in decoded audio frames, by the rms of each frame.
+class SilenceDetector
+{
+public:
+    SilenceDetector();
+
+public:
+    void add_frame(const AVFrame* frame, double time);
+    void finish();
+    inline const std::vector<TimeRange>& runs() const { return m_runs.runs(); }
+
+    static double frame_rms(const AVFrame* frame); // full scale 1.0, negative if not supported
+
+private:
+    RunDetector m_runs;
+    double m_end{0}; // end of the last frame
+};
+
+// a downscaled 8 bits luma plane that is black with little variation
+bool is_black_luma(const cv::Mat& luma);
+
+// black runs with silence at the same time are breaks, the last break early in
+// the file ends the intro, the first one near the end starts the credits
+std::vector<MediaMarker> classify_markers(const std::vector<TimeRange>& blacks, const std::vector<TimeRange>& silences,
+                                          bool bAudio, double start, double duration);
+
+const char* marker_name(MarkerType type);
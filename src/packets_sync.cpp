@@ -926,27 +926,46 @@ void set_audio_playspeed(VideoState* is, double value)
 
     qDebug("changing audio filters to :%s", is->afilters);
 
-#if USE_AVFILTER_VIDEO
-    set_video_playspeed(is);
-#endif
-
     is->audio_clock_old = is->audio_clock;
     is->req_afilter_reconfigure = 1;
 }
 
-void set_video_playspeed(VideoState* is)
+static QMutex vfilters_mutex; // vfilters is set by gui, read by the video decode thread
+
+void set_video_filters(VideoState* is, const char* vfilters)
 {
-    double speed = is->audio_speed;
+    QMutexLocker locker(&vfilters_mutex);
+
+    bool bEmpty = !vfilters || !*vfilters;
+    if (bEmpty ? !is->vfilters : (is->vfilters && !strcmp(is->vfilters, vfilters)))
+        return;
+
+    av_freep(&is->vfilters);
+    if (!bEmpty)
+        is->vfilters = av_strdup(vfilters);
 
-    size_t len = 32;
-    if (!is->vfilters)
-        is->vfilters = (char*)av_malloc(len);
+    is->req_vfilter_reconfigure = 1;
 
-    snprintf(is->vfilters, len, "setpts=%.4lf*PTS", 1.0 / speed);
+    qDebug("changing video filters to :%s", is->vfilters ? is->vfilters : "none");
+}
+
+char* get_video_filters(VideoState* is)
+{
+    QMutexLocker locker(&vfilters_mutex);
+    return is->vfilters ? av_strdup(is->vfilters) : nullptr;
+}
+
+void set_video_deinterlace(VideoState* is, int mode)
+{
+    QMutexLocker locker(&vfilters_mutex);
+
+    if (is->deinterlace_mode == mode)
+        return;
 
+    is->deinterlace_mode = mode;
     is->req_vfilter_reconfigure = 1;
 
-    qDebug("changing video filters to :%s", is->vfilters);
+    qDebug("changing deinterlace mode to :%d", mode);
 }
 
 int cmp_audio_fmts(enum AVSampleFormat fmt1, int64_t channel_count1,
@@ -4,9 +4,10 @@
 #include <QThread>
 #include <QWaitCondition>
 
-// only need to open audio filter, video will be synced
+// audio filter for play speed, video will be synced
+// video filter graph for the filters menu, needs the audio filter fields
 #define USE_AVFILTER_AUDIO 1
-#define USE_AVFILTER_VIDEO 0
+#define USE_AVFILTER_VIDEO 1
 
 extern "C"
 {
@@ -26,6 +27,7 @@ extern "C"
 #include <libavfilter/buffersink.h>
 #include <libavfilter/buffersrc.h>
 #include <libavutil/avstring.h>
+#include <libavutil/cpu.h>
 #include <libavutil/macros.h>
 #include <libavutil/opt.h>
 #endif
@@ -311,6 +313,9 @@ typedef struct VideoState
     int req_afilter_reconfigure;
     char* vfilters;
     int req_vfilter_reconfigure;
+    int deinterlace_mode; // DeinterlaceMode, set by gui
+    int deinterlacing;    // the decode thread found the source interlaced, bwdif is in the graph
+    double vfilter_time;  // average cost of the filter graph per output frame, in seconds
 
     struct AudioParams audio_filter_src;
     int vfilter_idx;
@@ -422,6 +427,9 @@ int configure_filtergraph(AVFilterGraph* graph, const char* filtergraph, AVFilte
 // wanted_nb_channels, int wanted_sample_rate, struct AudioParams*
 // audio_hw_params);
 
-void set_video_playspeed(VideoState* is);
+// video filter graph description, the decode thread rebuilds the graph when it changes
+void set_video_filters(VideoState* is, const char* vfilters);
+char* get_video_filters(VideoState* is); // copy, av_free it
+void set_video_deinterlace(VideoState* is, int mode);
 int configure_video_filters(AVFilterGraph* graph, VideoState* is, const char* vfilters, AVFrame* frame);
 #endif
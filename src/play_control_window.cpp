@@ -244,6 +244,11 @@ void PlayControlWnd::set_progress_bar(double total_secs)
     get_progress_slider()->setMaximum(total_secs);
 }
 
+void PlayControlWnd::set_progress_marks(const std::vector<SliderMark>& marks)
+{
+    ui->progress_slider->set_marks(marks);
+}
+
 QString PlayControlWnd::get_play_time(int64_t hours, int64_t mins, int64_t secs)
 {
     QString str;
@@ -271,6 +276,7 @@ void PlayControlWnd::clear_time()
     m_secs = 0;
 
     get_progress_slider()->setValue(0);
+    set_progress_marks({});
     ui->label_totalTime->setText("--:--");
     ui->label_curTime->setText("--:--");
 }
@@ -3,6 +3,7 @@
 #include <QSlider>
 #include <QWidget>
 #include <memory>
+#include "clickable_slider.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui
@@ -29,6 +30,7 @@ public:
     int get_progress_slider_max();
     int get_progress_slider_value();
     void set_volume_slider(float volume);
+    void set_progress_marks(const std::vector<SliderMark>& marks);
     void clear_all();
     void update_btn_play(bool bPause = true);
     double get_total_time() const;
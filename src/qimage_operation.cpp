@@ -7,6 +7,7 @@
 // ***********************************************************/
 
 #include "qimage_operation.h"
+#include <cmath>
 
 void image_info(const QImage& img)
 {
@@ -57,6 +58,19 @@ bool draw_img_text(QImage& img, const QString& str, const QRect rt, QPen pen, QF
     return p.end();
 }
 
+bool draw_subtitle(QImage& img, const QString& str)
+{
+    int height = 90;
+    QFont font = QFont("Times", 15, QFont::Bold);
+    QRect rt(0, img.height() - height, img.width(), height);
+
+    if (!draw_img_text(img, str, rt, QPen(Qt::black), font)) // black shadow
+        return false;
+
+    rt.adjust(-1, -1, -1, -1);
+    return draw_img_text(img, str, rt, QPen(Qt::white), font);
+}
+
 bool draw_img_rect(QImage& img, const QRect rt, QPen pen)
 {
     QPainter p;
@@ -70,55 +84,25 @@ bool draw_img_rect(QImage& img, const QRect rt, QPen pen)
 
 void grey_image(QImage& img)
 {
-#if 1
     img = img.convertToFormat(QImage::Format_Grayscale8);
-#else
-    int depth = sizeof(QRgb); // 4
-    for (int i = 0; i < img.height(); i++)
-    {
-        uchar* scan = img.scanLine(i);
-        for (int j = 0; j < img.width(); j++)
-        {
-            QRgb* rgbpixel = reinterpret_cast<QRgb*>(scan + j * depth);
-            int gray = qGray(*rgbpixel);
-            *rgbpixel = QColor(gray, gray, gray).rgb();
-        }
-    }
-#endif
 }
 
 void random_image(QImage& img)
 {
-#if 1
-    int depth = img.depth() / 8;
-    for (int i = 0; i < img.height(); i++)
-    {
-        uchar* scan = img.scanLine(i);
-        for (int j = 0; j < img.width(); j++)
-        {
-            QRgb* rgbpixel = reinterpret_cast<QRgb*>(scan + j * depth);
+    if (img.depth() != 32)
+        img = img.convertToFormat(QImage::Format_RGB32);
 
-            int r = QRandomGenerator::global()->generate();
-            int g = QRandomGenerator::global()->generate();
-            int b = QRandomGenerator::global()->generate();
-
-            //*rgbpixel = QColor(r % 255, g % 255, b % 255).rgb();
-            *rgbpixel = qRgb(r, g, b);
-        }
-    }
-#else
     for (int i = 0; i < img.height(); i++)
     {
+        QRgb* scan = reinterpret_cast<QRgb*>(img.scanLine(i));
         for (int j = 0; j < img.width(); j++)
         {
-            // img.setPixel(j, i, value[w % n]);
             int r = QRandomGenerator::global()->generate();
             int g = QRandomGenerator::global()->generate();
             int b = QRandomGenerator::global()->generate();
-            img.setPixel(j, i, qRgb(r % 255, g % 255, b % 255));
+            scan[j] = qRgb(r, g, b);
         }
     }
-#endif
 }
 
 void split_image(QImage& img, QImage& r_img, QImage& b_img, QImage& g_img)
@@ -126,31 +110,20 @@ void split_image(QImage& img, QImage& r_img, QImage& b_img, QImage& g_img)
     Q_ASSERT(img.size() == r_img.size());
     Q_ASSERT(r_img.size() == b_img.size());
     Q_ASSERT(r_img.size() == g_img.size());
+    Q_ASSERT(img.depth() == 32 && r_img.depth() == 32 && g_img.depth() == 32 && b_img.depth() == 32);
 
-    int depth = img.depth() / 8;
     for (int i = 0; i < img.height(); i++)
     {
-        uchar* scan = img.scanLine(i);
-
-        uchar* r_scan = r_img.scanLine(i);
-        uchar* b_scan = b_img.scanLine(i);
-        uchar* g_scan = g_img.scanLine(i);
+        const QRgb* scan = reinterpret_cast<const QRgb*>(img.constScanLine(i));
+        QRgb* r_scan = reinterpret_cast<QRgb*>(r_img.scanLine(i));
+        QRgb* g_scan = reinterpret_cast<QRgb*>(g_img.scanLine(i));
+        QRgb* b_scan = reinterpret_cast<QRgb*>(b_img.scanLine(i));
 
         for (int j = 0; j < img.width(); j++)
         {
-            QRgb* all_rgbpixel = reinterpret_cast<QRgb*>(scan + j * depth);
-
-            QRgb* r_rgbpixel = reinterpret_cast<QRgb*>(r_scan + j * depth);
-            QRgb* g_rgbpixel = reinterpret_cast<QRgb*>(g_scan + j * depth);
-            QRgb* b_rgbpixel = reinterpret_cast<QRgb*>(b_scan + j * depth);
-
-            uint r = qRed(*all_rgbpixel);
-            uint g = qGreen(*all_rgbpixel);
-            uint b = qBlue(*all_rgbpixel);
-
-            *r_rgbpixel = qRgb(r, 0, 0);
-            *g_rgbpixel = qRgb(0, g, 0);
-            *b_rgbpixel = qRgb(0, 0, b);
+            r_scan[j] = qRgb(qRed(scan[j]), 0, 0);
+            g_scan[j] = qRgb(0, qGreen(scan[j]), 0);
+            b_scan[j] = qRgb(0, 0, qBlue(scan[j]));
         }
     }
 }
@@ -183,28 +156,21 @@ void transform_image(QImage& img, const QTransform& matrix, Qt::TransformationMo
 
 QImage gamma_image(const QImage& img, double exp)
 {
-    QImage retImg(img);
+    // 256 pow per channel instead of 3 per pixel, same values as QColor(255 * pow(c, exp))
+    uchar table[256];
+    for (int i = 0; i < 256; i++)
+        table[i] = uchar(int(255 * std::pow(i / 255.0, exp)));
 
-    int depth = img.depth() / 8;
-    for (int i = 0; i < img.height(); i++)
+    // pixels are read as QRgb, 24 and 8 bits images are converted first
+    const QImage src = (img.depth() == 32) ? img : img.convertToFormat(QImage::Format_RGB32);
+    QImage retImg(src.size(), src.format());
+    for (int i = 0; i < src.height(); i++)
     {
-        const uchar* scan = img.scanLine(i);
-        uchar* ret_scan = retImg.scanLine(i);
-
-        for (int j = 0; j < img.width(); j++)
-        {
-            const QRgb* rgbpixel = reinterpret_cast<const QRgb*>(scan + j * depth);
-
-            QRgb* ret_rgbpixel = reinterpret_cast<QRgb*>(ret_scan + j * depth);
+        const QRgb* scan = reinterpret_cast<const QRgb*>(src.constScanLine(i));
+        QRgb* ret_scan = reinterpret_cast<QRgb*>(retImg.scanLine(i));
 
-            const double r = qRed(*rgbpixel) / 255.0;
-            const double g = qGreen(*rgbpixel) / 255.0;
-            const double b = qBlue(*rgbpixel) / 255.0;
-
-            *ret_rgbpixel = QColor(255 * std::pow(r, exp), 255 * std::pow(g, exp),
-                                   255 * std::pow(b, exp))
-                                .rgb();
-        }
+        for (int j = 0; j < src.width(); j++)
+            ret_scan[j] = qRgb(table[qRed(scan[j])], table[qGreen(scan[j])], table[qBlue(scan[j])]);
     }
 
     return retImg;
@@ -15,6 +15,7 @@ void create_image(QImage& img);
 bool draw_img_text(QImage& img, const QString& str, const QRect rt,
                    QPen pen = QPen(Qt::red), QFont font = QFont("Times", 48, QFont::Bold));
 
+bool draw_subtitle(QImage& img, const QString& str);
 bool draw_img_rect(QImage& img, const QRect rt, QPen pen = QPen(Qt::red));
 void grey_image(QImage& img);
 void random_image(QImage& img);
@@ -0,0 +1,509 @@
+// ***********************************************************/
+// scene_index_thread.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Background scene cut detection of the playing file. It is
+// decoded again in this idle priority thread on a single core,
+// at low resolution where the codec allows and without the
+// non reference frames. A cut needs a luma histogram change
+// and a difference far above the running average, so motion
+// and fades don't count. Runs of black frames and of silent
+// audio on the same pass give the skip markers. The finished
+// index is cached.
+// ***********************************************************/
+
+#include "scene_index_thread.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cmath>
+#include "common.h"
+#include "imagecv_operations.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+#define SAMPLE_WIDTH 160
+#define SAMPLE_HEIGHT 90
+#define THUMB_WIDTH 192
+#define HIST_BINS 32
+#define CUT_HIST_LIMIT 0.2       // histogram distance of a cut, 0 to 1
+#define CUT_SAD_MIN 12.0         // mean absolute luma difference of a cut, 8 bits
+#define CUT_SAD_RATIO 3.0        // times the running average difference
+#define SAD_AVERAGE_RATE 0.1     // weight of a new frame in the running average
+#define MIN_SCENE_LENGTH 1.0     // seconds, flashes are no cuts
+#define PREVIOUS_SCENE_GRACE 2.0 // seconds into a scene, going back goes to the one before
+#define NOTIFY_INTERVAL 500      // ms
+#define CACHE_MAGIC 0x53434e58   // "SCNX"
+#define CACHE_VERSION 2
+
+SceneIndexThread::SceneIndexThread(const QString& file, QObject* parent) : QThread(parent), m_file(file)
+{
+}
+
+SceneIndexThread::~SceneIndexThread()
+{
+    stop_thread();
+    wait();
+
+    sws_freeContext(m_graySws);
+    sws_freeContext(m_thumbSws);
+}
+
+void SceneIndexThread::stop_thread()
+{
+    m_bExitThread = true;
+}
+
+std::vector<SceneCut> SceneIndexThread::scenes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_scenes;
+}
+
+bool SceneIndexThread::next_scene(double pos, double& time) const
+{
+    QMutexLocker locker(&m_mutex);
+    // a seek lands a little before the cut, don't stay in the scene just started
+    auto it = std::find_if(m_scenes.begin(), m_scenes.end(),
+                           [pos](const SceneCut& cut) { return cut.time > pos + 0.5; });
+    if (it == m_scenes.end())
+        return false;
+
+    time = it->time;
+    return true;
+}
+
+bool SceneIndexThread::previous_scene(double pos, double& time) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = std::find_if(m_scenes.rbegin(), m_scenes.rend(),
+                           [pos](const SceneCut& cut) { return cut.time < pos - PREVIOUS_SCENE_GRACE; });
+    if (it == m_scenes.rend())
+        return false;
+
+    time = it->time;
+    return true;
+}
+
+double SceneIndexThread::progress() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_progress;
+}
+
+std::vector<MediaMarker> SceneIndexThread::markers() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_markers;
+}
+
+bool SceneIndexThread::marker_at(double pos, MediaMarker& marker) const
+{
+    QMutexLocker locker(&m_mutex);
+    // nothing left to skip in the last second
+    auto it = std::find_if(m_markers.begin(), m_markers.end(), [pos](const MediaMarker& m) {
+        return pos >= m.start - 0.5 && pos < m.end - 1.0;
+    });
+    if (it == m_markers.end())
+        return false;
+
+    marker = *it;
+    return true;
+}
+
+bool SceneIndexThread::is_complete() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bComplete;
+}
+
+void SceneIndexThread::run()
+{
+    if (load_cache())
+    {
+        notify(true);
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ret = analyze();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_bComplete = ret;
+        if (ret)
+            m_progress = 1.0;
+    }
+
+    if (ret)
+    {
+        save_cache();
+        qDebug("Scene index of %s: %d scenes in %.1f s.", qUtf8Printable(toNativePath(m_file)),
+               int(scenes().size()), timer.elapsed() / 1000.0);
+    }
+    notify(true);
+
+    qDebug("-------- Scene index thread exit.");
+}
+
+int SceneIndexThread::interrupt_cb(void* ctx)
+{
+    return static_cast<SceneIndexThread*>(ctx)->m_bExitThread ? 1 : 0;
+}
+
+AVCodecContext* SceneIndexThread::open_decoder(const AVStream* st, bool bVideo)
+{
+    auto codec = avcodec_find_decoder(st->codecpar->codec_id);
+    if (!codec)
+        return nullptr;
+
+    auto avctx = avcodec_alloc_context3(codec);
+    if (!avctx)
+        return nullptr;
+
+    if (avcodec_parameters_to_context(avctx, st->codecpar) < 0)
+    {
+        avcodec_free_context(&avctx);
+        return nullptr;
+    }
+
+    avctx->pkt_timebase = st->time_base;
+    avctx->thread_count = 1; // playback keeps the other cores
+    if (bVideo)
+    {
+        // cheapest decoding that still shows the cuts and black frames
+        avctx->lowres = std::min(2, int(codec->max_lowres));
+        avctx->skip_frame = AVDISCARD_NONREF;
+        avctx->skip_loop_filter = AVDISCARD_ALL;
+        avctx->flags2 |= AV_CODEC_FLAG2_FAST;
+    }
+
+    if (avcodec_open2(avctx, codec, nullptr) < 0)
+    {
+        avcodec_free_context(&avctx);
+        return nullptr;
+    }
+    return avctx;
+}
+
+bool SceneIndexThread::analyze()
+{
+    AVFormatContext* ic = avformat_alloc_context();
+    if (!ic)
+        return false;
+
+    ic->interrupt_callback.callback = interrupt_cb;
+    ic->interrupt_callback.opaque = this;
+
+    if (avformat_open_input(&ic, m_file.toUtf8().constData(), nullptr, nullptr) < 0)
+    {
+        qWarning("Scene index, failed to open %s.", qUtf8Printable(toNativePath(m_file)));
+        return false; // ic is freed on failure
+    }
+
+    bool ret = false;
+    AVCodecContext* avctx = nullptr;
+    AVCodecContext* audioCtx = nullptr;
+    AVPacket* pkt = nullptr;
+    AVFrame* frame = nullptr;
+
+    do
+    {
+        if (avformat_find_stream_info(ic, nullptr) < 0)
+            break;
+
+        int index = av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (index < 0 || (ic->streams[index]->disposition & AV_DISPOSITION_ATTACHED_PIC))
+            break;
+
+        // silence is searched in the audio played by default
+        int audioIndex = av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO, -1, index, nullptr, 0);
+
+        // the other streams are not even demuxed
+        for (unsigned int i = 0; i < ic->nb_streams; ++i)
+            ic->streams[i]->discard = (int(i) == index || int(i) == audioIndex) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+        avctx = open_decoder(ic->streams[index], true);
+        if (!avctx)
+            break;
+
+        // markers are still guessed from black frames alone
+        if (audioIndex >= 0)
+            audioCtx = open_decoder(ic->streams[audioIndex], false);
+
+        pkt = av_packet_alloc();
+        frame = av_frame_alloc();
+        if (!pkt || !frame)
+            break;
+
+        const double tb = av_q2d(ic->streams[index]->time_base);
+        const double audioTb = audioCtx ? av_q2d(ic->streams[audioIndex]->time_base) : 0;
+        const double start = (ic->start_time != AV_NOPTS_VALUE) ? ic->start_time / double(AV_TIME_BASE) : 0;
+        const double duration = (ic->duration > 0) ? ic->duration / double(AV_TIME_BASE) : 0;
+        bool bEof = false;
+
+        while (!m_bExitThread)
+        {
+            int err = av_read_frame(ic, pkt);
+            if (err < 0)
+            {
+                if (err != AVERROR_EOF && !avio_feof(ic->pb) && !m_bExitThread)
+                    qWarning("Scene index, read error %d, indexed up to there.", err);
+                // drain
+                avcodec_send_packet(avctx, nullptr);
+                if (audioCtx)
+                    avcodec_send_packet(audioCtx, nullptr);
+                bEof = true;
+            }
+            else
+            {
+                // damaged packets are skipped
+                if (pkt->stream_index == index)
+                    avcodec_send_packet(avctx, pkt);
+                else if (audioCtx && pkt->stream_index == audioIndex)
+                    avcodec_send_packet(audioCtx, pkt);
+                av_packet_unref(pkt);
+            }
+
+            while (!m_bExitThread && avcodec_receive_frame(avctx, frame) >= 0)
+            {
+                if (frame->best_effort_timestamp != AV_NOPTS_VALUE)
+                {
+                    double time = frame->best_effort_timestamp * tb;
+                    sample_frame(frame, time);
+
+                    if (duration > 0)
+                    {
+                        QMutexLocker locker(&m_mutex);
+                        m_progress = std::clamp((time - start) / duration, 0.0, 1.0);
+                    }
+                    notify();
+                }
+                av_frame_unref(frame);
+            }
+
+            while (audioCtx && !m_bExitThread && avcodec_receive_frame(audioCtx, frame) >= 0)
+            {
+                if (frame->best_effort_timestamp != AV_NOPTS_VALUE)
+                    m_silence.add_frame(frame, frame->best_effort_timestamp * audioTb);
+                av_frame_unref(frame);
+            }
+
+            if (bEof)
+            {
+                ret = !m_bExitThread;
+                break;
+            }
+        }
+
+        if (ret)
+        {
+            m_blackRuns.finish(m_lastTime);
+            m_silence.finish();
+            auto markers = classify_markers(m_blackRuns.runs(), m_silence.runs(), audioCtx != nullptr, start, duration);
+
+            QMutexLocker locker(&m_mutex);
+            m_markers = std::move(markers);
+        }
+    } while (0);
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    avcodec_free_context(&audioCtx);
+    avcodec_free_context(&avctx);
+    avformat_close_input(&ic);
+    return ret;
+}
+
+bool SceneIndexThread::sample_frame(const AVFrame* frame, double time)
+{
+    m_graySws = sws_getCachedContext(m_graySws, frame->width, frame->height, AVPixelFormat(frame->format),
+                                     SAMPLE_WIDTH, SAMPLE_HEIGHT, AV_PIX_FMT_GRAY8, SWS_AREA, nullptr, nullptr, nullptr);
+    if (!m_graySws)
+        return false;
+
+    auto& sample = m_samples[m_current];
+    sample.create(SAMPLE_HEIGHT, SAMPLE_WIDTH, CV_8UC1);
+    uint8_t* data[4] = {sample.data, nullptr, nullptr, nullptr};
+    int linesize[4] = {int(sample.step), 0, 0, 0};
+    sws_scale(m_graySws, frame->data, frame->linesize, 0, frame->height, data, linesize);
+
+    if (!m_bHasPrevious)
+    {
+        add_scene(frame, time, 1.0f);
+        m_lastCut = time;
+    }
+    else
+    {
+        const auto& previous = m_samples[1 - m_current];
+        double sad = sad_imgs(sample, previous);
+        double hist = hist_distance_imgs(sample, previous, HIST_BINS);
+
+        // timestamps going back (discontinuities) restart the minimum length
+        bool bLength = (time < m_lastCut) || (time - m_lastCut >= MIN_SCENE_LENGTH);
+        if (bLength && hist >= CUT_HIST_LIMIT && sad >= CUT_SAD_MIN && sad >= CUT_SAD_RATIO * m_sadAverage)
+        {
+            add_scene(frame, time, float(hist));
+            m_lastCut = time;
+        }
+        else
+        {
+            m_sadAverage += (sad - m_sadAverage) * SAD_AVERAGE_RATE;
+        }
+
+#if PRINT_SCENE_INDEX
+        qDebug("scene index %.3f s: sad %.2f (average %.2f), hist %.3f", time, sad, m_sadAverage, hist);
+#endif
+    }
+
+    m_blackRuns.add(time, is_black_luma(sample));
+    m_lastTime = time;
+
+    m_current = 1 - m_current;
+    m_bHasPrevious = true;
+    return true;
+}
+
+void SceneIndexThread::add_scene(const AVFrame* frame, double time, float score)
+{
+    double aspect = double(frame->width) / frame->height;
+    if (frame->sample_aspect_ratio.num > 0 && frame->sample_aspect_ratio.den > 0)
+        aspect *= av_q2d(frame->sample_aspect_ratio);
+
+    const int width = THUMB_WIDTH;
+    const int height = std::clamp(int(std::lround(width / aspect)) & ~1, 2, 4 * THUMB_WIDTH);
+
+    m_thumbSws = sws_getCachedContext(m_thumbSws, frame->width, frame->height, AVPixelFormat(frame->format), width,
+                                      height, AV_PIX_FMT_RGB24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+
+    SceneCut cut;
+    cut.time = time;
+    cut.score = score;
+    if (m_thumbSws)
+    {
+        QImage img(width, height, QImage::Format_RGB888);
+        uint8_t* data[4] = {img.bits(), nullptr, nullptr, nullptr};
+        int linesize[4] = {int(img.bytesPerLine()), 0, 0, 0};
+        sws_scale(m_thumbSws, frame->data, frame->linesize, 0, frame->height, data, linesize);
+        cut.thumbnail = img;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    auto it = std::upper_bound(m_scenes.begin(), m_scenes.end(), time,
+                               [](double t, const SceneCut& c) { return t < c.time; });
+    m_scenes.insert(it, std::move(cut));
+}
+
+void SceneIndexThread::notify(bool bForce)
+{
+    if (bForce || !m_notifyTimer.isValid() || m_notifyTimer.elapsed() >= NOTIFY_INTERVAL)
+    {
+        m_notifyTimer.restart();
+        emit scenes_updated();
+    }
+}
+
+QString SceneIndexThread::cache_file() const
+{
+    // a changed file gets a new index
+    QFileInfo info(m_file);
+    QByteArray key = info.absoluteFilePath().toUtf8() + '|' + QByteArray::number(info.size()) + '|' +
+                     QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+    auto name = QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) + ".idx";
+
+    auto dir = appendPath(QStandardPaths::writableLocation(QStandardPaths::CacheLocation), "scenes");
+    return appendPath(dir, name);
+}
+
+bool SceneIndexThread::load_cache()
+{
+    QFile file(cache_file());
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if (in.status() != QDataStream::Ok || magic != CACHE_MAGIC || version != CACHE_VERSION)
+        return false;
+
+    std::vector<SceneCut> scenes;
+    for (quint32 i = 0; i < count && !m_bExitThread; ++i)
+    {
+        SceneCut cut;
+        in >> cut.time >> cut.score >> cut.thumbnail;
+        if (in.status() != QDataStream::Ok)
+        {
+            qWarning("Scene index cache %s is damaged.", qUtf8Printable(toNativePath(file.fileName())));
+            return false;
+        }
+        scenes.push_back(std::move(cut));
+    }
+
+    std::vector<MediaMarker> markers;
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        int type = 0;
+        MediaMarker marker;
+        in >> type >> marker.start >> marker.end;
+        marker.type = MarkerType(type);
+        markers.push_back(marker);
+    }
+    if (in.status() != QDataStream::Ok)
+    {
+        qWarning("Scene index cache %s is damaged.", qUtf8Printable(toNativePath(file.fileName())));
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_scenes = std::move(scenes);
+    m_markers = std::move(markers);
+    m_progress = 1.0;
+    m_bComplete = true;
+    return true;
+}
+
+bool SceneIndexThread::save_cache() const
+{
+    auto path = cache_file();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        qWarning("Scene index cache %s can't be written.", qUtf8Printable(toNativePath(path)));
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+
+    auto scenes = this->scenes();
+    out << quint32(CACHE_MAGIC) << quint32(CACHE_VERSION) << quint32(scenes.size());
+    for (const auto& cut : scenes)
+        out << cut.time << cut.score << cut.thumbnail;
+
+    auto markers = this->markers();
+    out << quint32(markers.size());
+    for (const auto& marker : markers)
+        out << int(marker.type) << marker.start << marker.end;
+
+    return file.commit();
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "media_markers.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#define PRINT_SCENE_INDEX 0
+
+typedef struct SceneCut
+{
+    double time{0};   // stream seconds, same as the master clock
+    float score{0};   // histogram distance to the frame before, 1 for the first scene
+    QImage thumbnail; // first frame of the scene
+} SceneCut;
+
+// Scene index of a local file. The file is opened a second time and decoded
+// at low resolution with reference frames only, consecutive downscaled luma
+// samples are compared by their mean absolute difference and histogram
+// distance. Black frame and silence runs of the same pass give intro, break
+// and credits markers. A finished index is cached on disk per file.
+class SceneIndexThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit SceneIndexThread(const QString& file, QObject* parent = Q_NULLPTR);
+    ~SceneIndexThread();
+
+public:
+    std::vector<SceneCut> scenes() const;
+    // start of the scene after/before the one playing at pos, false if none
+    bool next_scene(double pos, double& time) const;
+    bool previous_scene(double pos, double& time) const;
+    std::vector<MediaMarker> markers() const; // once complete
+    bool marker_at(double pos, MediaMarker& marker) const;
+    double progress() const; // 0 to 1
+    bool is_complete() const;
+    void stop_thread();
+
+signals:
+    void scenes_updated(); // at most twice a second and when finished, with the markers
+
+protected:
+    void run() override;
+
+private:
+    bool analyze();
+    static AVCodecContext* open_decoder(const AVStream* st, bool bVideo);
+    bool sample_frame(const AVFrame* frame, double time);
+    void add_scene(const AVFrame* frame, double time, float score);
+    void notify(bool bForce = false);
+    QString cache_file() const;
+    bool load_cache();
+    bool save_cache() const;
+    static int interrupt_cb(void* ctx);
+
+private:
+    QString m_file;
+    std::atomic_bool m_bExitThread{false};
+
+    mutable QMutex m_mutex;
+    std::vector<SceneCut> m_scenes;
+    std::vector<MediaMarker> m_markers;
+    double m_progress{0};
+    bool m_bComplete{false};
+
+    // analysis state, only used by the thread
+    struct SwsContext* m_graySws{nullptr};
+    struct SwsContext* m_thumbSws{nullptr};
+    cv::Mat m_samples[2]; // previous and current luma samples, used in turn
+    int m_current{0};
+    bool m_bHasPrevious{false};
+    double m_sadAverage{0};
+    double m_lastCut{0};
+    double m_lastTime{0};
+    RunDetector m_blackRuns{BLACK_MIN_LENGTH};
+    SilenceDetector m_silence;
+    QElapsedTimer m_notifyTimer;
+};
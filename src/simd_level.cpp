@@ -0,0 +1,81 @@
+// ***********************************************************/
+// simd_level.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Runtime detection of the SIMD level of the cpu kernels.
+// AVX2 is only used when the cpu and the os support it.
+// ***********************************************************/
+
+#include "simd_level.h"
+#include <algorithm>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_LEVEL_X86 1
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+#else
+#define SIMD_LEVEL_X86 0
+#endif
+
+#if SIMD_LEVEL_X86
+static bool cpu_has_avx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // avx needs the os to save the ymm registers
+    __cpuid(info, 1);
+    bool bOsxsave = info[2] & (1 << 27);
+    bool bAvx = info[2] & (1 << 28);
+    if (!bOsxsave || !bAvx || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+SimdLevel simd_level_supported()
+{
+#if SIMD_LEVEL_X86
+    static const SimdLevel level = cpu_has_avx2() ? SimdLevel::AVX2 : SimdLevel::SSE2;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+static std::atomic<SimdLevel> g_simdLevel{simd_level_supported()};
+
+SimdLevel simd_level()
+{
+    return g_simdLevel;
+}
+
+void set_simd_level(SimdLevel level)
+{
+    g_simdLevel = std::min(level, simd_level_supported());
+}
+
+const char* simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::SSE2:
+            return "sse2";
+        case SimdLevel::AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// Instruction set the cpu kernels run with. Each kernel has a scalar reference
+// and vector versions with the same output, the best supported level is used
+// unless a benchmark lowers it.
+
+enum class SimdLevel
+{
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+SimdLevel simd_level_supported(); // best level of this cpu
+SimdLevel simd_level();           // level in use, the supported one by default
+void set_simd_level(SimdLevel level); // lowered to the supported level, for benchmarks
+const char* simd_level_name(SimdLevel level);
@@ -0,0 +1,343 @@
+// ***********************************************************/
+// temporal_denoiser.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Motion adaptive temporal denoiser for noisy low light video.
+// Frames are averaged with the last outputs where a block SAD
+// says nothing moved, per pixel differences above the noise
+// are kept. Runs on the yuv frames before conversion.
+// ***********************************************************/
+
+#include "temporal_denoiser.h"
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "simd_level.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DENOISE_SSE 1
+#include <emmintrin.h>
+#else
+#define DENOISE_SSE 0
+#endif
+
+#define DENOISE_MAX_NOISE 12.0 // mostly moving pictures must not raise the thresholds further
+
+static int block_sad_c(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, int w, int h)
+{
+    int sum = 0;
+    for (int y = 0; y < h; y++, a += a_linesize, b += b_linesize)
+    {
+        for (int x = 0; x < w; x++)
+            sum += std::abs(a[x] - b[x]);
+    }
+    return sum;
+}
+
+// towards ref by weight / 128, half of it for differences up to twice the threshold
+static inline int pull(int v, int ref, int weight, int thr)
+{
+    int d = ref - v;
+    int ad = std::abs(d);
+    int w = ad < thr ? weight : (ad < 2 * thr ? weight >> 1 : 0);
+    return v + ((d * w) >> 7);
+}
+
+static void denoise_span_c(const uint8_t* cur, const uint8_t* r0, const uint8_t* r1, uint8_t* dst, uint8_t* keep,
+                           int x, int end, int w0, int w1, int thr)
+{
+    for (; x < end; x++)
+    {
+        int v = pull(cur[x], r1[x], w1, thr); // the older output first
+        v = pull(v, r0[x], w0, thr);
+        dst[x] = keep[x] = uint8_t(v);
+    }
+}
+
+#if DENOISE_SSE
+static int block_sad_sse2(const uint8_t* a, int a_linesize, const uint8_t* b, int b_linesize, int h)
+{
+    // DENOISE_BLOCK wide
+    __m128i sum = _mm_setzero_si128();
+    for (int y = 0; y < h; y++, a += a_linesize, b += b_linesize)
+    {
+        sum = _mm_add_epi32(sum, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a)),
+                                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(b))));
+    }
+    return _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+}
+
+static inline __m128i pull_sse2(__m128i v, __m128i ref, __m128i weight, __m128i half, __m128i thr, __m128i thr2)
+{
+    // |d| * weight fits 16 bits, weight is below 128
+    __m128i d = _mm_sub_epi16(ref, v);
+    __m128i ad = _mm_max_epi16(d, _mm_sub_epi16(_mm_setzero_si128(), d));
+    __m128i near = _mm_cmplt_epi16(ad, thr);
+    __m128i mid = _mm_andnot_si128(near, _mm_cmplt_epi16(ad, thr2));
+    __m128i w = _mm_or_si128(_mm_and_si128(near, weight), _mm_and_si128(mid, half));
+    return _mm_add_epi16(v, _mm_srai_epi16(_mm_mullo_epi16(d, w), 7));
+}
+
+static void denoise_span_sse2(const uint8_t* cur, const uint8_t* r0, const uint8_t* r1, uint8_t* dst, uint8_t* keep,
+                              int x, int end, int w0, int w1, int thr)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weight0 = _mm_set1_epi16(short(w0)), half0 = _mm_set1_epi16(short(w0 >> 1));
+    const __m128i weight1 = _mm_set1_epi16(short(w1)), half1 = _mm_set1_epi16(short(w1 >> 1));
+    const __m128i vthr = _mm_set1_epi16(short(thr)), vthr2 = _mm_set1_epi16(short(2 * thr));
+    for (; x + 8 <= end; x += 8)
+    {
+        __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cur + x)), zero);
+        __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r0 + x)), zero);
+        __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r1 + x)), zero);
+        v = pull_sse2(v, b, weight1, half1, vthr, vthr2);
+        v = pull_sse2(v, a, weight0, half0, vthr, vthr2);
+        v = _mm_packus_epi16(v, v);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), v);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(keep + x), v);
+    }
+    denoise_span_c(cur, r0, r1, dst, keep, x, end, w0, w1, thr);
+}
+#endif
+
+// a row of a plane, weights of DENOISE_REFS per block of blockBytes
+static void denoise_row(const uint8_t* cur, const uint8_t* r0, const uint8_t* r1, uint8_t* dst, uint8_t* keep, int n,
+                        const int16_t* weights, int blockBytes, int thr, bool bSimd)
+{
+    for (int x = 0; x < n; x += blockBytes, weights += DENOISE_REFS)
+    {
+        int end = std::min(x + blockBytes, n);
+#if DENOISE_SSE
+        if (bSimd)
+        {
+            denoise_span_sse2(cur, r0, r1, dst, keep, x, end, weights[0], weights[1], thr);
+            continue;
+        }
+#endif
+        denoise_span_c(cur, r0, r1, dst, keep, x, end, weights[0], weights[1], thr);
+    }
+}
+
+static inline int plane_width(const InterpPicture& pic, const InterpPlane& plane)
+{
+    return -((-pic.width) >> plane.shift_w);
+}
+
+static inline int plane_height(const InterpPicture& pic, const InterpPlane& plane)
+{
+    return -((-pic.height) >> plane.shift_h);
+}
+
+const char* TemporalDenoiser::strength_name(DenoiseStrength strength)
+{
+    switch (strength)
+    {
+        case DenoiseStrength::Light:
+            return "light";
+        case DenoiseStrength::Medium:
+            return "medium";
+        case DenoiseStrength::Strong:
+            return "strong";
+        default:
+            return "off";
+    }
+}
+
+void TemporalDenoiser::set_strength(DenoiseStrength strength)
+{
+    if (strength == m_strength)
+        return;
+
+    // the outputs of another strength are no references
+    m_strength = strength;
+    switch (strength)
+    {
+        case DenoiseStrength::Light:
+            m_maxWeight = 48;
+            break;
+        case DenoiseStrength::Medium:
+            m_maxWeight = 80;
+            break;
+        case DenoiseStrength::Strong:
+            m_maxWeight = 112;
+            break;
+        default:
+            m_maxWeight = 0;
+            break;
+    }
+    reset();
+}
+
+void TemporalDenoiser::reset()
+{
+    m_count = 0;
+    m_noise = 0;
+}
+
+bool TemporalDenoiser::same_layout(const InterpPicture& pic) const
+{
+    if (pic.width != m_layout.width || pic.height != m_layout.height || pic.nb_planes != m_layout.nb_planes)
+        return false;
+
+    for (int p = 0; p < pic.nb_planes; p++)
+    {
+        const auto &a = pic.planes[p], &b = m_layout.planes[p];
+        if (a.step != b.step || a.shift_w != b.shift_w || a.shift_h != b.shift_h)
+            return false;
+    }
+    return true;
+}
+
+void TemporalDenoiser::allocate(const InterpPicture& pic)
+{
+    m_layout = pic;
+    for (int p = 0; p < pic.nb_planes; p++)
+    {
+        auto& plane = m_layout.planes[p];
+        plane.data = nullptr;
+        plane.linesize = plane_width(pic, plane) * plane.step;
+        for (auto& slot : m_ring)
+            slot[p].resize(size_t(plane.linesize) * plane_height(pic, plane));
+    }
+
+    m_blocksX = (pic.width + DENOISE_BLOCK - 1) / DENOISE_BLOCK;
+    m_blocksY = (pic.height + DENOISE_BLOCK - 1) / DENOISE_BLOCK;
+    for (auto& sads : m_sads)
+        sads.assign(size_t(m_blocksX) * m_blocksY, 0);
+    m_gates.assign(size_t(m_blocksX) * m_blocksY, BlockGate());
+    m_head = 0;
+    reset();
+}
+
+InterpPicture TemporalDenoiser::ring_picture(int slot)
+{
+    InterpPicture pic = m_layout;
+    for (int p = 0; p < pic.nb_planes; p++)
+        pic.planes[p].data = m_ring[slot][p].data();
+    return pic;
+}
+
+void TemporalDenoiser::gate_row(int by, const InterpPicture& cur, const InterpPicture* refs, int nb_refs, bool bSimd)
+{
+    const auto& luma = cur.planes[0];
+    const int y = by * DENOISE_BLOCK;
+    const int h = std::min(DENOISE_BLOCK, cur.height - y);
+    for (int bx = 0; bx < m_blocksX; bx++)
+    {
+        const int x = bx * DENOISE_BLOCK;
+        const int w = std::min(DENOISE_BLOCK, cur.width - x);
+        const uint8_t* a = luma.data + size_t(y) * luma.linesize + x;
+        for (int k = 0; k < nb_refs; k++)
+        {
+            const auto& ref = refs[k].planes[0];
+            const uint8_t* b = ref.data + size_t(y) * ref.linesize + x;
+            int sad;
+#if DENOISE_SSE
+            if (bSimd && w == DENOISE_BLOCK)
+                sad = block_sad_sse2(a, luma.linesize, b, ref.linesize, h);
+            else
+#endif
+                sad = block_sad_c(a, luma.linesize, b, ref.linesize, w, h);
+            m_sads[k][by * m_blocksX + bx] = sad * 256 / (w * h);
+        }
+    }
+}
+
+void TemporalDenoiser::update_gates(int nb_refs)
+{
+    // a quarter of the blocks is quiet in most videos, their difference is the noise
+    std::vector<int> sads(m_sads[0]);
+    auto quarter = sads.begin() + sads.size() / 4;
+    std::nth_element(sads.begin(), quarter, sads.end());
+    double noise = std::min(*quarter / 256.0, DENOISE_MAX_NOISE);
+    m_noise = m_noise > 0 ? m_noise * 0.9 + noise * 0.1 : noise;
+
+    const double n = std::max(m_noise, 0.5);
+    m_threshold = std::clamp(int(std::lround(n * 2.5 + 2)), 3, 40);
+
+    // full weight up to a bit above the noise, none for blocks that clearly moved
+    const double lo = n * 1.5 + 1, hi = n * 4 + 2;
+    m_gatedBlocks = 0;
+    for (size_t i = 0; i < m_gates.size(); i++)
+    {
+        for (int k = 0; k < DENOISE_REFS; k++)
+        {
+            int weight = 0;
+            if (k < nb_refs)
+            {
+                int maxWeight = m_maxWeight >> k; // older outputs count less
+                double m = m_sads[k][i] / 256.0;
+                weight = m <= lo ? maxWeight : (m >= hi ? 0 : int(maxWeight * (hi - m) / (hi - lo)));
+            }
+            m_gates[i].weight[k] = int16_t(weight);
+        }
+        if (m_gates[i].weight[0] == 0)
+            m_gatedBlocks++;
+    }
+}
+
+void TemporalDenoiser::filter_row(int by, const InterpPicture& cur, const InterpPicture* refs, int nb_refs,
+                                  InterpPicture& dst, InterpPicture& keep, bool bSimd) const
+{
+    const int16_t* weights = m_gates[by * m_blocksX].weight;
+    for (int p = 0; p < cur.nb_planes; p++)
+    {
+        const auto& plane = cur.planes[p];
+        const int height = plane_height(cur, plane);
+        const int bytes = plane_width(cur, plane) * plane.step;
+        const int y0 = (by * DENOISE_BLOCK) >> plane.shift_h;
+        const int y1 = by == m_blocksY - 1 ? height : std::min(((by + 1) * DENOISE_BLOCK) >> plane.shift_h, height);
+        const int blockBytes = (DENOISE_BLOCK >> plane.shift_w) * plane.step;
+
+        for (int y = y0; y < y1; y++)
+        {
+            const uint8_t* c = plane.data + size_t(y) * plane.linesize;
+            uint8_t* d = dst.planes[p].data + size_t(y) * dst.planes[p].linesize;
+            uint8_t* k = keep.planes[p].data + size_t(y) * keep.planes[p].linesize;
+            if (nb_refs == 0)
+            {
+                memcpy(d, c, bytes);
+                memcpy(k, c, bytes);
+                continue;
+            }
+
+            const uint8_t* r0 = refs[0].planes[p].data + size_t(y) * refs[0].planes[p].linesize;
+            const uint8_t* r1 = nb_refs > 1 ? refs[1].planes[p].data + size_t(y) * refs[1].planes[p].linesize : r0;
+            denoise_row(c, r0, r1, d, k, bytes, weights, blockBytes, m_threshold, bSimd);
+        }
+    }
+}
+
+void TemporalDenoiser::denoise(const InterpPicture& cur, InterpPicture& dst)
+{
+    if (!same_layout(cur))
+        allocate(cur);
+
+    // the output goes to dst and to the ring, it is a reference of the next frames
+    InterpPicture keep = ring_picture(m_head);
+    InterpPicture refs[DENOISE_REFS];
+    const int nb_refs = m_maxWeight > 0 ? m_count : 0;
+    for (int k = 0; k < nb_refs; k++)
+        refs[k] = ring_picture((m_head - 1 - k + 2 * DENOISE_REFS) % DENOISE_REFS);
+
+    const bool bSimd = simd_level() != SimdLevel::Scalar;
+    if (nb_refs > 0)
+    {
+        cv::parallel_for_(cv::Range(0, m_blocksY), [&](const cv::Range& rows) {
+            for (int by = rows.start; by < rows.end; by++)
+                gate_row(by, cur, refs, nb_refs, bSimd);
+        });
+        update_gates(nb_refs);
+    }
+
+    cv::parallel_for_(cv::Range(0, m_blocksY), [&](const cv::Range& rows) {
+        for (int by = rows.start; by < rows.end; by++)
+            filter_row(by, cur, refs, nb_refs, dst, keep, bSimd);
+    });
+
+    m_head = (m_head + 1) % DENOISE_REFS;
+    m_count = std::min(m_count + 1, DENOISE_REFS);
+}
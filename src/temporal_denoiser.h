@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "frame_interpolator.h"
+
+#define PRINT_DENOISE_TIME 0
+
+#define DENOISE_REFS 2   // previous outputs in the ring buffer
+#define DENOISE_BLOCK 16 // luma block size of the motion gate
+
+// strength of the temporal denoise menu
+enum class DenoiseStrength
+{
+    Off,
+    Light,
+    Medium,
+    Strong
+};
+
+// Motion adaptive temporal denoiser of 8 bits yuv frames. Each frame is pulled
+// towards the last two outputs, which are kept in a ring buffer. Per 16x16 luma
+// block the SAD against a reference gates its weight, so moving blocks keep the
+// current frame, and per pixel differences above the noise threshold are left
+// alone. The noise level is estimated from the quiet blocks. Block rows run in
+// parallel, pixels 8 at a time with SSE2.
+class TemporalDenoiser
+{
+public:
+    TemporalDenoiser() = default;
+
+public:
+    void set_strength(DenoiseStrength strength);
+    inline DenoiseStrength strength() const { return m_strength; }
+    // cur to dst, dst has the layout of cur. The first frame and frames after a
+    // reset or a layout change are copied.
+    void denoise(const InterpPicture& cur, InterpPicture& dst);
+    void reset();
+
+    inline double noise_level() const { return m_noise; } // mean difference of quiet blocks
+    inline int gated_blocks() const { return m_gatedBlocks; } // blocks with motion, not averaged
+
+    static const char* strength_name(DenoiseStrength strength);
+
+private:
+    typedef struct BlockGate
+    {
+        int16_t weight[DENOISE_REFS]; // of each reference, 1/128
+    } BlockGate;
+
+    bool same_layout(const InterpPicture& pic) const;
+    void allocate(const InterpPicture& pic);
+    InterpPicture ring_picture(int slot);
+    void gate_row(int by, const InterpPicture& cur, const InterpPicture* refs, int nb_refs, bool bSimd);
+    void update_gates(int nb_refs);
+    void filter_row(int by, const InterpPicture& cur, const InterpPicture* refs, int nb_refs, InterpPicture& dst,
+                    InterpPicture& keep, bool bSimd) const;
+
+private:
+    DenoiseStrength m_strength{DenoiseStrength::Off};
+    int m_maxWeight{0}; // 1/128
+
+    InterpPicture m_layout;                             // of the frames in the ring
+    std::vector<uint8_t> m_ring[DENOISE_REFS][4];       // planes of the previous outputs
+    int m_head{0};                                      // slot of the next output
+    int m_count{0};                                     // valid references
+
+    int m_blocksX{0};
+    int m_blocksY{0};
+    std::vector<int> m_sads[DENOISE_REFS]; // mean difference of each block, 1/256
+    std::vector<BlockGate> m_gates;
+    double m_noise{0};
+    int m_threshold{8}; // per pixel difference kept as detail
+    int m_gatedBlocks{0};
+};
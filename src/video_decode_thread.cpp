@@ -3,11 +3,39 @@
 //
 //      Copy Right @ Steven Huang. All rights reserved.
 //
-// Video decode thread. This section includes queues
-// and dxva2 hardware transmit decoded frame.
+// Video decode thread. This section includes queues,
+// dxva2 hardware transmit decoded frame and the video
+// filter graph of the filters menu. Interlaced sources get
+// bwdif in front of the filters. Optional temporal denoise
+// of the filtered frames and motion compensated frames in
+// between decoded ones for low frame rates.
 // ***********************************************************/
 
+#include <QElapsedTimer>
 #include "video_decode_thread.h"
+#include "avframe_operations.h"
+
+#define DEINTERLACE_PROGRESSIVE -2
+
+// bwdif parity of an interlaced frame, -1 if the frame is flagged, else by the
+// field order of the stream for encoders that do not flag their frames
+static int interlaced_parity(const AVStream* st, const AVFrame* frame)
+{
+    if (frame->flags & AV_FRAME_FLAG_INTERLACED)
+        return -1;
+
+    switch (st->codecpar->field_order)
+    {
+        case AV_FIELD_TT: // top field coded and displayed first
+        case AV_FIELD_BT:
+            return 0;
+        case AV_FIELD_BB:
+        case AV_FIELD_TB:
+            return 1;
+        default:
+            return DEINTERLACE_PROGRESSIVE;
+    }
+}
 
 VideoDecodeThread::VideoDecodeThread(QObject* parent, VideoState* pState)
     : QThread(parent), m_pState(pState)
@@ -32,17 +60,24 @@ void VideoDecodeThread::run()
     AVRational frame_rate = av_guess_frame_rate(is->ic, is->video_st, nullptr);
 
 #if USE_AVFILTER_VIDEO
-    // AVFilterGraph* graph = nullptr;
     AVFilterContext *filt_out = nullptr, *filt_in = nullptr;
+    char* vfilters = nullptr; // graph description the current graph was built from
     int last_w = 0;
     int last_h = 0;
     enum AVPixelFormat last_format = AV_PIX_FMT_NONE;
     int last_serial = -1;
     int last_vfilter_idx = 0;
+    // detection sticks for the stream, mixed content switches the graph once
+    // from the stream field order to the frame flags at most
+    int deint_parity = DEINTERLACE_PROGRESSIVE;
+    int last_deint_parity = DEINTERLACE_PROGRESSIVE;
+    double filter_start, filter_time;
+    int filter_frames;
 #endif
 
-    if (!frame)
-        return;
+    m_prevFrame = av_frame_alloc();
+    if (!frame || !sw_frame || !m_prevFrame)
+        goto the_end;
 
     for (;;)
     {
@@ -55,10 +90,33 @@ void VideoDecodeThread::run()
         if (!ret)
             continue;
 
+        tmp_frame = frame;
+        if (frame->format == AV_PIX_FMT_DXVA2_VLD) // DXVA2 hardware decode frame
+        {
+            // filters and the play thread work on system memory frames
+            ret = av_hwframe_transfer_data(sw_frame, frame, 0);
+            if (ret < 0)
+            {
+                av_log(nullptr, AV_LOG_WARNING, "Error transferring the data to system memory\n");
+                goto the_end;
+            }
+            av_frame_copy_props(sw_frame, frame);
+            av_frame_unref(frame);
+            tmp_frame = sw_frame;
+        }
+
 #if USE_AVFILTER_VIDEO
-        if (last_w != frame->width || last_h != frame->height ||
-            last_format != frame->format || last_serial != is->viddec.pkt_serial ||
-            last_vfilter_idx != is->vfilter_idx || is->req_vfilter_reconfigure)
+        if (deint_parity != -1)
+        {
+            int parity = interlaced_parity(is->video_st, tmp_frame);
+            if (parity == -1 || deint_parity == DEINTERLACE_PROGRESSIVE)
+                deint_parity = parity;
+        }
+
+        if (is->req_vfilter_reconfigure || last_w != tmp_frame->width || last_h != tmp_frame->height ||
+            last_format != tmp_frame->format || last_serial != is->viddec.pkt_serial ||
+            last_vfilter_idx != is->vfilter_idx ||
+            (is->deinterlace_mode != int(DeinterlaceMode::Off) && last_deint_parity != deint_parity))
         {
             av_log(
                 nullptr, AV_LOG_DEBUG,
@@ -66,44 +124,90 @@ void VideoDecodeThread::run()
                 "size:%dx%d format:%s serial:%d\n",
                 last_w, last_h,
                 (const char*)av_x_if_null(av_get_pix_fmt_name(last_format), "none"),
-                last_serial, frame->width, frame->height,
+                last_serial, tmp_frame->width, tmp_frame->height,
                 (const char*)av_x_if_null(
-                    av_get_pix_fmt_name((AVPixelFormat)frame->format), "none"),
+                    av_get_pix_fmt_name((AVPixelFormat)tmp_frame->format), "none"),
                 is->viddec.pkt_serial);
-            avfilter_graph_free(&is->vgraph);
-            is->vgraph = avfilter_graph_alloc();
-            if (!is->vgraph)
+
+            is->req_vfilter_reconfigure = 0;
+            av_freep(&vfilters);
+            vfilters = get_video_filters(is);
+
+            auto mode = DeinterlaceMode(is->deinterlace_mode);
+            is->deinterlacing = mode != DeinterlaceMode::Off && deint_parity != DEINTERLACE_PROGRESSIVE;
+            if (is->deinterlacing)
             {
-                ret = AVERROR(ENOMEM);
-                goto the_end;
+                // first, the other filters get progressive frames
+                auto desc = deinterlace_description(mode, deint_parity);
+                if (vfilters)
+                    desc += QString(",") + vfilters;
+                av_freep(&vfilters);
+                vfilters = av_strdup(desc.toUtf8().constData());
+                qDebug("interlaced video, filters: %s", vfilters);
             }
-            is->vgraph->nb_threads = 0;
-            if ((ret = configure_video_filters(is->vgraph, is, is->vfilters, frame)) <
-                0)
+
+            avfilter_graph_free(&is->vgraph);
+            filt_in = filt_out = nullptr;
+            if (vfilters)
             {
-                goto the_end;
+                is->vgraph = avfilter_graph_alloc();
+                if (!is->vgraph)
+                {
+                    ret = AVERROR(ENOMEM);
+                    goto the_end;
+                }
+                is->vgraph->nb_threads = av_cpu_count(); // slice threads of each filter
+                if ((ret = configure_video_filters(is->vgraph, is, vfilters, tmp_frame)) < 0)
+                {
+                    // a bad description must not stop playing, go on unfiltered
+                    qWarning("video filters \"%s\" failed: %d", vfilters, ret);
+                    avfilter_graph_free(&is->vgraph);
+                }
+                else
+                {
+                    filt_in = is->in_video_filter;
+                    filt_out = is->out_video_filter;
+                }
             }
-            filt_in = is->in_video_filter;
-            filt_out = is->out_video_filter;
-            last_w = frame->width;
-            last_h = frame->height;
-            last_format = (AVPixelFormat)frame->format;
+            last_w = tmp_frame->width;
+            last_h = tmp_frame->height;
+            last_format = (AVPixelFormat)tmp_frame->format;
             last_serial = is->viddec.pkt_serial;
             last_vfilter_idx = is->vfilter_idx;
-            frame_rate = av_buffersink_get_frame_rate(filt_out);
+            last_deint_parity = deint_parity;
+            frame_rate = filt_out ? av_buffersink_get_frame_rate(filt_out)
+                                  : av_guess_frame_rate(is->ic, is->video_st, nullptr);
+            tb = filt_out ? av_buffersink_get_time_base(filt_out) : is->video_st->time_base;
+            is->frame_last_filter_delay = 0;
+            is->vfilter_time = 0;
+        }
 
-            is->req_vfilter_reconfigure = 0;
+        if (!filt_in)
+        {
+            // no filters, the decoded frame is played as is
+            duration = (frame_rate.num && frame_rate.den ? av_q2d({frame_rate.den, frame_rate.num}) : 0);
+            pts = (tmp_frame->pts == AV_NOPTS_VALUE) ? NAN : tmp_frame->pts * av_q2d(tb);
+            ret = queue_frame(is, tmp_frame, pts, duration, tmp_frame->pkt_pos, is->viddec.pkt_serial);
+            av_frame_unref(tmp_frame);
+            if (ret < 0)
+                goto the_end;
+            continue;
         }
 
-        ret = av_buffersrc_add_frame(filt_in, frame);
+        filter_start = av_gettime_relative() / 1000000.0;
+        ret = av_buffersrc_add_frame(filt_in, tmp_frame);
         if (ret < 0)
             goto the_end;
+        // graph time only, queue_picture waits for the play thread
+        filter_time = av_gettime_relative() / 1000000.0 - filter_start;
+        filter_frames = 0;
 
         while (ret >= 0)
         {
             is->frame_last_returned_time = av_gettime_relative() / 1000000.0;
 
             ret = av_buffersink_get_frame_flags(filt_out, frame, 0);
+            filter_time += av_gettime_relative() / 1000000.0 - is->frame_last_returned_time;
             if (ret < 0)
             {
                 if (ret == AVERROR_EOF)
@@ -111,48 +215,36 @@ void VideoDecodeThread::run()
                 ret = 0;
                 break;
             }
+            filter_frames++;
 
             is->frame_last_filter_delay =
                 av_gettime_relative() / 1000000.0 - is->frame_last_returned_time;
             if (fabs(is->frame_last_filter_delay) > AV_NOSYNC_THRESHOLD / 10.0)
                 is->frame_last_filter_delay = 0;
             tb = av_buffersink_get_time_base(filt_out);
-#endif
 
-#if 0
-            duration = (frame_rate.num && frame_rate.den ? av_q2d(AVRational{frame_rate.den, frame_rate.num}) : 0);
+            duration = (frame_rate.num && frame_rate.den ? av_q2d({frame_rate.den, frame_rate.num}) : 0);
             pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
-            ret = queue_picture(is, frame, pts, duration, frame->pkt_pos, is->viddec.pkt_serial);
+            ret = queue_frame(is, frame, pts, duration, frame->pkt_pos, is->viddec.pkt_serial);
             av_frame_unref(frame);
-#else
 
-        tmp_frame = frame;
-        if (frame->format == AV_PIX_FMT_DXVA2_VLD) // DXVA2 hardware decode frame
-        {
-            ret = av_hwframe_transfer_data(sw_frame, frame, 0);
-            if (ret < 0)
-            {
-                av_log(nullptr, AV_LOG_WARNING, "Error transferring the data to system memory\n");
-                goto the_end;
-            }
-            // sw_frame->hw_frames_ctx = frame->hw_frames_ctx;
-            sw_frame->pts = frame->pts;
-            sw_frame->pkt_dts = frame->pkt_dts;
-            tmp_frame = sw_frame;
+            if (is->videoq.serial != is->viddec.pkt_serial)
+                break;
         }
 
+        if (filter_frames > 0)
+        {
+            // field rate output makes two frames of one
+            double frame_time = filter_time / filter_frames;
+            is->vfilter_time = is->vfilter_time > 0 ? is->vfilter_time * 0.9 + frame_time * 0.1 : frame_time;
+        }
+#else
         duration = (frame_rate.num && frame_rate.den ? av_q2d({frame_rate.den, frame_rate.num}) : 0);
-        pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
-        ret = queue_picture(is, tmp_frame, pts, duration, frame->pkt_pos, is->viddec.pkt_serial);
+        pts = (tmp_frame->pts == AV_NOPTS_VALUE) ? NAN : tmp_frame->pts * av_q2d(tb);
+        ret = queue_frame(is, tmp_frame, pts, duration, tmp_frame->pkt_pos, is->viddec.pkt_serial);
         av_frame_unref(tmp_frame);
 #endif
 
-#if USE_AVFILTER_VIDEO
-            if (is->videoq.serial != is->viddec.pkt_serial)
-                break;
-        }
-#endif
-
         if (ret < 0)
             goto the_end;
     }
@@ -161,14 +253,224 @@ the_end:
 
 #if USE_AVFILTER_VIDEO
     avfilter_graph_free(&is->vgraph);
-    if (is->vfilters)
-    {
-        av_free(is->vfilters);
-        is->vfilters = nullptr;
-    }
+    av_freep(&vfilters);
+    set_video_filters(is, nullptr);
+    is->deinterlacing = 0;
 #endif
     av_frame_free(&frame);
     av_frame_free(&sw_frame);
+    av_frame_free(&m_prevFrame);
     qDebug("-------- video decode thread exit.");
     return;
 }
+
+int VideoDecodeThread::denoise_frame(AVFrame* frame, int serial)
+{
+    m_denoiser.set_strength(DenoiseStrength(m_denoiseStrength.load()));
+    if (m_denoiser.strength() == DenoiseStrength::Off)
+        return 0;
+
+    // the references are from before the seek
+    if (serial != m_denoiseSerial)
+    {
+        m_denoiser.reset();
+        m_denoiseSerial = serial;
+    }
+
+    InterpPicture cur, dst;
+    if (!avframe_interp_picture(frame, cur))
+        return 0; // high bit depth and packed formats are shown as they are
+
+    // the decoder may still reference frame, the output goes to a new buffer
+    AVFrame* out = av_frame_alloc();
+    if (!out)
+        return AVERROR(ENOMEM);
+
+    out->format = frame->format;
+    out->width = frame->width;
+    out->height = frame->height;
+    int ret = av_frame_get_buffer(out, 0);
+    if (ret < 0 || (ret = av_frame_copy_props(out, frame)) < 0 || !avframe_interp_picture(out, dst))
+    {
+        av_frame_free(&out);
+        return ret;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    m_denoiser.denoise(cur, dst);
+    qint64 nsecs = timer.nsecsElapsed();
+
+    av_frame_unref(frame);
+    av_frame_move_ref(frame, out);
+    av_frame_free(&out);
+
+    {
+        QMutexLocker locker(&m_statsMutex);
+        m_denoiseNsecs += nsecs;
+        m_denoiseFrames++;
+        m_denoiseNoise = m_denoiser.noise_level();
+    }
+
+#if PRINT_DENOISE_TIME
+    qDebug("denoise(%s, noise %.2f, %d blocks gated): %.3f ms", TemporalDenoiser::strength_name(m_denoiser.strength()),
+           m_denoiser.noise_level(), m_denoiser.gated_blocks(), nsecs / 1000000.0);
+#endif
+    return 0;
+}
+
+int VideoDecodeThread::queue_frame(VideoState* is, AVFrame* frame, double pts, double duration, int64_t pos,
+                                   int serial)
+{
+    // before interpolation, the pairs should be clean
+    int ret = denoise_frame(frame, serial);
+    if (ret < 0)
+        return ret;
+
+    int fps = m_interpFps;
+    if (fps > 0 && !isnan(pts))
+    {
+        ret = queue_interpolated(is, frame, pts, pos, serial, fps);
+        if (ret < 0)
+            return ret;
+
+        // queue_picture takes the frame, keep a reference for the next pair
+        av_frame_unref(m_prevFrame);
+        if (av_frame_ref(m_prevFrame, frame) >= 0)
+        {
+            m_prevPts = pts;
+            m_prevSerial = serial;
+        }
+    }
+    else
+    {
+        av_frame_unref(m_prevFrame);
+        m_bPrevEstimated = false;
+    }
+
+    return queue_picture(is, frame, pts, duration, pos, serial);
+}
+
+int VideoDecodeThread::queue_interpolated(VideoState* is, const AVFrame* frame, double pts, int64_t pos, int serial,
+                                          int fps)
+{
+    bool bPrevEstimated = m_bPrevEstimated;
+    m_bPrevEstimated = false;
+
+    InterpPicture prev, next;
+    if (!m_prevFrame->buf[0] || m_prevSerial != serial || m_prevFrame->format != frame->format ||
+        !avframe_interp_picture(m_prevFrame, prev) || !avframe_interp_picture(frame, next))
+        return 0;
+
+    // only if the display is faster than the video, below 1x a display frame
+    // covers less of the stream
+    const double speed = is->audio_speed > 0 ? is->audio_speed : 1.0;
+    const double step = speed / fps;
+    const double gap = pts - m_prevPts;
+    if (gap < step * 1.5 || gap > is->max_frame_duration)
+        return 0;
+
+    if (m_skipCountdown > 0)
+    {
+        m_skipCountdown--;
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // motion costs more than blending, once over budget it is tried again now and then
+    const bool bMotion = m_blendCountdown == 0;
+    m_bPrevEstimated = true;
+    if (!m_interpolator.estimate(prev, next, bMotion, bPrevEstimated))
+        return 0; // scene change
+    qint64 nsecs = timer.nsecsElapsed();
+
+    // on the output grid of the display, 24 fps at 60 Hz alternates 1 and 2 frames
+    int frames = 0, ret = 0;
+    for (double t = (floor(m_prevPts / step) + 1) * step; t < pts - step * 0.5 && frames < INTERP_MAX_FRAMES;
+         t += step)
+    {
+        if (t < m_prevPts + step * 0.5)
+            continue;
+
+        AVFrame* out = av_frame_alloc();
+        if (!out)
+            return AVERROR(ENOMEM);
+
+        out->format = frame->format;
+        out->width = frame->width;
+        out->height = frame->height;
+        InterpPicture dst;
+        if (av_frame_get_buffer(out, 0) < 0 || av_frame_copy_props(out, frame) < 0 ||
+            !avframe_interp_picture(out, dst))
+        {
+            av_frame_free(&out);
+            break;
+        }
+
+        timer.restart();
+        m_interpolator.interpolate(prev, next, (t - m_prevPts) / gap, dst);
+        nsecs += timer.nsecsElapsed();
+
+        ret = queue_picture(is, out, t, step, pos, serial);
+        av_frame_free(&out);
+        if (ret < 0)
+            break;
+        frames++;
+
+        if (is->videoq.serial != serial)
+            break;
+    }
+
+    // the next decoded frame waits for this, keep time for decoding
+    const double budget = gap / speed * INTERP_BUDGET;
+    if (nsecs / 1000000000.0 > budget)
+    {
+        if (bMotion)
+            m_blendCountdown = INTERP_RETRY_FRAMES;
+        else
+            m_skipCountdown = INTERP_RETRY_FRAMES;
+        qDebug("frame interpolation over budget (%.1f ms of %.1f ms), %s", nsecs / 1000000.0, budget * 1000,
+               bMotion ? "blending" : "paused");
+    }
+    else if (!bMotion && m_blendCountdown > 0)
+    {
+        m_blendCountdown--;
+    }
+
+    {
+        QMutexLocker locker(&m_statsMutex);
+        m_interpNsecs += nsecs;
+        m_interpFrames += frames;
+        if (!bMotion)
+            m_interpBlended += frames;
+    }
+
+#if PRINT_INTERPOLATION_TIME
+    qDebug("interpolation(%s, %d frames, %d of %d blocks blended): %.3f ms", bMotion ? "motion" : "blend", frames,
+           m_interpolator.blended_blocks(), m_interpolator.blocks(), nsecs / 1000000.0);
+#endif
+    return ret;
+}
+
+void VideoDecodeThread::take_interpolation_stats(int& frames, int& blended, double& ms)
+{
+    QMutexLocker locker(&m_statsMutex);
+    frames = m_interpFrames;
+    blended = m_interpBlended;
+    ms = frames ? m_interpNsecs / 1000000.0 / frames : 0;
+    m_interpNsecs = 0;
+    m_interpFrames = 0;
+    m_interpBlended = 0;
+}
+
+void VideoDecodeThread::take_denoise_stats(int& frames, double& ms, double& noise)
+{
+    QMutexLocker locker(&m_statsMutex);
+    frames = m_denoiseFrames;
+    ms = frames ? m_denoiseNsecs / 1000000.0 / frames : 0;
+    noise = m_denoiseNoise;
+    m_denoiseNsecs = 0;
+    m_denoiseFrames = 0;
+}
@@ -1,7 +1,16 @@
 #pragma once
 
+#include <QMutex>
 #include <QThread>
+#include <atomic>
+#include "frame_interpolator.h"
 #include "packets_sync.h"
+#include "temporal_denoiser.h"
+#include "video_filters.h"
+
+#define INTERP_MAX_FRAMES 7      // between two decoded frames
+#define INTERP_BUDGET 0.5        // share of the display time of a decoded frame
+#define INTERP_RETRY_FRAMES 100  // decoded frames before the slower mode is tried again
 
 class VideoDecodeThread : public QThread
 {
@@ -11,9 +20,44 @@ public:
     explicit VideoDecodeThread(QObject* parent = nullptr, VideoState* pState = nullptr);
     ~VideoDecodeThread();
 
+public:
+    // frames in between the decoded ones up to the display rate, 0 is off, set by gui
+    inline void set_interpolation(int fps) { m_interpFps = fps; }
+    // interpolated frames since the last call, the blended ones of them and the average cost
+    void take_interpolation_stats(int& frames, int& blended, double& ms);
+    // DenoiseStrength of the decoded frames, set by gui
+    inline void set_denoise(DenoiseStrength strength) { m_denoiseStrength = int(strength); }
+    // denoised frames since the last call, their average cost and the estimated noise
+    void take_denoise_stats(int& frames, double& ms, double& noise);
+
 protected:
     void run() override;
 
+private:
+    int denoise_frame(AVFrame* frame, int serial);
+    int queue_frame(VideoState* is, AVFrame* frame, double pts, double duration, int64_t pos, int serial);
+    int queue_interpolated(VideoState* is, const AVFrame* frame, double pts, int64_t pos, int serial, int fps);
+
 private:
     VideoState* m_pState;
+
+    std::atomic_int m_interpFps{0};
+    FrameInterpolator m_interpolator;
+    AVFrame* m_prevFrame{nullptr}; // last queued frame, first of the next pair
+    double m_prevPts{0};
+    int m_prevSerial{-1};
+    bool m_bPrevEstimated{false}; // luma of m_prevFrame is in the interpolator
+    int m_blendCountdown{0};      // pairs blended before motion is tried again
+    int m_skipCountdown{0};       // pairs shown as they are, even blending was over budget
+    QMutex m_statsMutex;          // stats, taken by gui
+    qint64 m_interpNsecs{0};
+    int m_interpFrames{0};
+    int m_interpBlended{0};
+
+    std::atomic_int m_denoiseStrength{int(DenoiseStrength::Off)};
+    TemporalDenoiser m_denoiser;
+    int m_denoiseSerial{-1};
+    qint64 m_denoiseNsecs{0};
+    int m_denoiseFrames{0};
+    double m_denoiseNoise{0};
 };
@@ -0,0 +1,213 @@
+// ***********************************************************/
+// video_effect_stage.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Subtitle overlay and CV effects off the GUI thread. Frames
+// are dropped (latest wins) when effects are slower than the
+// video, so playback and the UI keep their pace. In adaptive
+// quality expensive effects move to a smaller proxy before
+// frames have to be dropped.
+// ***********************************************************/
+
+#include "video_effect_stage.h"
+#include <algorithm>
+#include "qimage_operation.h"
+
+VideoEffectStage::VideoEffectStage(QObject* parent) : QObject(parent)
+{
+    // frames are processed in order, one at a time
+    m_pool.setMaxThreadCount(1);
+    m_pool.setExpiryTimeout(-1);
+}
+
+VideoEffectStage::~VideoEffectStage()
+{
+    clear();
+    m_pool.waitForDone();
+}
+
+void VideoEffectStage::set_effects(const std::shared_ptr<const CvEffectChain>& effects)
+{
+    QMutexLocker locker(&m_mutex);
+    m_effects = effects;
+}
+
+void VideoEffectStage::set_subtitle(const QString& subtitle)
+{
+    QMutexLocker locker(&m_mutex);
+    m_subtitle = subtitle;
+}
+
+void VideoEffectStage::set_quality(EffectQuality quality)
+{
+    m_quality = quality;
+    switch (quality)
+    {
+        case EffectQuality::Half:
+            m_proxyDivisor = 2;
+            break;
+        case EffectQuality::Quarter:
+            m_proxyDivisor = 4;
+            break;
+        default:
+            m_proxyDivisor = 1; // adaptive starts from full resolution
+            break;
+    }
+    m_averageMs = 0;
+    m_adaptSamples = 0;
+}
+
+void VideoEffectStage::set_face_tracking(bool bEnable)
+{
+    {
+        QMutexLocker locker(&m_faceMutex);
+        if (bEnable == bool(m_faceTracker))
+            return;
+    }
+
+    std::unique_ptr<FaceTracker> tracker;
+    if (bEnable)
+    {
+        tracker = std::make_unique<FaceTracker>();
+        tracker->start(QThread::LowPriority);
+    }
+
+    // replaced between frames, the worker holds m_faceMutex while it tracks
+    QMutexLocker locker(&m_faceMutex);
+    std::swap(tracker, m_faceTracker);
+    m_faces = 0;
+    // the old tracker stops with this scope, after the lock is released
+}
+
+bool VideoEffectStage::face_stats(int& faces, double& latencyMs, int& latencyFrames) const
+{
+    QMutexLocker locker(&m_faceMutex);
+    if (!m_faceTracker)
+        return false;
+
+    faces = m_faces;
+    latencyMs = m_faceTracker->detect_latency_ms();
+    latencyFrames = m_faceTracker->detect_latency_frames();
+    return true;
+}
+
+void VideoEffectStage::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_pending = QImage();
+    m_bPending = false;
+}
+
+void VideoEffectStage::take_stats(int& processed, int& dropped)
+{
+    processed = m_processed.exchange(0);
+    dropped = m_dropped.exchange(0);
+}
+
+void VideoEffectStage::submit(const QImage& image)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // frame interval of the video, the time budget of the effects
+    if (m_submitTimer.isValid())
+    {
+        double ms = m_submitTimer.nsecsElapsed() / 1000000.0;
+        if (ms < 1000) // not across pauses and seeks
+            m_frameIntervalMs = m_frameIntervalMs > 0 ? m_frameIntervalMs * 0.9 + ms * 0.1 : ms;
+    }
+    m_submitTimer.start();
+
+    if (m_bBusy)
+    {
+        if (m_bPending)
+            m_dropped++;
+
+        m_pending = image;
+        m_bPending = true;
+        return;
+    }
+
+    m_bBusy = true;
+    m_pool.start([this, image]() { process(image); });
+}
+
+void VideoEffectStage::process(QImage image)
+{
+    for (;;)
+    {
+        std::shared_ptr<const CvEffectChain> effects;
+        QString subtitle;
+        {
+            QMutexLocker locker(&m_mutex);
+            effects = m_effects;
+            subtitle = m_subtitle;
+        }
+
+        // on the source frame, so effects move the boxes along with the faces
+        {
+            QMutexLocker locker(&m_faceMutex);
+            if (m_faceTracker)
+            {
+                auto faces = m_faceTracker->track(image);
+                for (const auto& rt : faces)
+                    draw_img_rect(image, rt, QPen(Qt::red, std::max(2, image.width() / 480)));
+                m_faces = int(faces.size());
+            }
+        }
+
+        if (!subtitle.isEmpty())
+            draw_subtitle(image, subtitle);
+
+        if (effects)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            effects->apply(image, m_proxyDivisor);
+            update_proxy_divisor(*effects, timer.nsecsElapsed() / 1000000.0);
+        }
+
+        m_processed++;
+        emit frame_processed(image);
+
+        QMutexLocker locker(&m_mutex);
+        if (!m_bPending)
+        {
+            m_bBusy = false;
+            return;
+        }
+
+        image = std::move(m_pending);
+        m_pending = QImage();
+        m_bPending = false;
+    }
+}
+
+void VideoEffectStage::update_proxy_divisor(const CvEffectChain& effects, double ms)
+{
+    double average = m_adaptSamples > 0 ? m_averageMs * 0.8 + ms * 0.2 : ms;
+    m_averageMs = average;
+    m_adaptSamples++;
+
+    if (m_quality != EffectQuality::Adaptive || !effects.is_expensive() || m_adaptSamples < 8)
+        return;
+
+    double budget;
+    {
+        QMutexLocker locker(&m_mutex);
+        budget = m_frameIntervalMs > 0 ? m_frameIntervalMs : 40.0;
+    }
+
+    // a proxy of half size costs about a quarter, step once the average settled
+    int divisor = m_proxyDivisor;
+    if (average > budget * 0.9 && divisor < 4)
+        divisor *= 2;
+    else if (divisor > 1 && average * 4 < budget * 0.6)
+        divisor /= 2;
+
+    if (divisor != m_proxyDivisor)
+    {
+        m_proxyDivisor = divisor;
+        m_adaptSamples = 0;
+    }
+}
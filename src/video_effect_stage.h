@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+#include "cv_effect_chain.h"
+#include "face_tracker.h"
+
+// Worker stage between frame conversion and presentation. Subtitle overlay
+// and CV effects run on its own thread pool. One frame is processed and one
+// waits, a newer frame replaces the waiting one (latest wins).
+// Expensive effects run on a proxy of the frame, its size is fixed by the
+// quality setting or adapted to keep up with the video frame rate.
+// Face boxes are tracked and drawn on every processed frame.
+class VideoEffectStage : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VideoEffectStage(QObject* parent = Q_NULLPTR);
+    ~VideoEffectStage();
+
+public:
+    void set_effects(const std::shared_ptr<const CvEffectChain>& effects);
+    void set_subtitle(const QString& subtitle);
+    void set_quality(EffectQuality quality);
+    void set_face_tracking(bool bEnable);
+    void submit(const QImage& image);
+    void clear();
+
+    // processed and dropped frames since the last call
+    void take_stats(int& processed, int& dropped);
+    // average effect time and proxy divisor of the recent frames
+    inline double average_ms() const { return m_averageMs; }
+    inline int proxy_divisor() const { return m_proxyDivisor; }
+    // faces in the last frame and the latency of the last detection
+    bool face_stats(int& faces, double& latencyMs, int& latencyFrames) const;
+
+signals:
+    void frame_processed(const QImage&);
+
+private:
+    void process(QImage image);
+    void update_proxy_divisor(const CvEffectChain& effects, double ms);
+
+private:
+    QThreadPool m_pool;
+    QMutex m_mutex;
+    std::shared_ptr<const CvEffectChain> m_effects;
+    QString m_subtitle;
+    QImage m_pending;
+    bool m_bPending{false};
+    bool m_bBusy{false};
+
+    std::atomic_int m_processed{0};
+    std::atomic_int m_dropped{0};
+
+    std::atomic<EffectQuality> m_quality{EffectQuality::Adaptive};
+    std::atomic_int m_proxyDivisor{1};  // 1, 2 or 4, used by the worker
+    std::atomic<double> m_averageMs{0}; // moving average of the effect time
+    std::atomic_int m_adaptSamples{0};  // frames since the last divisor change
+    QElapsedTimer m_submitTimer;        // frame interval of the video, under m_mutex
+    double m_frameIntervalMs{0};
+
+    mutable QMutex m_faceMutex; // guards m_faceTracker, tracking doesn't block submit()
+    std::unique_ptr<FaceTracker> m_faceTracker;
+    std::atomic_int m_faces{0};
+};
@@ -0,0 +1,60 @@
+// ***********************************************************/
+// video_filters.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Filters menu entries mapped to libavfilter descriptions.
+// The graph runs with slice threads in the video decode
+// thread, before frames are queued for display.
+// ***********************************************************/
+
+#include <QStringList>
+#include <algorithm>
+#include "video_filters.h"
+
+static const char* filter_description(VideoFilter filter)
+{
+    switch (filter)
+    {
+        case VideoFilter::Crop: // center 4:3 of wide pictures
+            return "crop=w='min(iw,ih*4/3)':h=ih";
+        case VideoFilter::HalfSize: // cheaper filtering and converting of large videos
+            return "scale=w=iw/2:h=-2";
+        case VideoFilter::Rotate:
+            return "transpose=clock";
+        case VideoFilter::Denoise:
+            return "hqdn3d";
+        case VideoFilter::Equalizer:
+            return "eq=contrast=1.1:brightness=0.03:saturation=1.25";
+        case VideoFilter::Sharpen:
+            return "unsharp=5:5:0.8";
+        default:
+            return nullptr;
+    }
+}
+
+QString video_filters_description(std::vector<VideoFilter> filters)
+{
+    std::sort(filters.begin(), filters.end());
+    filters.erase(std::unique(filters.begin(), filters.end()), filters.end());
+
+    QStringList list;
+    for (auto filter : filters)
+    {
+        if (auto desc = filter_description(filter))
+            list << desc;
+    }
+    return list.join(",");
+}
+
+QString deinterlace_description(DeinterlaceMode mode, int parity)
+{
+    if (mode == DeinterlaceMode::Off)
+        return QString();
+
+    // bwdif is slice threaded and sharper than yadif at a similar cost
+    return QString("bwdif=mode=%1:parity=%2:deint=%3")
+        .arg(mode == DeinterlaceMode::AutoFieldRate ? "send_field" : "send_frame")
+        .arg(parity < 0 ? "auto" : (parity == 0 ? "tff" : "bff"))
+        .arg(parity < 0 ? "interlaced" : "all");
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QString>
+#include <vector>
+
+// filters of the Filters menu, run by the libavfilter graph in the video decode thread
+enum class VideoFilter
+{
+    Crop,
+    HalfSize,
+    Rotate,
+    Denoise,
+    Equalizer,
+    Sharpen
+};
+
+// filter graph description of the filters, in the order above, empty if none
+QString video_filters_description(std::vector<VideoFilter> filters);
+
+// deinterlacing of the Filters menu, the decode thread adds bwdif in front of
+// the filters once it finds the source interlaced
+enum class DeinterlaceMode
+{
+    Off,
+    Auto,         // one frame per frame
+    AutoFieldRate // one frame per field, 50/60p
+};
+
+// bwdif description, parity -1 follows the flags of each frame and leaves
+// progressive frames alone, 0 top and 1 bottom field first deinterlaces all
+// frames, for streams with a field order but unflagged frames
+QString deinterlace_description(DeinterlaceMode mode, int parity = -1);
@@ -3,15 +3,29 @@
 //
 //      Copy Right @ Steven Huang. All rights reserved.
 //
-// video show label.
+// video show label. Frames are painted directly into the
+// letterboxed video rect, only that rect is repainted per frame.
+// Yuv frames are shown by a child QVideoWidget when enabled.
+// Wheel zooms and dragging pans, the visible source rect is
+// sent to the play thread so only that part is converted.
 // ***********************************************************/
 
 #include <QApplication>
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QVideoSink>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
 #include "video_label.h"
 #include "mainwindow.h"
 
-VideoLabel::VideoLabel(QWidget* parent) : QLabel(parent)
+VideoLabel::VideoLabel(QWidget* parent) : QWidget(parent)
 {
+    // every pixel is painted in paintEvent, skip background erasing
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setAttribute(Qt::WA_NoSystemBackground);
 }
 
 VideoLabel::~VideoLabel()
@@ -24,6 +38,10 @@ void VideoLabel::keyPressEvent(QKeyEvent* event)
     {
         case Qt::Key_Escape:
         case Qt::Key_F:
+        case Qt::Key_PageUp:
+        case Qt::Key_PageDown:
+        case Qt::Key_BracketLeft:
+        case Qt::Key_BracketRight:
         {
             QApplication::sendEvent(parent()->parent(), event);
         }
@@ -58,3 +76,187 @@ void VideoLabel::show_fullscreen(bool bFullscreen)
         showNormal();
     }
 }
+
+void VideoLabel::set_image(const QImage& img)
+{
+    if (img.isNull())
+        return;
+
+    if (is_sink_output())
+        m_videoWidget->hide();
+
+    bool bSizeChanged = (img.size() != m_image.size());
+    m_image = img; // implicitly shared, no pixel copy
+
+    if (bSizeChanged)
+    {
+        update_video_rect();
+        update(); // letterbox borders may change
+    }
+    else
+    {
+        update(m_videoRect);
+    }
+}
+
+void VideoLabel::set_video_frame(const QVideoFrame& frame)
+{
+    if (!m_videoWidget)
+    {
+        m_videoWidget = std::make_unique<QVideoWidget>(this);
+        m_videoWidget->setAspectRatioMode(Qt::KeepAspectRatio);
+        m_videoWidget->setGeometry(rect());
+    }
+
+    if (!m_videoWidget->isVisible())
+        m_videoWidget->show();
+
+    m_videoWidget->videoSink()->setVideoFrame(frame);
+}
+
+void VideoLabel::update_video_rect()
+{
+    if (m_image.isNull())
+    {
+        m_videoRect = rect();
+        return;
+    }
+
+    auto sz = m_image.size().scaled(size(), Qt::KeepAspectRatio);
+    m_videoRect = QRect(QPoint((width() - sz.width()) / 2, (height() - sz.height()) / 2), sz);
+}
+
+void VideoLabel::resizeEvent(QResizeEvent* event)
+{
+    update_video_rect();
+    if (m_videoWidget)
+        m_videoWidget->setGeometry(rect());
+    QWidget::resizeEvent(event);
+
+    emit view_changed(roi(), display_size());
+}
+
+QRectF VideoLabel::roi() const
+{
+    return QRectF(m_roiOrigin, QSizeF(1.0 / m_zoom, 1.0 / m_zoom));
+}
+
+QSize VideoLabel::display_size() const
+{
+    return size() * devicePixelRatioF();
+}
+
+void VideoLabel::reset_zoom()
+{
+    m_zoom = 1.0;
+    m_roiOrigin = QPointF(0, 0);
+    m_bDragging = false;
+    unsetCursor();
+
+    emit view_changed(roi(), display_size());
+}
+
+void VideoLabel::set_roi_origin(const QPointF& pt)
+{
+    double max = 1.0 - 1.0 / m_zoom;
+    m_roiOrigin = QPointF(std::clamp(pt.x(), 0.0, max), std::clamp(pt.y(), 0.0, max));
+
+    emit view_changed(roi(), display_size());
+}
+
+void VideoLabel::wheelEvent(QWheelEvent* event)
+{
+    if (m_image.isNull() || m_videoRect.isEmpty())
+    {
+        QWidget::wheelEvent(event);
+        return;
+    }
+
+    int steps = event->angleDelta().y() / 120;
+    if (steps == 0)
+        return;
+
+    double zoom = std::clamp(m_zoom * std::pow(1.25, steps), 1.0, 16.0);
+    if (zoom == m_zoom)
+        return;
+
+    // keep the source point under the cursor in place
+    auto pos = event->position() - QPointF(m_videoRect.topLeft());
+    QPointF ratio(std::clamp(pos.x() / m_videoRect.width(), 0.0, 1.0),
+                  std::clamp(pos.y() / m_videoRect.height(), 0.0, 1.0));
+    auto pt = m_roiOrigin + ratio / m_zoom;
+
+    m_zoom = zoom;
+    if (m_zoom == 1.0)
+        unsetCursor();
+    else
+        setCursor(Qt::OpenHandCursor);
+
+    set_roi_origin(pt - ratio / m_zoom);
+    event->accept();
+}
+
+void VideoLabel::mousePressEvent(QMouseEvent* event)
+{
+    if (m_zoom > 1.0 && event->button() == Qt::LeftButton)
+    {
+        m_bDragging = true;
+        m_dragPos = event->position().toPoint();
+        setCursor(Qt::ClosedHandCursor);
+        return;
+    }
+    QWidget::mousePressEvent(event);
+}
+
+void VideoLabel::mouseMoveEvent(QMouseEvent* event)
+{
+    if (m_bDragging && !m_videoRect.isEmpty())
+    {
+        auto pos = event->position().toPoint();
+        auto delta = pos - m_dragPos;
+        m_dragPos = pos;
+
+        QPointF d(double(delta.x()) / m_videoRect.width(), double(delta.y()) / m_videoRect.height());
+        set_roi_origin(m_roiOrigin - d / m_zoom);
+        return;
+    }
+    QWidget::mouseMoveEvent(event);
+}
+
+void VideoLabel::mouseReleaseEvent(QMouseEvent* event)
+{
+    if (m_bDragging && event->button() == Qt::LeftButton)
+    {
+        m_bDragging = false;
+        setCursor(Qt::OpenHandCursor);
+        return;
+    }
+    QWidget::mouseReleaseEvent(event);
+}
+
+void VideoLabel::paintEvent(QPaintEvent* event)
+{
+#if PRINT_VIDEO_PAINT_TIME
+    QElapsedTimer timer;
+    timer.start();
+#endif
+
+    QPainter painter(this);
+
+    // letterbox borders, only painted when exposed
+    for (const auto& rt : event->region().subtracted(m_videoRect))
+        painter.fillRect(rt, Qt::black);
+
+    if (!m_image.isNull() && event->region().intersects(m_videoRect))
+    {
+        // upscaled frames come at the size of the rect in device pixels
+        if (m_videoRect.size() * devicePixelRatioF() != m_image.size())
+            painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawImage(m_videoRect, m_image);
+    }
+
+#if PRINT_VIDEO_PAINT_TIME
+    qDebug("video paint (%dx%d -> %dx%d): %.3f ms", m_image.width(), m_image.height(),
+           m_videoRect.width(), m_videoRect.height(), timer.nsecsElapsed() / 1000000.0);
+#endif
+}
@@ -1,9 +1,15 @@
 #pragma once
 
+#include <QImage>
 #include <QKeyEvent>
-#include <QLabel>
+#include <QVideoFrame>
+#include <QVideoWidget>
+#include <QWidget>
+#include <memory>
 
-class VideoLabel : public QLabel
+#define PRINT_VIDEO_PAINT_TIME 0
+
+class VideoLabel : public QWidget
 {
     Q_OBJECT
 
@@ -13,8 +19,38 @@ public:
 
 public:
     void show_fullscreen(bool bFullscreen = true);
+    void set_image(const QImage& img);
+    void set_video_frame(const QVideoFrame& frame);
+    inline bool is_sink_output() const { return m_videoWidget && m_videoWidget->isVisible(); }
+    void reset_zoom();
+    QRectF roi() const;
+    QSize display_size() const;
+    inline const QRect& video_rect() const { return m_videoRect; }
+
+signals:
+    void view_changed(const QRectF& roi, const QSize& displaySize);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
 
 private:
     void keyPressEvent(QKeyEvent* event) override;
     void mouseDoubleClickEvent(QMouseEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void update_video_rect();
+    void set_roi_origin(const QPointF& pt);
+
+private:
+    QImage m_image;    // current frame, shared with the video play thread
+    QRect m_videoRect; // letterboxed target rect of the current frame
+    std::unique_ptr<QVideoWidget> m_videoWidget; // renders yuv frames, covers this widget when used
+
+    double m_zoom{1.0};           // 1.0 shows the whole frame
+    QPointF m_roiOrigin{0, 0};    // top left of the visible source rect, normalized
+    QPoint m_dragPos;             // last mouse position while panning
+    bool m_bDragging{false};
 };
@@ -1,14 +1,21 @@
-// ***********************************************************/
+﻿// ***********************************************************/
 // video_play_thread.cpp
 //
 //      Copy Right @ Steven Huang. All rights reserved.
 //
 // Video play thread. This section includes key code for
 // synchronizing video frames and audio using pts/dts,
-//  as well as subtitle processing.
+//  as well as subtitle processing. Low resolution frames
+// can be upscaled to the display size with edge directed
+// interpolation instead of being scaled by painting. In the
+// a/b compare mode the frame of the second file at the same
+// time is measured against each frame and shown with it.
 // ***********************************************************/
 
+#include <QElapsedTimer>
+#include <cmath>
 #include "video_play_thread.h"
+#include "avframe_operations.h"
 
 extern int framedrop;
 
@@ -23,6 +30,9 @@ VideoPlayThread::VideoPlayThread(QObject* parent, VideoState* pState)
 VideoPlayThread::~VideoPlayThread()
 {
     stop_thread();
+    stop_compare();
+    av_frame_free(&m_compareIn);
+    av_frame_free(&m_compareOut);
     final_resample_param();
 }
 
@@ -441,8 +451,6 @@ void VideoPlayThread::video_image_display(VideoState* is)
         }
     }
 
-    AVFrame* pFrameRGB = pResample->pFrameRGB; // dst
-    AVCodecContext* pVideoCtx = is->viddec.avctx;
     AVFrame* pFrame = vp->frame;
 
     // AVPixelFormat fmt = (AVPixelFormat)pFrame->format; // 0
@@ -455,16 +463,637 @@ void VideoPlayThread::video_image_display(VideoState* is)
     // qDebug("frame w:%d,h:%d, pts:%lld, dts:%lld", pVideoCtx->width,
     // pVideoCtx->height, pFrame->pts, pFrame->pkt_dts);
 
+#if PRINT_VIDEO_CONVERT_TIME
+    QElapsedTimer timer;
+    timer.start();
+#endif
+
+    QRect crop = update_crop_detect(pFrame);
+    update_scopes(pFrame);
+
+    // a and b in one picture, uncropped so both sides stay aligned
+    if (video_compare_frame(is, vp, pFrame))
+        crop = QRect();
+    int rotation = (display_matrix_rotation(pFrame, is->video_st) + m_manualRotation) % 360;
+
+    // pq/hlg frames are tone mapped, swscale would show them washed out
+    if (m_toneMapCurve != ToneMapCurve::Off && video_tone_map_display(pFrame, crop, rotation))
+    {
+#if PRINT_VIDEO_CONVERT_TIME
+        print_convert_time(false, timer.nsecsElapsed());
+#endif
+        return;
+    }
+
+    // yuv planes go to Qt's renderer directly, rgb path is the fallback
+    if (m_bSinkOutput && crop.isNull() && rotation == 0 && !is_view_zoomed() && video_sink_display(pFrame))
+    {
+#if PRINT_VIDEO_CONVERT_TIME
+        print_convert_time(true, timer.nsecsElapsed());
+#endif
+        return;
+    }
+
+    // gray effects only need luma, convert the y plane and drop chroma
+    if (m_bLumaOutput && rotation == 0 && video_luma_display(pFrame, crop))
+    {
+#if PRINT_VIDEO_CONVERT_TIME
+        print_convert_time(false, timer.nsecsElapsed());
+#endif
+        return;
+    }
+
+    // small frames are upscaled here, painting would only smooth them
+    if (m_bUpscale && rotation == 0 && video_upscaled_display(pFrame, crop))
+    {
+#if PRINT_VIDEO_CONVERT_TIME
+        print_convert_time(false, timer.nsecsElapsed());
+#endif
+        return;
+    }
+
+    // only the visible part, at most at view resolution, rotated if needed
+    if (video_roi_display(pFrame, crop, rotation))
+    {
+#if PRINT_VIDEO_CONVERT_TIME
+        print_convert_time(false, timer.nsecsElapsed());
+#endif
+        return;
+    }
+
+    // video filters may change size and format of the decoded frames
+    pResample->sws_ctx = sws_getCachedContext(pResample->sws_ctx, pFrame->width, pFrame->height,
+                                              AVPixelFormat(pFrame->format), pFrame->width, pFrame->height,
+                                              AV_PIX_FMT_RGB24, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!pResample->sws_ctx)
+        return;
+
+    // convert straight into the image buffer which is shared with the GUI thread
+    QImage img(pFrame->width, pFrame->height, QImage::Format_RGB888);
+    uint8_t* dst[4] = {img.bits(), nullptr, nullptr, nullptr};
+    int dst_linesize[4] = {(int)img.bytesPerLine(), 0, 0, 0};
+
     sws_scale(pResample->sws_ctx, (uint8_t const* const*)pFrame->data, pFrame->linesize, 0,
-              pVideoCtx->height, pFrameRGB->data, pFrameRGB->linesize);
+              pFrame->height, dst, dst_linesize);
+
+#if PRINT_VIDEO_CONVERT_TIME
+    print_convert_time(false, timer.nsecsElapsed());
+#endif
+
+    emit frame_ready(img);
+}
+
+bool VideoPlayThread::video_sink_display(AVFrame* pFrame)
+{
+    QVideoFrame frame;
+    if (!avframe_to_video_frame(pFrame, frame))
+        return false;
+
+    emit video_frame_ready(frame);
+    return true;
+}
+
+void VideoPlayThread::set_view(const QRectF& roi, const QSize& displaySize)
+{
+    QMutexLocker locker(&m_viewMutex);
+    m_roi = roi.intersected(QRectF(0, 0, 1, 1));
+    m_displaySize = displaySize;
+}
+
+bool VideoPlayThread::is_view_zoomed()
+{
+    QMutexLocker locker(&m_viewMutex);
+    return m_roi != QRectF(0, 0, 1, 1);
+}
+
+QRect VideoPlayThread::update_crop_detect(const AVFrame* pFrame)
+{
+    if (!m_bAutoCrop)
+    {
+        m_pCropDetect.reset();
+        return QRect();
+    }
+
+    if (!m_pCropDetect)
+    {
+        m_pCropDetect = std::make_unique<CropDetectThread>();
+        m_pCropDetect->start(QThread::LowPriority);
+        m_cropSampleCount = 0;
+    }
+
+    // a few samples per second are enough for voting
+    if (m_cropSampleCount++ % 12 == 0)
+        m_pCropDetect->submit_frame(pFrame);
+
+    QRect crop = m_pCropDetect->crop_rect();
+    QRect frameRt(0, 0, pFrame->width, pFrame->height);
+    if (crop.isEmpty() || crop == frameRt || !frameRt.contains(crop))
+        return QRect();
+    return crop;
+}
+
+void VideoPlayThread::update_scopes(const AVFrame* pFrame)
+{
+    if (!m_bScopes)
+    {
+        m_pScopes.reset();
+        return;
+    }
+
+    if (!m_pScopes)
+    {
+        m_pScopes = std::make_unique<VideoScopesThread>();
+        connect(m_pScopes.get(), &VideoScopesThread::scopes_ready, this, &VideoPlayThread::scopes_ready);
+        m_pScopes->start(QThread::LowPriority);
+        m_scopesTimer.invalidate();
+    }
+
+    // a fixed refresh rate, whatever the frame rate is
+    if (!m_scopesTimer.isValid() || m_scopesTimer.elapsed() >= SCOPES_INTERVAL_MS)
+    {
+        m_scopesTimer.start();
+        m_pScopes->submit_frame(pFrame);
+    }
+}
+
+QRectF VideoPlayThread::source_roi(const QRectF& roi, int rotation)
+{
+    // roi is in display orientation, map it back to the source frame
+    switch (rotation)
+    {
+        case 90:
+            return QRectF(roi.y(), 1.0 - roi.x() - roi.width(), roi.height(), roi.width());
+        case 180:
+            return QRectF(1.0 - roi.x() - roi.width(), 1.0 - roi.y() - roi.height(), roi.width(), roi.height());
+        case 270:
+            return QRectF(1.0 - roi.y() - roi.height(), roi.x(), roi.height(), roi.width());
+        default:
+            return roi;
+    }
+}
+
+bool VideoPlayThread::visible_source_rect(const AVFrame* pFrame, const QRect& crop, int rotation, QRect& rt,
+                                          QSize& size)
+{
+    QRectF roi;
+    QSize displaySize;
+    {
+        QMutexLocker locker(&m_viewMutex);
+        roi = source_roi(m_roi, rotation);
+        displaySize = m_displaySize;
+    }
+
+    if (rotation_swaps_size(rotation))
+        displaySize.transpose();
+
+    // roi is relative to the picture without black bars
+    QRect base = crop.isNull() ? QRect(0, 0, pFrame->width, pFrame->height) : crop;
+
+    int x = base.x() + int(roi.x() * base.width());
+    int y = base.y() + int(roi.y() * base.height());
+    int w = int(roi.width() * base.width() + 0.5);
+    int h = int(roi.height() * base.height() + 0.5);
+
+    if (!avframe_align_rect(pFrame->format, pFrame->width, pFrame->height, x, y, w, h))
+        return false;
+
+    // never upscale here, painting does that
+    QSize sz(w, h);
+    if (displaySize.isValid() && (w > displaySize.width() || h > displaySize.height()))
+        sz = sz.scaled(displaySize, Qt::KeepAspectRatio);
+
+    if (sz.width() < 1 || sz.height() < 1)
+        return false;
+
+    rt = QRect(x, y, w, h);
+    size = sz;
+    return true;
+}
+
+bool VideoPlayThread::video_roi_display(AVFrame* pFrame, const QRect& crop, int rotation)
+{
+    QRect rt;
+    QSize sz;
+    if (!visible_source_rect(pFrame, crop, rotation, rt, sz))
+        return false;
+
+    int x = rt.x(), y = rt.y(), w = rt.width(), h = rt.height();
+
+    // whole frame at full size, nothing to save
+    if (rotation == 0 && w == pFrame->width && h == pFrame->height && sz == QSize(w, h))
+        return false;
+
+    uint8_t* src[4];
+    int src_linesize[4];
+    if (!avframe_crop_planes(pFrame, x, y, src, src_linesize))
+        return false;
+
+    if (rotation != 0)
+        return video_rotated_display(pFrame, src, src_linesize, QSize(w, h), sz, rotation);
+
+    Video_Resample* pResample = &m_Resample;
+    pResample->roi_sws_ctx = sws_getCachedContext(pResample->roi_sws_ctx, w, h, AVPixelFormat(pFrame->format),
+                                                  sz.width(), sz.height(), AV_PIX_FMT_RGB24,
+                                                  SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!pResample->roi_sws_ctx)
+        return false;
+
+    QImage img(sz, QImage::Format_RGB888);
+    uint8_t* dst[4] = {img.bits(), nullptr, nullptr, nullptr};
+    int dst_linesize[4] = {(int)img.bytesPerLine(), 0, 0, 0};
+
+    sws_scale(pResample->roi_sws_ctx, (uint8_t const* const*)src, src_linesize, 0, h, dst, dst_linesize);
+
+    emit frame_ready(img);
+    return true;
+}
+
+bool VideoPlayThread::video_luma_display(AVFrame* pFrame, const QRect& crop)
+{
+    if (!avframe_has_luma_plane(pFrame->format))
+        return false;
 
-    QImage img(pVideoCtx->width, pVideoCtx->height, QImage::Format_RGB888);
-    for (int y = 0; y < pVideoCtx->height; ++y)
+    QRect rt;
+    QSize sz;
+    if (!visible_source_rect(pFrame, crop, 0, rt, sz))
+        return false;
+
+    uint8_t* src[4];
+    int src_linesize[4];
+    if (!avframe_crop_planes(pFrame, rt.x(), rt.y(), src, src_linesize))
+        return false;
+
+    // gray8 output only reads the y plane, limited range luma is expanded while scaling
+    Video_Resample* pResample = &m_Resample;
+    pResample->luma_sws_ctx = sws_getCachedContext(pResample->luma_sws_ctx, rt.width(), rt.height(),
+                                                   AVPixelFormat(pFrame->format), sz.width(), sz.height(),
+                                                   AV_PIX_FMT_GRAY8, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!pResample->luma_sws_ctx)
+        return false;
+
+    bool bFullRange = pFrame->color_range == AVCOL_RANGE_JPEG || pFrame->format == AV_PIX_FMT_YUVJ420P ||
+                      pFrame->format == AV_PIX_FMT_YUVJ422P || pFrame->format == AV_PIX_FMT_YUVJ444P;
+    const int* coefs = sws_getCoefficients(SWS_CS_DEFAULT);
+    sws_setColorspaceDetails(pResample->luma_sws_ctx, coefs, bFullRange ? 1 : 0, coefs, 1, 0, 1 << 16, 1 << 16);
+
+    QImage img(sz, QImage::Format_Grayscale8);
+    uint8_t* dst[4] = {img.bits(), nullptr, nullptr, nullptr};
+    int dst_linesize[4] = {(int)img.bytesPerLine(), 0, 0, 0};
+
+    sws_scale(pResample->luma_sws_ctx, (uint8_t const* const*)src, src_linesize, 0, rt.height(), dst, dst_linesize);
+
+    emit frame_ready(img);
+    return true;
+}
+
+bool VideoPlayThread::video_tone_map_display(AVFrame* pFrame, const QRect& crop, int rotation)
+{
+    HdrFrameInfo info;
+    HdrPlanes planes;
+    if (!avframe_hdr_info(pFrame, info, planes))
+        return false;
+
+    // visible part, not larger than the view, painting scales it
+    QRect rt;
+    QSize sz;
+    if (!visible_source_rect(pFrame, crop, rotation, rt, sz))
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    ToneMapCurve curve = m_toneMapCurve;
+    m_toneMapper.configure(info, curve);
+    // rotated while the pixels are written, no extra pass
+    QImage img(rotation_swaps_size(rotation) ? sz.transposed() : sz, QImage::Format_RGB888);
+    m_toneMapper.convert(planes, rt.x(), rt.y(), rt.width(), rt.height(), sz.width(), sz.height(), rotation,
+                         img.bits(), (int)img.bytesPerLine());
+
+    qint64 nsecs = timer.nsecsElapsed();
     {
-        memcpy(img.scanLine(y), pFrameRGB->data[0] + y * pFrameRGB->linesize[0], pVideoCtx->width * 3);
+        QMutexLocker locker(&m_statsMutex);
+        m_toneMapNsecs += nsecs;
+        m_toneMapFrames++;
+        m_toneMapSize = img.size();
     }
 
+#if PRINT_TONE_MAP_TIME
+    qDebug("tone map(%s, %dx%d to %dx%d, rotation %d, peak %.0f nits): %.3f ms", HdrToneMapper::curve_name(curve),
+           rt.width(), rt.height(), img.width(), img.height(), rotation, info.peakNits, nsecs / 1000000.0);
+#endif
+
     emit frame_ready(img);
+    return true;
+}
+
+void VideoPlayThread::take_tone_map_stats(int& frames, double& ms, QSize& size)
+{
+    QMutexLocker locker(&m_statsMutex);
+    frames = m_toneMapFrames;
+    ms = frames ? m_toneMapNsecs / 1000000.0 / frames : 0;
+    size = m_toneMapSize;
+    m_toneMapNsecs = 0;
+    m_toneMapFrames = 0;
+}
+
+bool VideoPlayThread::video_upscaled_display(AVFrame* pFrame, const QRect& crop)
+{
+    QRect rt;
+    QSize sz;
+    if (!visible_source_rect(pFrame, crop, 0, rt, sz))
+        return false;
+
+    QSize displaySize;
+    {
+        QMutexLocker locker(&m_viewMutex);
+        displaySize = m_displaySize;
+    }
+
+    // the size painting scales to, so it draws the image as it is
+    QSize size = rt.size().scaled(displaySize, Qt::KeepAspectRatio);
+    if (!displaySize.isValid() ||
+        !EdgeUpscaler::worth_upscaling(rt.width(), rt.height(), size.width(), size.height()))
+        return false;
+
+    uint8_t* src[4];
+    int src_linesize[4];
+    if (!avframe_crop_planes(pFrame, rt.x(), rt.y(), src, src_linesize))
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // the upscaler reads 8 bits 4:2:0, convert other input at source size first
+    Video_Resample* pResample = &m_Resample;
+    int format = pFrame->format;
+    if (!is_rotate_kernel_format(format))
+    {
+        if (!alloc_yuv_buffer(rt.size()))
+            return false;
+
+        pResample->roi_sws_ctx = sws_getCachedContext(pResample->roi_sws_ctx, rt.width(), rt.height(),
+                                                      AVPixelFormat(format), rt.width(), rt.height(),
+                                                      AV_PIX_FMT_YUV420P, SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!pResample->roi_sws_ctx)
+            return false;
+
+        sws_scale(pResample->roi_sws_ctx, (uint8_t const* const*)src, src_linesize, 0, rt.height(),
+                  pResample->yuv_data, pResample->yuv_linesize);
+        for (int i = 0; i < 4; ++i)
+        {
+            src[i] = pResample->yuv_data[i];
+            src_linesize[i] = pResample->yuv_linesize[i];
+        }
+        format = AV_PIX_FMT_YUV420P;
+    }
+
+    InterpPicture pic;
+    pic.width = rt.width();
+    pic.height = rt.height();
+    pic.nb_planes = format == AV_PIX_FMT_NV12 ? 2 : 3;
+    for (int i = 0; i < pic.nb_planes; ++i)
+    {
+        auto& plane = pic.planes[i];
+        plane.data = src[i];
+        plane.linesize = src_linesize[i];
+        plane.step = format == AV_PIX_FMT_NV12 && i == 1 ? 2 : 1;
+        plane.shift_w = plane.shift_h = i ? 1 : 0;
+    }
+
+    if (!m_upscaler.upscale(pic, size.width(), size.height()))
+        return false;
+
+    // same size, swscale only converts
+    const auto& out = m_upscaler.output();
+    pResample->upscale_sws_ctx = sws_getCachedContext(pResample->upscale_sws_ctx, size.width(), size.height(),
+                                                      AVPixelFormat(format), size.width(), size.height(),
+                                                      AV_PIX_FMT_RGB24, SWS_POINT, nullptr, nullptr, nullptr);
+    if (!pResample->upscale_sws_ctx)
+        return false;
+
+    const uint8_t* planes[4] = {out.planes[0].data, out.planes[1].data, out.planes[2].data, nullptr};
+    const int linesizes[4] = {out.planes[0].linesize, out.planes[1].linesize, out.planes[2].linesize, 0};
+
+    QImage img(size, QImage::Format_RGB888);
+    uint8_t* dst[4] = {img.bits(), nullptr, nullptr, nullptr};
+    int dst_linesize[4] = {(int)img.bytesPerLine(), 0, 0, 0};
+    sws_scale(pResample->upscale_sws_ctx, planes, linesizes, 0, size.height(), dst, dst_linesize);
+
+    qint64 nsecs = timer.nsecsElapsed();
+    {
+        QMutexLocker locker(&m_statsMutex);
+        m_upscaleNsecs += nsecs;
+        m_upscaleFrames++;
+        m_upscaleSrcSize = rt.size();
+        m_upscaleSize = size;
+    }
+
+#if PRINT_UPSCALE_TIME
+    qDebug("upscale(%dx%d -> %dx%d, %d doublings): %.3f ms", rt.width(), rt.height(), size.width(), size.height(),
+           m_upscaler.doublings(), nsecs / 1000000.0);
+#endif
+
+    emit frame_ready(img);
+    return true;
+}
+
+void VideoPlayThread::take_upscale_stats(int& frames, double& ms, QSize& srcSize, QSize& size)
+{
+    QMutexLocker locker(&m_statsMutex);
+    frames = m_upscaleFrames;
+    ms = frames ? m_upscaleNsecs / 1000000.0 / frames : 0;
+    srcSize = m_upscaleSrcSize;
+    size = m_upscaleSize;
+    m_upscaleNsecs = 0;
+    m_upscaleFrames = 0;
+}
+
+bool VideoPlayThread::start_compare(const QString& file)
+{
+    auto source = std::make_shared<CompareSourceThread>();
+    if (!source->open(file))
+        return false;
+    source->start();
+
+    QMutexLocker locker(&m_compareMutex);
+    m_pCompareSource = std::move(source);
+
+    QMutexLocker statsLocker(&m_statsMutex);
+    m_compareSamples.clear();
+    m_compareNsecs = 0;
+    m_compareFrames = 0;
+    m_compareUnmatched = 0;
+    return true;
+}
+
+void VideoPlayThread::stop_compare()
+{
+    // destroyed outside the lock, it waits for its decoder. The video thread
+    // may still hold it in frame_at, it's woken up and releases it after
+    std::shared_ptr<CompareSourceThread> source;
+    {
+        QMutexLocker locker(&m_compareMutex);
+        source = std::move(m_pCompareSource);
+    }
+    if (source)
+        source->stop_thread();
+}
+
+bool VideoPlayThread::is_comparing()
+{
+    QMutexLocker locker(&m_compareMutex);
+    return m_pCompareSource != nullptr;
+}
+
+bool VideoPlayThread::video_compare_frame(VideoState* is, const Frame* vp, AVFrame*& pFrame)
+{
+    std::shared_ptr<CompareSourceThread> source;
+    {
+        QMutexLocker locker(&m_compareMutex);
+        source = m_pCompareSource;
+    }
+    if (!source || isnan(vp->pts))
+        return false;
+
+    if (!m_compareIn)
+        m_compareIn = av_frame_alloc();
+    if (!m_compareOut)
+        m_compareOut = av_frame_alloc();
+    if (!m_compareIn || !m_compareOut)
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // each file from its own start
+    double start = (is->ic->start_time != AV_NOPTS_VALUE) ? is->ic->start_time / double(AV_TIME_BASE) : 0;
+    double time = vp->pts - start;
+    double frameTime = 0;
+    if (!source->frame_at(time, m_compareIn, frameTime, COMPARE_WAIT_MS) ||
+        !m_comparator.set_frames(pFrame, m_compareIn) ||
+        !m_comparator.compose(m_compareView, m_compareWipe, m_compareOut))
+    {
+        QMutexLocker statsLocker(&m_statsMutex);
+        m_compareUnmatched++;
+        return false;
+    }
+    av_frame_unref(m_compareIn);
+
+    // another frame rate or dropped frames in b, the picture shown is not the same
+    bool bMeasured = std::abs(frameTime - time) <= COMPARE_SYNC_LIMIT;
+    CompareMetrics metrics;
+    if (bMeasured)
+        metrics = m_comparator.measure();
+    pFrame = m_compareOut;
+
+    qint64 nsecs = timer.nsecsElapsed();
+    {
+        QMutexLocker statsLocker(&m_statsMutex);
+        m_compareNsecs += nsecs;
+        m_compareFrames++;
+        if (bMeasured)
+            m_compareSamples.push_back({time, metrics});
+        else
+            m_compareUnmatched++;
+    }
+
+#if PRINT_COMPARE_TIME
+    qDebug("compare(%.3f s, b %.3f s): psnr %.2f dB, ssim %.4f, %.3f ms", time, frameTime, metrics.psnr, metrics.ssim,
+           nsecs / 1000000.0);
+#endif
+    return true;
+}
+
+void VideoPlayThread::take_compare_stats(std::vector<CompareSample>& samples, double& ms, int& unmatched)
+{
+    QMutexLocker locker(&m_statsMutex);
+    samples.swap(m_compareSamples);
+    m_compareSamples.clear();
+    ms = m_compareFrames ? m_compareNsecs / 1000000.0 / m_compareFrames : 0;
+    unmatched = m_compareUnmatched;
+    m_compareNsecs = 0;
+    m_compareFrames = 0;
+    m_compareUnmatched = 0;
+}
+
+bool VideoPlayThread::alloc_yuv_buffer(const QSize& size)
+{
+    Video_Resample* pResample = &m_Resample;
+    if (pResample->yuv_width == size.width() && pResample->yuv_height == size.height())
+        return true;
+
+    av_freep(&pResample->yuv_data[0]);
+    if (av_image_alloc(pResample->yuv_data, pResample->yuv_linesize, size.width(), size.height(),
+                       AV_PIX_FMT_YUV420P, 32) < 0)
+    {
+        pResample->yuv_width = pResample->yuv_height = 0;
+        return false;
+    }
+    pResample->yuv_width = size.width();
+    pResample->yuv_height = size.height();
+    return true;
+}
+
+bool VideoPlayThread::video_rotated_display(AVFrame* pFrame, uint8_t* const src[4], const int src_linesize[4],
+                                            const QSize& srcSize, const QSize& size, int rotation)
+{
+    Video_Resample* pResample = &m_Resample;
+    const uint8_t* planes[4] = {src[0], src[1], src[2], src[3]};
+    const int* linesizes = src_linesize;
+    int format = pFrame->format;
+    AVColorRange range = pFrame->color_range;
+
+    // the kernel reads 4:2:0 at output size, scale/convert other input first
+    if (!is_rotate_kernel_format(format) || srcSize != size)
+    {
+        if (!alloc_yuv_buffer(size))
+            return false;
+
+        pResample->roi_sws_ctx = sws_getCachedContext(pResample->roi_sws_ctx, srcSize.width(), srcSize.height(),
+                                                      AVPixelFormat(format), size.width(), size.height(),
+                                                      AV_PIX_FMT_YUV420P, SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!pResample->roi_sws_ctx)
+            return false;
+
+        sws_scale(pResample->roi_sws_ctx, (uint8_t const* const*)src, src_linesize, 0, srcSize.height(),
+                  pResample->yuv_data, pResample->yuv_linesize);
+
+        for (int i = 0; i < 4; ++i)
+            planes[i] = pResample->yuv_data[i];
+        linesizes = pResample->yuv_linesize;
+
+        // swscale outputs limited range from the jpeg formats
+        if (format == AV_PIX_FMT_YUVJ420P || format == AV_PIX_FMT_YUVJ422P || format == AV_PIX_FMT_YUVJ444P)
+            range = AVCOL_RANGE_MPEG;
+        format = AV_PIX_FMT_YUV420P;
+    }
+    else if (format == AV_PIX_FMT_YUVJ420P)
+    {
+        range = AVCOL_RANGE_JPEG;
+    }
+
+    YuvCoefficients coef;
+    yuv_coefficients(pFrame->colorspace, range, pFrame->height, coef);
+
+    QImage img(rotation_swaps_size(rotation) ? size.transposed() : size, QImage::Format_RGB888);
+    yuv420_to_rgb24_rotated(planes, linesizes, format, size.width(), size.height(), coef, rotation, img.bits(),
+                            (int)img.bytesPerLine());
+
+    emit frame_ready(img);
+    return true;
+}
+
+void VideoPlayThread::print_convert_time(bool bSink, qint64 nsecs)
+{
+#if PRINT_VIDEO_CONVERT_TIME
+    int i = bSink ? 1 : 0;
+    m_convertNsecs[i] += nsecs;
+    if (++m_convertFrames[i] % 100 == 0)
+    {
+        qDebug("video convert(%s path): %.3f ms per frame, average of %d frames",
+               bSink ? "sink" : "rgb", m_convertNsecs[i] / 1000000.0 / m_convertFrames[i], m_convertFrames[i]);
+    }
+#endif
 }
 
 bool VideoPlayThread::init_resample_param(AVCodecContext* pVideo, bool bHardware)
@@ -481,27 +1110,13 @@ bool VideoPlayThread::init_resample_param(AVCodecContext* pVideo, bool bHardware
                                                     pVideo->width, pVideo->height,
                                                     AV_PIX_FMT_RGB24, // sws_scale destination color scheme
                                                     SWS_BILINEAR, nullptr, nullptr, nullptr);
-
-        AVFrame* pFrameRGB = av_frame_alloc();
-        if (!pFrameRGB)
+        if (!sws_ctx)
         {
-            printf("Could not allocate rgb frame.\n");
+            printf("Could not create scale context.\n");
             return false;
         }
 
-        int numBytes = av_image_get_buffer_size(AV_PIX_FMT_RGB24, pVideo->width, pVideo->height, 32);
-        uint8_t* const buffer_RGB = (uint8_t*)av_malloc(numBytes * sizeof(uint8_t));
-        if (!buffer_RGB)
-        {
-            printf("Could not allocate buffer.\n");
-            return false;
-        }
-
-        av_image_fill_arrays(pFrameRGB->data, pFrameRGB->linesize, buffer_RGB, AV_PIX_FMT_RGB24, pVideo->width, pVideo->height, 32);
-
         pResample->sws_ctx = sws_ctx;
-        pResample->pFrameRGB = pFrameRGB;
-        pResample->buffer_RGB = buffer_RGB;
         return true;
     }
     return false;
@@ -512,11 +1127,15 @@ void VideoPlayThread::final_resample_param()
     Video_Resample* pResample = &m_Resample;
     // Free video resample context
     sws_freeContext(pResample->sws_ctx);
-
-    // Free the RGB image
-    av_free(pResample->buffer_RGB);
-    av_frame_free(&pResample->pFrameRGB);
-    av_free(pResample->pFrameRGB);
+    pResample->sws_ctx = nullptr;
+    sws_freeContext(pResample->roi_sws_ctx);
+    pResample->roi_sws_ctx = nullptr;
+    sws_freeContext(pResample->luma_sws_ctx);
+    pResample->luma_sws_ctx = nullptr;
+    sws_freeContext(pResample->upscale_sws_ctx);
+    pResample->upscale_sws_ctx = nullptr;
+    av_freep(&pResample->yuv_data[0]);
+    pResample->yuv_width = pResample->yuv_height = 0;
 }
 
 void VideoPlayThread::stop_thread()
@@ -1,18 +1,41 @@
 ﻿#pragma once
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QImage>
+#include <QMutex>
+#include <QRectF>
 #include <QRegularExpression>
 #include <QThread>
+#include <QVideoFrame>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "compare_source_thread.h"
+#include "crop_detect_thread.h"
+#include "edge_upscaler.h"
+#include "frame_compare.h"
+#include "hdr_tonemap.h"
 #include "packets_sync.h"
+#include "video_scopes_thread.h"
+#include "video_sink_frame.h"
+#include "yuv_rgb_convert.h"
 
 #define PRINT_VIDEO_BUFFER_INFO 0
+#define SCOPES_INTERVAL_MS 100   // scopes refresh, independent of the frame rate
+#define COMPARE_WAIT_MS 30       // for the b frame, longer shows a alone
+#define COMPARE_SYNC_LIMIT 0.008 // seconds, frames of a and b further apart aren't measured
 
 typedef struct Video_Resample
 {
-    AVFrame* pFrameRGB{nullptr};
-    uint8_t* buffer_RGB{nullptr};
     struct SwsContext* sws_ctx{nullptr};
+    struct SwsContext* roi_sws_ctx{nullptr}; // visible rect only, sized to the view
+    struct SwsContext* luma_sws_ctx{nullptr}; // y plane only, to gray8
+    struct SwsContext* upscale_sws_ctx{nullptr}; // upscaled yuv to rgb24, same size
+    uint8_t* yuv_data[4]{nullptr};           // scaled yuv420p input of the rotating kernel
+    int yuv_linesize[4]{0};
+    int yuv_width{0};
+    int yuv_height{0};
 } Video_Resample;
 
 class VideoPlayThread : public QThread
@@ -24,13 +47,36 @@ public:
 
 public:
     bool init_resample_param(AVCodecContext* pVideo, bool bHardware = false);
+    inline void set_sink_output(bool bSink) { m_bSinkOutput = bSink; }
+    void set_view(const QRectF& roi, const QSize& displaySize);
+    inline void set_auto_crop(bool bCrop) { m_bAutoCrop = bCrop; }
+    inline void set_luma_output(bool bLuma) { m_bLumaOutput = bLuma; }
+    inline void set_scopes(bool bScopes) { m_bScopes = bScopes; }
+    inline void set_manual_rotation(int degrees) { m_manualRotation = ((degrees / 90) % 4 + 4) % 4 * 90; }
+    inline void set_tone_map(ToneMapCurve curve) { m_toneMapCurve = curve; }
+    // tone mapped frames since the last call, their average cost and size
+    void take_tone_map_stats(int& frames, double& ms, QSize& size);
+    inline void set_upscale(bool bUpscale) { m_bUpscale = bUpscale; }
+    // upscaled frames since the last call, their average cost, source and output size
+    void take_upscale_stats(int& frames, double& ms, QSize& srcSize, QSize& size);
+    // a/b compare against a second file locked to this clock, false if it can't be opened
+    bool start_compare(const QString& file);
+    void stop_compare();
+    bool is_comparing();
+    inline void set_compare_view(CompareView view) { m_compareView = view; }
+    inline void set_compare_wipe(double wipe) { m_compareWipe = std::clamp(wipe, 0.0, 1.0); }
+    inline double compare_wipe() const { return m_compareWipe; }
+    // measured frames since the last call, average cost, frames shown without b or not measured
+    void take_compare_stats(std::vector<CompareSample>& samples, double& ms, int& unmatched);
 
 public slots:
     void stop_thread();
 
 signals:
     void frame_ready(const QImage&);
+    void video_frame_ready(const QVideoFrame&);
     void subtitle_ready(const QString&);
+    void scopes_ready(const QImage& histogram, const QImage& waveform, const QImage& vectorscope);
 
 protected:
     void run() override;
@@ -43,11 +89,74 @@ private:
     void final_resample_param();
     inline int compute_mod(int a, int b) { return a < 0 ? (a % b + b) : (a % b); }
     void parse_subtitle_ass(const QString& text);
+    bool video_sink_display(AVFrame* pFrame);
+    bool video_roi_display(AVFrame* pFrame, const QRect& crop, int rotation);
+    bool video_luma_display(AVFrame* pFrame, const QRect& crop);
+    bool video_tone_map_display(AVFrame* pFrame, const QRect& crop, int rotation);
+    bool video_upscaled_display(AVFrame* pFrame, const QRect& crop);
+    bool video_compare_frame(VideoState* is, const Frame* vp, AVFrame*& pFrame);
+    bool alloc_yuv_buffer(const QSize& size);
+    bool visible_source_rect(const AVFrame* pFrame, const QRect& crop, int rotation, QRect& rt, QSize& size);
+    bool video_rotated_display(AVFrame* pFrame, uint8_t* const src[4], const int src_linesize[4],
+                               const QSize& srcSize, const QSize& size, int rotation);
+    static QRectF source_roi(const QRectF& roi, int rotation);
+    QRect update_crop_detect(const AVFrame* pFrame);
+    void update_scopes(const AVFrame* pFrame);
+    bool is_view_zoomed();
+    void print_convert_time(bool bSink, qint64 nsecs);
 
 private:
     VideoState* m_pState{nullptr};
     Video_Resample m_Resample;
     bool m_bExitThread{false};
+    std::atomic_bool m_bSinkOutput{false}; // hand yuv frames to QVideoSink, set by gui
+
+    QMutex m_viewMutex;
+    QRectF m_roi{0, 0, 1, 1}; // visible source rect, normalized
+    QSize m_displaySize;       // view size in device pixels
+
+    std::atomic_bool m_bAutoCrop{false}; // remove black bars, set by gui
+    std::unique_ptr<CropDetectThread> m_pCropDetect;
+    int m_cropSampleCount{0};
+
+    std::atomic_bool m_bScopes{false}; // scopes dock visible, set by gui
+    std::unique_ptr<VideoScopesThread> m_pScopes;
+    QElapsedTimer m_scopesTimer;
+
+    std::atomic_int m_manualRotation{0}; // clockwise degrees, added to the display matrix
+    std::atomic_bool m_bLumaOutput{false}; // gray8 images from the y plane, effects output gray
+
+    std::atomic<ToneMapCurve> m_toneMapCurve{ToneMapCurve::Off}; // pq/hlg frames to sdr, set by gui
+    HdrToneMapper m_toneMapper;
+    QMutex m_statsMutex; // stats, taken by gui
+    qint64 m_toneMapNsecs{0};
+    int m_toneMapFrames{0};
+    QSize m_toneMapSize;
+
+    std::atomic_bool m_bUpscale{false}; // low resolution frames to the display size, set by gui
+    EdgeUpscaler m_upscaler;
+    qint64 m_upscaleNsecs{0};
+    int m_upscaleFrames{0};
+    QSize m_upscaleSrcSize;
+    QSize m_upscaleSize;
+
+    QMutex m_compareMutex; // the b source, started and stopped by gui
+    // the video thread waits for b on its own reference, not under the lock
+    std::shared_ptr<CompareSourceThread> m_pCompareSource;
+    FrameComparator m_comparator;
+    AVFrame* m_compareIn{nullptr};  // frame of b
+    AVFrame* m_compareOut{nullptr}; // composed picture shown
+    std::atomic<CompareView> m_compareView{CompareView::Wipe};
+    std::atomic<double> m_compareWipe{0.5};
+    std::vector<CompareSample> m_compareSamples;
+    qint64 m_compareNsecs{0};
+    int m_compareFrames{0};
+    int m_compareUnmatched{0};
+
+#if PRINT_VIDEO_CONVERT_TIME
+    qint64 m_convertNsecs[2]{0, 0}; // rgb path, sink path
+    int m_convertFrames[2]{0, 0};
+#endif
 
     const static QRegularExpression m_assFilter;
     const static QRegularExpression m_assNewLineReplacer;
@@ -0,0 +1,300 @@
+// ***********************************************************/
+// video_scopes_thread.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Live video scopes. Y, U and V are sampled on one grid of at
+// most 480x270 points, so chroma is read at the luma positions
+// and no upsampling is needed. RGB of the samples comes from a
+// single matrix transform and the histograms from calcHist, both
+// vectorized in OpenCV; waveform and vectorscope are counters.
+// ***********************************************************/
+
+#include "video_scopes_thread.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgproc.hpp>
+
+extern "C"
+{
+#include <libavutil/pixdesc.h>
+}
+
+#define SAMPLE_MAX_WIDTH 480
+#define SAMPLE_MAX_HEIGHT 270
+#define SCOPE_SIZE 256       // waveform and vectorscope are 256x256
+#define HISTOGRAM_HEIGHT 128
+#define GRATICULE_LEVEL 70   // gray of the reference lines
+
+VideoScopesThread::VideoScopesThread(QObject* parent) : QThread(parent)
+{
+}
+
+VideoScopesThread::~VideoScopesThread()
+{
+    stop_thread();
+    wait();
+}
+
+void VideoScopesThread::stop_thread()
+{
+    QMutexLocker locker(&m_mutex);
+    m_bExitThread = true;
+    m_cond.wakeAll();
+}
+
+void VideoScopesThread::sample_component(const AVFrame* frame, int c, int step_x, int step_y, cv::Mat& plane)
+{
+    auto desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+    const auto& comp = desc->comp[c];
+    int log2_w = c ? desc->log2_chroma_w : 0;
+    int log2_h = c ? desc->log2_chroma_h : 0;
+    int shift = comp.shift + std::max(0, comp.depth - 8);
+
+    for (int y = 0; y < plane.rows; ++y)
+    {
+        const uint8_t* src = frame->data[comp.plane] + int64_t((y * step_y) >> log2_h) * frame->linesize[comp.plane] +
+                             comp.offset;
+        uchar* dst = plane.ptr<uchar>(y);
+
+        if (comp.depth > 8)
+        {
+            for (int x = 0; x < plane.cols; ++x)
+                dst[x] = uchar(*(const uint16_t*)(src + ((x * step_x) >> log2_w) * comp.step) >> shift);
+        }
+        else
+        {
+            for (int x = 0; x < plane.cols; ++x)
+                dst[x] = uchar(src[((x * step_x) >> log2_w) * comp.step] >> shift);
+        }
+    }
+}
+
+bool VideoScopesThread::submit_frame(const AVFrame* frame)
+{
+    auto desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL |
+                                 AV_PIX_FMT_FLAG_BITSTREAM)))
+        return false;
+
+    // gray formats have no chroma, it's set to neutral
+    int components = std::min(3, int(desc->nb_components));
+    if (components == 2)
+        components = 1; // gray with alpha
+    for (int c = 0; c < components; ++c)
+    {
+        const auto& comp = desc->comp[c];
+        if (comp.depth > 16 || (comp.depth > 8 && (desc->flags & AV_PIX_FMT_FLAG_BE)))
+            return false;
+    }
+
+#if PRINT_SCOPES_TIME
+    QElapsedTimer timer;
+    timer.start();
+#endif
+
+    int step_x = (frame->width + SAMPLE_MAX_WIDTH - 1) / SAMPLE_MAX_WIDTH;
+    int step_y = (frame->height + SAMPLE_MAX_HEIGHT - 1) / SAMPLE_MAX_HEIGHT;
+    cv::Size size(frame->width / step_x, frame->height / step_y);
+    if (size.empty())
+        return false;
+
+    ScopeSample sample;
+    for (int c = 0; c < 3; ++c)
+    {
+        sample.planes[c].create(size, CV_8UC1);
+        if (c < components)
+            sample_component(frame, c, step_x, step_y, sample.planes[c]);
+        else
+            sample.planes[c].setTo(128);
+    }
+    sample.bFullRange = frame->color_range == AVCOL_RANGE_JPEG;
+    sample.bBt709 = frame->colorspace == AVCOL_SPC_BT709 || (frame->colorspace == AVCOL_SPC_UNSPECIFIED && frame->height > 576);
+
+#if PRINT_SCOPES_TIME
+    qDebug("scopes sample (%dx%d -> %dx%d): %.3f ms", frame->width, frame->height, size.width, size.height,
+           timer.nsecsElapsed() / 1000000.0);
+#endif
+
+    QMutexLocker locker(&m_mutex);
+    m_pending = std::move(sample);
+    m_bPending = true;
+    m_cond.wakeAll();
+    return true;
+}
+
+void VideoScopesThread::run()
+{
+    for (;;)
+    {
+        ScopeSample sample;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_bPending && !m_bExitThread)
+                m_cond.wait(&m_mutex);
+
+            if (m_bExitThread)
+                break;
+
+            sample = std::move(m_pending);
+            m_bPending = false;
+        }
+
+        compute(sample);
+    }
+}
+
+static QImage to_qimage(const cv::Mat& rgb)
+{
+    return QImage(rgb.data, rgb.cols, rgb.rows, int(rgb.step), QImage::Format_RGB888).copy();
+}
+
+void VideoScopesThread::compute(const ScopeSample& sample)
+{
+#if PRINT_SCOPES_TIME
+    QElapsedTimer timer;
+    timer.start();
+#endif
+
+    // yuv to rgb of all samples in one matrix transform
+    double kr = sample.bBt709 ? 0.2126 : 0.299;
+    double kb = sample.bBt709 ? 0.0722 : 0.114;
+    double kg = 1.0 - kr - kb;
+    double ys = sample.bFullRange ? 1.0 : 255.0 / 219.0;
+    double cs = sample.bFullRange ? 1.0 : 255.0 / 224.0;
+    double yo = sample.bFullRange ? 0.0 : -16.0 * ys;
+    double rv = cs * 2 * (1 - kr);
+    double gu = -cs * 2 * (1 - kb) * kb / kg;
+    double gv = -cs * 2 * (1 - kr) * kr / kg;
+    double bu = cs * 2 * (1 - kb);
+    cv::Matx34f m(float(ys), 0, float(rv), float(yo - 128 * rv),
+                  float(ys), float(gu), float(gv), float(yo - 128 * (gu + gv)),
+                  float(ys), float(bu), 0, float(yo - 128 * bu));
+
+    cv::Mat yuv, rgb;
+    cv::merge(sample.planes, 3, yuv);
+    cv::transform(yuv, rgb, m);
+
+    auto histogram = render_histogram(rgb, sample.planes[0]);
+    auto waveform = render_waveform(sample.planes[0]);
+    auto vectorscope = render_vectorscope(sample.planes[1], sample.planes[2]);
+
+#if PRINT_SCOPES_TIME
+    qDebug("scopes compute (%dx%d samples): %.3f ms", rgb.cols, rgb.rows, timer.nsecsElapsed() / 1000000.0);
+#endif
+
+    emit scopes_ready(to_qimage(histogram), to_qimage(waveform), to_qimage(vectorscope));
+}
+
+uchar VideoScopesThread::density(int count, double full)
+{
+    // log scale, a single sample is still visible
+    if (count <= 0)
+        return 0;
+    double v = 64 + 191 * std::log1p(count) / std::log1p(std::max(1.0, full));
+    return uchar(std::min(255.0, v));
+}
+
+cv::Mat VideoScopesThread::render_histogram(const cv::Mat& rgb, const cv::Mat& luma)
+{
+    int histSize = 256;
+    float range[] = {0, 256};
+    const float* ranges[] = {range};
+
+    cv::Mat hists[4];
+    for (int c = 0; c < 3; ++c)
+        cv::calcHist(&rgb, 1, &c, cv::Mat(), hists[c], 1, &histSize, ranges);
+    cv::calcHist(&luma, 1, 0, cv::Mat(), hists[3], 1, &histSize, ranges);
+
+    // clipped black and white would flatten the rest, they are left out of the scale
+    float max = 1;
+    for (const auto& hist : hists)
+        max = std::max(max, *std::max_element(hist.ptr<float>(1), hist.ptr<float>(255)));
+
+    cv::Mat img(HISTOGRAM_HEIGHT, 256, CV_8UC3, cv::Scalar::all(0));
+    for (int i = 0; i < 256; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            int h = std::min(HISTOGRAM_HEIGHT, cvRound(hists[c].at<float>(i) * HISTOGRAM_HEIGHT / max));
+            for (int y = HISTOGRAM_HEIGHT - h; y < HISTOGRAM_HEIGHT; ++y)
+                img.at<cv::Vec3b>(y, i)[c] = 180; // overlapping channels add up to gray
+        }
+    }
+
+    // luma as an outline on top
+    auto luma_y = [&](int i) {
+        return HISTOGRAM_HEIGHT - 1 - std::min(HISTOGRAM_HEIGHT - 1, cvRound(hists[3].at<float>(i) * HISTOGRAM_HEIGHT / max));
+    };
+    for (int i = 1; i < 256; ++i)
+        cv::line(img, cv::Point(i - 1, luma_y(i - 1)), cv::Point(i, luma_y(i)), cv::Scalar::all(255));
+    return img;
+}
+
+cv::Mat VideoScopesThread::render_waveform(const cv::Mat& luma)
+{
+    // luma levels (bottom up) per column of the frame
+    std::vector<int> columns(luma.cols);
+    for (int x = 0; x < luma.cols; ++x)
+        columns[x] = x * SCOPE_SIZE / luma.cols;
+
+    cv::Mat counts(SCOPE_SIZE, SCOPE_SIZE, CV_32SC1, cv::Scalar::all(0));
+    for (int y = 0; y < luma.rows; ++y)
+    {
+        const uchar* src = luma.ptr<uchar>(y);
+        for (int x = 0; x < luma.cols; ++x)
+            counts.at<int>(255 - src[x], columns[x])++;
+    }
+
+    double full = double(luma.total()) / SCOPE_SIZE / 16; // of a column
+    cv::Mat img(SCOPE_SIZE, SCOPE_SIZE, CV_8UC3, cv::Scalar::all(0));
+    for (int level : {16, 128, 235}) // video black, middle, video white
+        img.row(255 - level).setTo(cv::Scalar::all(GRATICULE_LEVEL));
+
+    for (int y = 0; y < SCOPE_SIZE; ++y)
+    {
+        const int* count = counts.ptr<int>(y);
+        auto dst = img.ptr<cv::Vec3b>(y);
+        for (int x = 0; x < SCOPE_SIZE; ++x)
+        {
+            if (uchar v = density(count[x], full))
+                dst[x] = cv::Vec3b(v / 3, v, v / 3);
+        }
+    }
+    return img;
+}
+
+cv::Mat VideoScopesThread::render_vectorscope(const cv::Mat& u, const cv::Mat& v)
+{
+    // cb to the right, cr up
+    cv::Mat counts(SCOPE_SIZE, SCOPE_SIZE, CV_32SC1, cv::Scalar::all(0));
+    for (int y = 0; y < u.rows; ++y)
+    {
+        const uchar* pu = u.ptr<uchar>(y);
+        const uchar* pv = v.ptr<uchar>(y);
+        for (int x = 0; x < u.cols; ++x)
+            counts.at<int>(255 - pv[x], pu[x])++;
+    }
+
+    cv::Mat img(SCOPE_SIZE, SCOPE_SIZE, CV_8UC3, cv::Scalar::all(0));
+    cv::Point center(128, 127);
+    cv::Scalar graticule = cv::Scalar::all(GRATICULE_LEVEL);
+    cv::circle(img, center, 112, graticule); // limited range chroma extent
+    cv::line(img, cv::Point(center.x, 0), cv::Point(center.x, SCOPE_SIZE - 1), graticule);
+    cv::line(img, cv::Point(0, center.y), cv::Point(SCOPE_SIZE - 1, center.y), graticule);
+
+    double full = double(u.total()) / SCOPE_SIZE;
+    for (int y = 0; y < SCOPE_SIZE; ++y)
+    {
+        const int* count = counts.ptr<int>(y);
+        auto dst = img.ptr<cv::Vec3b>(y);
+        for (int x = 0; x < SCOPE_SIZE; ++x)
+        {
+            if (uchar d = density(count[x], full))
+                dst[x] = cv::Vec3b(d / 3, d, d / 3);
+        }
+    }
+    return img;
+}
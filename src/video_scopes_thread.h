@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QImage>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <opencv2/core.hpp>
+
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+#define PRINT_SCOPES_TIME 0
+
+// Histogram, luma waveform and vectorscope of decimated Y/U/V samples.
+// The play thread copies a sample a few times per second, the scopes are
+// computed and rendered here, so the pipeline only pays for the sampling.
+class VideoScopesThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit VideoScopesThread(QObject* parent = Q_NULLPTR);
+    ~VideoScopesThread();
+
+public:
+    // copy Y/U/V samples of the frame on one grid, false if the format is not yuv or gray
+    bool submit_frame(const AVFrame* frame);
+    void stop_thread();
+
+signals:
+    void scopes_ready(const QImage& histogram, const QImage& waveform, const QImage& vectorscope);
+
+protected:
+    void run() override;
+
+private:
+    typedef struct ScopeSample
+    {
+        cv::Mat planes[3]; // y, u, v, 8 bits, same size
+        bool bFullRange{false};
+        bool bBt709{false};
+    } ScopeSample;
+
+    static void sample_component(const AVFrame* frame, int c, int step_x, int step_y, cv::Mat& plane);
+    void compute(const ScopeSample& sample);
+    static cv::Mat render_histogram(const cv::Mat& rgb, const cv::Mat& luma);
+    static cv::Mat render_waveform(const cv::Mat& luma);
+    static cv::Mat render_vectorscope(const cv::Mat& u, const cv::Mat& v);
+    static uchar density(int count, double full);
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    ScopeSample m_pending; // latest sample wins
+    bool m_bPending{false};
+    bool m_bExitThread{false};
+};
@@ -0,0 +1,67 @@
+// ***********************************************************/
+// video_scopes_widget.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Video scopes panel of the scopes dock. Each scope is drawn
+// under its title, at the width of the panel and its own
+// aspect ratio.
+// ***********************************************************/
+
+#include <QPainter>
+#include "video_scopes_widget.h"
+
+VideoScopesWidget::VideoScopesWidget(QWidget* parent) : QWidget(parent)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setMinimumWidth(160);
+}
+
+QSize VideoScopesWidget::sizeHint() const
+{
+    return QSize(260, 720);
+}
+
+void VideoScopesWidget::set_scopes(const QImage& histogram, const QImage& waveform, const QImage& vectorscope)
+{
+    m_scopes[0] = histogram;
+    m_scopes[1] = waveform;
+    m_scopes[2] = vectorscope;
+    update();
+}
+
+void VideoScopesWidget::clear()
+{
+    for (auto& img : m_scopes)
+        img = QImage();
+    update();
+}
+
+void VideoScopesWidget::paintEvent(QPaintEvent* event)
+{
+    const char* titles[] = {"Histogram", "Waveform", "Vectorscope"};
+
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+    painter.setPen(Qt::lightGray);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+    int margin = 4;
+    int width = this->width() - 2 * margin;
+    int titleHeight = fontMetrics().height();
+    int y = margin;
+    for (int i = 0; i < 3; ++i)
+    {
+        painter.drawText(QRect(margin, y, width, titleHeight), Qt::AlignLeft | Qt::AlignVCenter, titles[i]);
+        y += titleHeight;
+
+        const auto& img = m_scopes[i];
+        int height = img.isNull() ? width / 2 : width * img.height() / img.width();
+        QRect rt(margin, y, width, height);
+        if (img.isNull())
+            painter.drawRect(rt.adjusted(0, 0, -1, -1));
+        else
+            painter.drawImage(rt, img);
+        y += height + margin;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QImage>
+#include <QWidget>
+
+// Shows the scopes of VideoScopesThread stacked, scaled to the dock width.
+class VideoScopesWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit VideoScopesWidget(QWidget* parent = Q_NULLPTR);
+    virtual ~VideoScopesWidget(){};
+
+public slots:
+    void set_scopes(const QImage& histogram, const QImage& waveform, const QImage& vectorscope);
+    void clear();
+
+public:
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    QImage m_scopes[3]; // histogram, waveform, vectorscope
+};
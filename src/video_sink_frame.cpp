@@ -0,0 +1,208 @@
+// ***********************************************************/
+// video_sink_frame.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Wrap decoded AVFrame planes into QVideoFrame, so that the
+// yuv to rgb conversion is done by Qt's video renderer.
+// ***********************************************************/
+
+#include <algorithm>
+#include <cstring>
+#include "video_sink_frame.h"
+
+extern "C"
+{
+#include <libavutil/common.h>
+#include <libavutil/pixdesc.h>
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+#include <QAbstractVideoBuffer>
+#include <memory>
+#endif
+
+QVideoFrameFormat::PixelFormat avpixfmt_to_qt(int format)
+{
+    switch (format)
+    {
+        case AV_PIX_FMT_YUV420P:
+            return QVideoFrameFormat::Format_YUV420P;
+        case AV_PIX_FMT_YUVJ420P:
+            return QVideoFrameFormat::Format_YUV420P;
+        case AV_PIX_FMT_YUV422P:
+            return QVideoFrameFormat::Format_YUV422P;
+        case AV_PIX_FMT_NV12:
+            return QVideoFrameFormat::Format_NV12;
+        case AV_PIX_FMT_NV21:
+            return QVideoFrameFormat::Format_NV21;
+        case AV_PIX_FMT_P010LE:
+            return QVideoFrameFormat::Format_P010;
+        case AV_PIX_FMT_P016LE:
+            return QVideoFrameFormat::Format_P016;
+        case AV_PIX_FMT_YUV420P10LE:
+            return QVideoFrameFormat::Format_YUV420P10;
+        case AV_PIX_FMT_YUYV422:
+            return QVideoFrameFormat::Format_YUYV;
+        case AV_PIX_FMT_UYVY422:
+            return QVideoFrameFormat::Format_UYVY;
+        case AV_PIX_FMT_GRAY8:
+            return QVideoFrameFormat::Format_Y8;
+        case AV_PIX_FMT_GRAY16LE:
+            return QVideoFrameFormat::Format_Y16;
+        case AV_PIX_FMT_BGRA:
+            return QVideoFrameFormat::Format_BGRA8888;
+        case AV_PIX_FMT_RGBA:
+            return QVideoFrameFormat::Format_RGBA8888;
+        case AV_PIX_FMT_BGR0:
+            return QVideoFrameFormat::Format_BGRX8888;
+        case AV_PIX_FMT_RGB0:
+            return QVideoFrameFormat::Format_RGBX8888;
+        default:
+            return QVideoFrameFormat::Format_Invalid;
+    }
+}
+
+bool is_sink_supported(const AVFrame* frame)
+{
+    if (!frame || !frame->data[0] || frame->width <= 0 || frame->height <= 0)
+        return false;
+
+    if (avpixfmt_to_qt(frame->format) == QVideoFrameFormat::Format_Invalid)
+        return false;
+
+    // negative linesize(vertically flipped) can't be described by QVideoFrame
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->data[i]; ++i)
+    {
+        if (frame->linesize[i] < 0)
+            return false;
+    }
+    return true;
+}
+
+static QVideoFrameFormat video_frame_format(const AVFrame* frame)
+{
+    QVideoFrameFormat format(QSize(frame->width, frame->height), avpixfmt_to_qt(frame->format));
+
+    bool bFullRange = frame->color_range == AVCOL_RANGE_JPEG || frame->format == AV_PIX_FMT_YUVJ420P;
+    format.setColorRange(bFullRange ? QVideoFrameFormat::ColorRange_Full : QVideoFrameFormat::ColorRange_Video);
+
+    switch (frame->colorspace)
+    {
+        case AVCOL_SPC_BT709:
+            format.setColorSpace(QVideoFrameFormat::ColorSpace_BT709);
+            break;
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:
+            format.setColorSpace(QVideoFrameFormat::ColorSpace_BT601);
+            break;
+        case AVCOL_SPC_BT2020_NCL:
+        case AVCOL_SPC_BT2020_CL:
+            format.setColorSpace(QVideoFrameFormat::ColorSpace_BT2020);
+            break;
+        default:
+            // same guess as swscale does for unspecified streams
+            format.setColorSpace(frame->height > 576 ? QVideoFrameFormat::ColorSpace_BT709
+                                                     : QVideoFrameFormat::ColorSpace_BT601);
+            break;
+    }
+
+    switch (frame->color_trc)
+    {
+        case AVCOL_TRC_SMPTE2084:
+            format.setColorTransfer(QVideoFrameFormat::ColorTransfer_ST2084);
+            break;
+        case AVCOL_TRC_ARIB_STD_B67:
+            format.setColorTransfer(QVideoFrameFormat::ColorTransfer_STD_B67);
+            break;
+        default:
+            break;
+    }
+    return format;
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+// Keeps a reference of the decoded frame alive as long as Qt uses the buffer
+class AVFrameVideoBuffer : public QAbstractVideoBuffer
+{
+public:
+    AVFrameVideoBuffer(const AVFrame* frame, const QVideoFrameFormat& format)
+        : m_frame(av_frame_clone(frame)), m_format(format)
+    {
+    }
+
+    ~AVFrameVideoBuffer() override { av_frame_free(&m_frame); }
+
+    bool is_valid() const { return m_frame != nullptr; }
+
+    MapData map(QVideoFrame::MapMode mode) override
+    {
+        MapData data;
+        if (!m_frame || (mode & QVideoFrame::WriteOnly))
+            return data;
+
+        for (int i = 0; i < m_format.planeCount() && i < 4; ++i)
+        {
+            int h = m_frame->height;
+            if (i > 0 && m_format.planeCount() > 1)
+            {
+                auto desc = av_pix_fmt_desc_get(AVPixelFormat(m_frame->format));
+                h = AV_CEIL_RSHIFT(h, desc->log2_chroma_h);
+            }
+
+            data.data[i] = m_frame->data[i];
+            data.bytesPerLine[i] = m_frame->linesize[i];
+            data.dataSize[i] = m_frame->linesize[i] * h;
+        }
+        data.planeCount = m_format.planeCount();
+        return data;
+    }
+
+    QVideoFrameFormat format() const override { return m_format; }
+
+private:
+    AVFrame* m_frame{nullptr};
+    QVideoFrameFormat m_format;
+};
+#endif
+
+bool avframe_to_video_frame(const AVFrame* frame, QVideoFrame& out)
+{
+    if (!is_sink_supported(frame))
+        return false;
+
+    auto format = video_frame_format(frame);
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    auto buffer = std::make_unique<AVFrameVideoBuffer>(frame, format);
+    if (!buffer->is_valid())
+        return false;
+
+    out = QVideoFrame(std::move(buffer));
+    return out.isValid();
+#else
+    QVideoFrame videoFrame(format);
+    if (!videoFrame.map(QVideoFrame::WriteOnly))
+        return false;
+
+    auto desc = av_pix_fmt_desc_get(AVPixelFormat(frame->format));
+    for (int i = 0; i < videoFrame.planeCount(); ++i)
+    {
+        int h = (i > 0) ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+        int line = std::min(videoFrame.bytesPerLine(i), frame->linesize[i]);
+        uchar* dst = videoFrame.bits(i);
+        const uint8_t* src = frame->data[i];
+
+        for (int y = 0; y < h; ++y)
+        {
+            memcpy(dst, src, line);
+            dst += videoFrame.bytesPerLine(i);
+            src += frame->linesize[i];
+        }
+    }
+
+    videoFrame.unmap();
+    out = videoFrame;
+    return true;
+#endif
+}
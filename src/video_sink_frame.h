@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QVideoFrame>
+#include <QVideoFrameFormat>
+
+extern "C"
+{
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+#define PRINT_VIDEO_CONVERT_TIME 0
+
+// QVideoFrameFormat::Format_Invalid if Qt can't render this ffmpeg pixel format
+QVideoFrameFormat::PixelFormat avpixfmt_to_qt(int format);
+bool is_sink_supported(const AVFrame* frame);
+
+// Wrap the decoded frame planes into a QVideoFrame. Zero-copy when Qt supports
+// custom video buffers (the frame is referenced, not copied), planes are copied
+// otherwise. Returns false when the frame format can't be mapped.
+bool avframe_to_video_frame(const AVFrame* frame, QVideoFrame& out);
@@ -0,0 +1,145 @@
+// ***********************************************************/
+// yuv_rgb_convert.cpp
+//
+//      Copy Right @ Steven Huang. All rights reserved.
+//
+// Yuv to rgb conversion with the output written rotated,
+// used for display matrix and manual 90 degree rotations.
+// ***********************************************************/
+
+#include "yuv_rgb_convert.h"
+#include <cmath>
+
+extern "C"
+{
+#include <libavutil/display.h>
+}
+
+#define COEF_BITS 14
+
+static inline uint8_t clip_uint8(int v)
+{
+    return uint8_t(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+void yuv_coefficients(AVColorSpace space, AVColorRange range, int height, YuvCoefficients& coef)
+{
+    // luma weights of the matrix
+    double kr = 0.299, kb = 0.114; // BT.601
+    switch (space)
+    {
+        case AVCOL_SPC_BT709:
+            kr = 0.2126, kb = 0.0722;
+            break;
+        case AVCOL_SPC_BT2020_NCL:
+        case AVCOL_SPC_BT2020_CL:
+            kr = 0.2627, kb = 0.0593;
+            break;
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:
+            break;
+        default:
+            if (height > 576) // same guess as swscale
+                kr = 0.2126, kb = 0.0722;
+            break;
+    }
+    double kg = 1.0 - kr - kb;
+
+    bool bFull = (range == AVCOL_RANGE_JPEG);
+    double y_scale = bFull ? 1.0 : 255.0 / 219.0;
+    double c_scale = bFull ? 1.0 : 255.0 / 224.0;
+    double one = double(1 << COEF_BITS);
+
+    coef.y_offset = bFull ? 0 : 16;
+    coef.y_mul = int(std::lround(y_scale * one));
+    coef.v_r = int(std::lround(2.0 * (1.0 - kr) * c_scale * one));
+    coef.u_b = int(std::lround(2.0 * (1.0 - kb) * c_scale * one));
+    coef.u_g = int(std::lround(2.0 * kb * (1.0 - kb) / kg * c_scale * one));
+    coef.v_g = int(std::lround(2.0 * kr * (1.0 - kr) / kg * c_scale * one));
+}
+
+int display_matrix_rotation(const AVFrame* frame, const AVStream* stream)
+{
+    const int32_t* matrix = nullptr;
+
+    if (auto sd = frame ? av_frame_get_side_data(frame, AV_FRAME_DATA_DISPLAYMATRIX) : nullptr)
+        matrix = (const int32_t*)sd->data;
+
+    if (!matrix && stream)
+    {
+        if (auto psd = av_packet_side_data_get(stream->codecpar->coded_side_data,
+                                               stream->codecpar->nb_coded_side_data,
+                                               AV_PKT_DATA_DISPLAYMATRIX))
+            matrix = (const int32_t*)psd->data;
+    }
+
+    if (!matrix)
+        return 0;
+
+    // counterclockwise in the matrix, same handling as ffplay
+    double theta = -std::round(av_display_rotation_get(matrix));
+    if (std::isnan(theta))
+        return 0;
+
+    theta -= 360 * std::floor(theta / 360 + 0.9 / 360);
+    int rotation = int(std::lround(theta / 90.0)) * 90;
+    return rotation % 360;
+}
+
+bool is_rotate_kernel_format(int format)
+{
+    return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P || format == AV_PIX_FMT_NV12;
+}
+
+void yuv420_to_rgb24_rotated(const uint8_t* const src[4], const int src_linesize[4], int format,
+                             int width, int height, const YuvCoefficients& coef,
+                             int rotation, uint8_t* dst, int dst_linesize)
+{
+    // destination offset of source pixel (0, 0) and steps per source x/y
+    ptrdiff_t start = 0, step_x = 3, step_y = dst_linesize;
+    switch (rotation)
+    {
+        case 90:
+            start = ptrdiff_t(height - 1) * 3;
+            step_x = dst_linesize;
+            step_y = -3;
+            break;
+        case 180:
+            start = ptrdiff_t(height - 1) * dst_linesize + ptrdiff_t(width - 1) * 3;
+            step_x = -3;
+            step_y = -ptrdiff_t(dst_linesize);
+            break;
+        case 270:
+            start = ptrdiff_t(width - 1) * dst_linesize;
+            step_x = -ptrdiff_t(dst_linesize);
+            step_y = 3;
+            break;
+        default:
+            break;
+    }
+
+    const bool bNV12 = (format == AV_PIX_FMT_NV12);
+    const int round = 1 << (COEF_BITS - 1);
+
+    for (int y = 0; y < height; ++y)
+    {
+        const uint8_t* py = src[0] + ptrdiff_t(y) * src_linesize[0];
+        const uint8_t* pu = src[1] + ptrdiff_t(y >> 1) * src_linesize[1];
+        const uint8_t* pv = bNV12 ? pu + 1 : src[2] + ptrdiff_t(y >> 1) * src_linesize[2];
+        const int uv_step = bNV12 ? 2 : 1;
+
+        uint8_t* out = dst + start + ptrdiff_t(y) * step_y;
+
+        for (int x = 0; x < width; ++x, out += step_x)
+        {
+            int c = (x >> 1) * uv_step;
+            int u = pu[c] - 128;
+            int v = pv[c] - 128;
+            int luma = (py[x] - coef.y_offset) * coef.y_mul + round;
+
+            out[0] = clip_uint8((luma + coef.v_r * v) >> COEF_BITS);
+            out[1] = clip_uint8((luma - coef.u_g * u - coef.v_g * v) >> COEF_BITS);
+            out[2] = clip_uint8((luma + coef.u_b * u) >> COEF_BITS);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+}
+
+// Fixed point yuv to rgb coefficients of a colour matrix and range
+typedef struct YuvCoefficients
+{
+    int y_offset;
+    int y_mul;
+    int v_r;
+    int u_g;
+    int v_g;
+    int u_b;
+} YuvCoefficients;
+
+void yuv_coefficients(AVColorSpace space, AVColorRange range, int height, YuvCoefficients& coef);
+
+// rotation in degrees clockwise, multiple of 90
+inline bool rotation_swaps_size(int rotation) { return rotation == 90 || rotation == 270; }
+
+// Display rotation of the frame, clockwise degrees. Frame side data first,
+// then the stream's coded side data. 0 if there is no display matrix.
+int display_matrix_rotation(const AVFrame* frame, const AVStream* stream);
+
+// Formats that yuv420_to_rgb24_rotated reads directly
+bool is_rotate_kernel_format(int format);
+
+// Convert yuv420p/nv12 planes to rgb24 and write the pixels at their rotated
+// position, so rotating costs no extra pass. dst is (h x w) for 90/270.
+void yuv420_to_rgb24_rotated(const uint8_t* const src[4], const int src_linesize[4], int format,
+                             int width, int height, const YuvCoefficients& coef,
+                             int rotation, uint8_t* dst, int dst_linesize);